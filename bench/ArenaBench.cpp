@@ -0,0 +1,95 @@
+// The arena benchmark loads and unloads a corpus of synthetic files, as CorpusScanner does:
+// each file is parsed into a SerializedFile which is then dropped.  It compares metadata on
+// the heap with metadata in a std::pmr::monotonic_buffer_resource sized after the file, and
+// counts the allocations each makes of its upstream resource in one untimed pass.
+#include "Bench.h"
+#include "MmapReader.h"
+#include "SerializedFile.h"
+#include "Synthetic.h"
+
+using namespace unitypack;
+
+namespace {
+
+// CountingResource counts the allocations made through it, passing them to the heap.
+struct CountingResource : std::pmr::memory_resource {
+	size_t allocations = 0;
+
+	void *do_allocate(size_t bytes, size_t alignment) override {
+		allocations++;
+		return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+	}
+	void do_deallocate(void *p, size_t bytes, size_t alignment) override {
+		std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+	}
+	bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+		return this == &other;
+	}
+};
+
+size_t Load(const std::vector<char> &bytes, const MetadataAllocator &alloc) {
+	SerializedFile file(alloc);
+	serialize::MmapReaderT<serialize::Endian::Big> s{};
+	s.SetRange(bytes.data(), bytes.size());
+	return file.Read(s) ? file.metadata.objects.size() : 0;
+}
+
+size_t LoadHeap(const std::vector<char> &bytes, std::pmr::memory_resource *upstream) {
+	return Load(bytes, upstream);
+}
+
+size_t LoadArena(const std::vector<char> &bytes, std::pmr::memory_resource *upstream) {
+	std::pmr::monotonic_buffer_resource arena(bytes.size() * 2, upstream);
+	return Load(bytes, &arena);
+}
+
+// Cycle loads and unloads every file of the corpus, returning the number of objects read.
+template <typename LoadFn>
+size_t Cycle(const std::vector<std::vector<char>> &corpus, std::pmr::memory_resource *upstream, LoadFn load) {
+	size_t objects = 0;
+	for (auto &bytes : corpus) {
+		objects += load(bytes, upstream);
+	}
+	return objects;
+}
+
+};
+
+int bench::Arena(int argc, char **argv) {
+	int files = IntOption(argc, argv, "-f", 200);
+	synthetic::Options options;
+	options.objects = IntOption(argc, argv, "-n", 2000);
+	options.payloads = false;
+	int runs = IntOption(argc, argv, "-r", 5);
+
+	// The corpus mixes the format versions, so that it has legacy and new-format trees.
+	static const int versions[] = { 9, 11, 14, 15, 17, 21 };
+	std::vector<std::vector<char>> corpus;
+	size_t expected = 0, bytes = 0;
+	for (int i = 0; i < files; i++) {
+		options.version = versions[i % (sizeof(versions) / sizeof(versions[0]))];
+		options.bigEndian = i % 2 != 0;
+		options.seed = (uint32_t)i + 1;
+		corpus.push_back(synthetic::Build(options));
+		expected += options.objects;
+		bytes += corpus.back().size();
+	}
+
+	CountingResource heapCount, arenaCount;
+	size_t heapObjects = Cycle(corpus, &heapCount, LoadHeap);
+	size_t arenaObjects = Cycle(corpus, &arenaCount, LoadArena);
+	if (heapObjects != expected || arenaObjects != expected) {
+		fprintf(stderr, "arena: cannot parse the synthetic corpus\n");
+		return 1;
+	}
+
+	std::pmr::memory_resource *heap = std::pmr::new_delete_resource();
+	double heapTime = BestOf(runs, [&]() { heapObjects = Cycle(corpus, heap, LoadHeap); });
+	double arenaTime = BestOf(runs, [&]() { arenaObjects = Cycle(corpus, heap, LoadArena); });
+	double megabytes = bytes / 1e6;
+	printf("arena: %d files, %d objects each: heap %.1f ms (%.0f MB/s, %zu allocations), "
+		"arena %.1f ms (%.0f MB/s, %zu allocations), %.2fx\n",
+		files, options.objects, heapTime * 1e3, megabytes / heapTime, heapCount.allocations,
+		arenaTime * 1e3, megabytes / arenaTime, arenaCount.allocations, heapTime / arenaTime);
+	return 0;
+}
@@ -0,0 +1,38 @@
+// unitypack-bench runs the benchmarks of the serializers and decoders on synthetic input.
+//
+// Usage: unitypack-bench benchmark [options]
+#include "Bench.h"
+
+using namespace unitypack;
+
+namespace {
+
+struct Benchmark {
+	const char *name;
+	int (*run)(int argc, char **argv);
+	const char *usage;
+};
+
+const Benchmark benchmarks[] = {
+	{ "ifcond", bench::IfCond, "[-n objects] [-v version] [-r runs]" },
+	{ "endian", bench::Endian, "[-n objects] [-v version] [-r runs]" },
+	{ "arena", bench::Arena, "[-f files] [-n objects] [-r runs]" },
+	{ "texture", bench::Texture, "[-w width] [-h height] [-r runs]" },
+};
+
+};
+
+int main(int argc, char **argv) {
+	if (argc >= 2) {
+		for (auto &benchmark : benchmarks) {
+			if (strcmp(argv[1], benchmark.name) == 0) {
+				return benchmark.run(argc - 2, argv + 2);
+			}
+		}
+	}
+	fprintf(stderr, "usage: unitypack-bench benchmark [options]\n");
+	for (auto &benchmark : benchmarks) {
+		fprintf(stderr, "       unitypack-bench %s %s\n", benchmark.name, benchmark.usage);
+	}
+	return 2;
+}
@@ -0,0 +1,45 @@
+// This header contains what the benchmarks of unitypack-bench share.
+//
+// Each benchmark is a function taking the arguments after its name, which prints one line
+// per measurement and returns the process exit code.
+#pragma once
+
+#include "default.h"
+#include <chrono>
+#include <stdlib.h>
+
+namespace unitypack {
+namespace bench {
+
+// BestOf runs fn runs times and returns the fastest run in seconds.
+template <typename Fn>
+double BestOf(int runs, Fn &&fn) {
+	double best = 0;
+	for (int i = 0; i < runs; i++) {
+		auto start = std::chrono::steady_clock::now();
+		fn();
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (i == 0 || seconds < best) {
+			best = seconds;
+		}
+	}
+	return best;
+}
+
+// IntOption returns the value following name in argv, or fallback.
+inline int IntOption(int argc, char **argv, const char *name, int fallback) {
+	for (int i = 0; i + 1 < argc; i++) {
+		if (strcmp(argv[i], name) == 0) {
+			return atoi(argv[i + 1]);
+		}
+	}
+	return fallback;
+}
+
+int IfCond(int argc, char **argv);
+int Endian(int argc, char **argv);
+int Arena(int argc, char **argv);
+int Texture(int argc, char **argv);
+
+};
+};
@@ -0,0 +1,53 @@
+// The endian benchmark parses the same synthetic file written little-endian and big-endian,
+// with a reader which checks the byte order of every scalar (Endian::Runtime) and with
+// SerializedFile::Read, which fixes it once after the header.
+#include "Bench.h"
+#include "MmapReader.h"
+#include "SerializedFile.h"
+#include "Synthetic.h"
+
+using namespace unitypack;
+
+namespace {
+
+size_t ParseRuntime(const std::vector<char> &bytes) {
+	SerializedFile file{};
+	serialize::MmapReader s{};
+	s.SetRange(bytes.data(), bytes.size());
+	file.Serialize(s);
+	return s.IsErrored() ? 0 : file.metadata.objects.size();
+}
+
+size_t ParseFixed(const std::vector<char> &bytes) {
+	SerializedFile file{};
+	serialize::MmapReaderT<serialize::Endian::Big> s{};
+	s.SetRange(bytes.data(), bytes.size());
+	return file.Read(s) ? file.metadata.objects.size() : 0;
+}
+
+};
+
+int bench::Endian(int argc, char **argv) {
+	synthetic::Options options;
+	options.objects = IntOption(argc, argv, "-n", 1000000);
+	options.version = IntOption(argc, argv, "-v", 17);
+	options.payloads = false;
+	int runs = IntOption(argc, argv, "-r", 5);
+
+	for (bool bigEndian : { false, true }) {
+		options.bigEndian = bigEndian;
+		std::vector<char> bytes = synthetic::Build(options);
+		size_t runtimeObjects = 0, fixedObjects = 0;
+		double runtime = BestOf(runs, [&]() { runtimeObjects = ParseRuntime(bytes); });
+		double fixed = BestOf(runs, [&]() { fixedObjects = ParseFixed(bytes); });
+		if (runtimeObjects != (size_t)options.objects || fixedObjects != (size_t)options.objects) {
+			fprintf(stderr, "endian: cannot parse the synthetic file\n");
+			return 1;
+		}
+		double megabytes = bytes.size() / 1e6;
+		printf("endian: %s, %d objects, version %d: runtime %.1f ms (%.0f MB/s), fixed %.1f ms (%.0f MB/s), %.2fx\n",
+			bigEndian ? "big-endian" : "little-endian", options.objects, options.version, runtime * 1e3,
+			megabytes / runtime, fixed * 1e3, megabytes / fixed, runtime / fixed);
+	}
+	return 0;
+}
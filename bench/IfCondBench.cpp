@@ -0,0 +1,151 @@
+// The ifcond benchmark parses the metadata of a file with a large object table twice: once
+// as SerializedFile does, with ifcond templated over its lambdas, and once with ifcond as it
+// was before, taking std::function.  Every ObjectInfo takes four conditionals.
+#include "Bench.h"
+#include "MmapReader.h"
+#include "SerializedFile.h"
+#include "Synthetic.h"
+#include <functional>
+
+using namespace unitypack;
+using serialize::Var;
+
+namespace {
+
+// ErasedBeginIf and ErasedIf are BeginIf and ifcond before they became templates: the
+// condition and branches are type-erased, may allocate, and are called through a pointer.
+bool ErasedBeginIf(serialize::SerializerBase &s, Var var, const char *condStr, std::function<bool(int)> condition) {
+	s.conditionWasTrue = condition(s.variables[(int)var]);
+	if (s.conditionWasTrue) {
+		s.Begin("if", condStr, serialize::Flags::ConditionalIf);
+		return true;
+	}
+	return false;
+}
+
+template <typename Serializer>
+void ErasedIf(Serializer &s, Var var, const char *condStr,
+	std::function<bool(int)> condition,
+	std::function<void()> thenLambda,
+	std::function<void()> elseLambda = nullptr)
+{
+	if (ErasedBeginIf(s, var, condStr, condition)) {
+		thenLambda();
+		s.End();
+	}
+	if (elseLambda && s.BeginElse()) {
+		elseLambda();
+		s.End();
+	}
+}
+
+#define ErasedSerializeIf(varName, condition, ...) \
+	ErasedIf(s, serialize::CheckedVar<serialize::VarSlot(#varName)>(), \
+	#condition, [](int varName) -> bool { return condition; }, \
+	__VA_ARGS__)
+
+// ErasedObjectInfo is SerializedFile::ObjectInfo with its conditionals type-erased.
+struct ErasedObjectInfo {
+	uint64_t objectID;
+	int dataOffset;
+	int dataSize;
+	int typeID;
+	int16_t classID;
+	int typeIndex;
+	int16_t scriptID;
+	uint8_t unk0;
+
+	SerializeFn(ErasedObjectInfo) {
+		using serialize::Flags;
+		ErasedSerializeIf(version, version >= 14, [&](){
+			SerializeScalarV(uint64_t, objectID, Flags::PreAlign);
+		}, [&](){
+			SerializeScalarV(uint32_t, objectID, Flags::ValueIs32Bit);
+		});
+		SerializeScalar(int, dataOffset);
+		SerializeScalar(int, dataSize);
+		ErasedSerializeIf(version, version >= 17, [&](){
+			SerializeScalar(int, typeIndex);
+		}, [&](){
+			SerializeScalar(int, typeID);
+			SerializeScalar(int16_t, classID);
+		});
+		ErasedSerializeIf(version, version <= 16, [&](){
+			SerializeScalar(int16_t, scriptID);
+		});
+		ErasedSerializeIf(version, 15 <= version && version <= 16, [&](){
+			SerializeScalar(uint8_t, unk0);
+		});
+	}
+};
+
+// ErasedMetadata is SerializedFile::Metadata with its own conditionals, and those of the
+// object table, type-erased.  The few types and references keep their own.
+struct ErasedMetadata {
+	std::string generatorVersion;
+	int platform;
+	bool serializeTypeTrees;
+	std::vector<SerializedFile::TypeMetadata> types;
+	int unk0;
+	std::vector<ErasedObjectInfo> objects;
+	std::vector<SerializedFile::ObjectPtr> adds;
+	std::vector<SerializedFile::FileReference> externalFiles;
+	std::string unk1;
+
+	SerializeFn(ErasedMetadata) {
+		using serialize::Flags;
+		SerializeStructV(string, generatorVersion, Flags::CString);
+		SerializeScalar(int, platform);
+		ErasedSerializeIf(version, version >= 13, [&](){
+			SerializeScalarV(bool, serializeTypeTrees, Flags::Variable);
+		}, [&](){
+			s.SetVariable(Var::serializeTypeTrees, true);
+		});
+		SerializeStruct(vector, types);
+		ErasedSerializeIf(version, 7 <= version && version <= 13, [&](){
+			SerializeScalar(int, unk0);
+		});
+		SerializeStruct(vector, objects);
+		ErasedSerializeIf(version, version >= 11, [&](){
+			SerializeStruct(vector, adds);
+		});
+		SerializeStruct(vector, externalFiles);
+		ErasedSerializeIf(version, version >= 5, [&](){
+			SerializeStructV(string, unk1, Flags::CString);
+		});
+	}
+};
+
+// Parse reads the header and then Metadata from bytes, returning the number of objects.
+template <typename Metadata>
+size_t Parse(const std::vector<char> &bytes) {
+	SerializedFile::Header header;
+	Metadata metadata{};
+	serialize::MmapReader s{};
+	s.SetRange(bytes.data(), bytes.size());
+	SerializeStruct(SerializedFile::Header, header);
+	SerializeStruct(SerializedFile::Metadata, metadata);
+	return s.IsErrored() ? 0 : metadata.objects.size();
+}
+
+};
+
+int bench::IfCond(int argc, char **argv) {
+	synthetic::Options options;
+	options.objects = IntOption(argc, argv, "-n", 1000000);
+	options.version = IntOption(argc, argv, "-v", 17);
+	options.payloads = false;
+	int runs = IntOption(argc, argv, "-r", 5);
+	std::vector<char> bytes = synthetic::Build(options);
+
+	size_t erasedObjects = 0, templateObjects = 0;
+	double erased = BestOf(runs, [&]() { erasedObjects = Parse<ErasedMetadata>(bytes); });
+	double templated = BestOf(runs, [&]() { templateObjects = Parse<SerializedFile::Metadata>(bytes); });
+	if (erasedObjects != (size_t)options.objects || templateObjects != (size_t)options.objects) {
+		fprintf(stderr, "ifcond: cannot parse the synthetic file\n");
+		return 1;
+	}
+	printf("ifcond: %d objects, version %d: std::function %.1f ms, template %.1f ms, %.2fx\n",
+		options.objects, options.version, erased * 1e3, templated * 1e3, erased / templated);
+	return 0;
+}
@@ -0,0 +1,65 @@
+// The texture benchmark decodes a texture of pseudo-random blocks in every format
+// DecodeTexture reads, on one thread, with each instruction set the CPU supports.
+#include "Bench.h"
+#include "TextureDecoder.h"
+
+using namespace unitypack;
+
+int bench::Texture(int argc, char **argv) {
+	int width = IntOption(argc, argv, "-w", 1024);
+	int height = IntOption(argc, argv, "-h", 1024);
+	int runs = IntOption(argc, argv, "-r", 5);
+
+	const std::pair<TextureFormat, const char *> formats[] = {
+		{ TextureFormat::DXT1, "DXT1" },
+		{ TextureFormat::DXT5, "DXT5" },
+		{ TextureFormat::ETC_RGB4, "ETC_RGB4" },
+		{ TextureFormat::ETC2_RGB, "ETC2_RGB" },
+		{ TextureFormat::ETC2_RGBA1, "ETC2_RGBA1" },
+		{ TextureFormat::ETC2_RGBA8, "ETC2_RGBA8" },
+	};
+	const std::pair<TextureIsa, const char *> isas[] = {
+		{ TextureIsa::Scalar, "scalar" },
+		{ TextureIsa::SSSE3, "ssse3" },
+		{ TextureIsa::AVX2, "avx2" },
+	};
+
+	std::vector<uint8_t> rgba((size_t)width * height * 4);
+	double megapixels = (double)width * height / 1e6;
+	for (auto &format : formats) {
+		std::vector<char> data(TextureSize(format.first, width, height));
+		uint32_t seed = 1;
+		for (char &byte : data) {
+			seed ^= seed << 13;
+			seed ^= seed >> 17;
+			seed ^= seed << 5;
+			byte = (char)(seed >> 24);
+		}
+		if (data.empty()) {
+			fprintf(stderr, "texture: %dx%d is not a texture size\n", width, height);
+			return 1;
+		}
+
+		double scalar = 0;
+		for (auto &isa : isas) {
+			if (!TextureIsaSupported(isa.first)) {
+				continue;
+			}
+			bool ok = true;
+			double seconds = BestOf(runs, [&]() {
+				ok = DecodeTexture(format.first, data.data(), data.size(), width, height, rgba.data(),
+					(size_t)width * 4, nullptr, isa.first) && ok;
+			});
+			if (!ok) {
+				fprintf(stderr, "texture: cannot decode %s\n", format.second);
+				return 1;
+			}
+			if (isa.first == TextureIsa::Scalar) {
+				scalar = seconds;
+			}
+			printf("texture: %s %dx%d, %s: %.2f ms, %.0f megapixels/s, %.2fx\n", format.second, width, height,
+				isa.second, seconds * 1e3, megapixels / seconds, scalar / seconds);
+		}
+	}
+	return 0;
+}
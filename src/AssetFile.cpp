@@ -0,0 +1,118 @@
+#include "AssetFile.h"
+#include <algorithm>
+
+namespace unitypack {
+
+void ObjectIndex::Build(const std::pmr::vector<SerializedFile::ObjectInfo> &objects) {
+	ids.resize(objects.size());
+	order.clear();
+	bool sorted = true;
+	for (size_t i = 0; i < objects.size(); i++) {
+		ids[i] = objects[i].objectID;
+		if (i > 0 && ids[i] < ids[i - 1]) {
+			sorted = false;
+		}
+	}
+	if (sorted) {
+		return;
+	}
+	order.resize(objects.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		order[i] = (uint32_t)i;
+	}
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		return objects[a].objectID < objects[b].objectID;
+	});
+	for (size_t i = 0; i < order.size(); i++) {
+		ids[i] = objects[order[i]].objectID;
+	}
+}
+
+int ObjectIndex::Find(uint64_t pathID) const {
+	auto found = std::lower_bound(ids.begin(), ids.end(), pathID);
+	if (found == ids.end() || *found != pathID) {
+		return -1;
+	}
+	size_t i = (size_t)(found - ids.begin());
+	return order.empty() ? (int)i : (int)order[i];
+}
+
+bool AssetFile::Open(const char *path, TypeTreeCache *cache) {
+	if (!mapped.Open(path)) {
+		return false;
+	}
+	return OpenMemory(mapped.data, mapped.size, cache);
+}
+
+bool AssetFile::OpenMemory(const char *data, size_t size, TypeTreeCache *cache) {
+	begin = data;
+	this->size = size;
+	serialize::MmapReaderT<serialize::Endian::Big> rd{};
+	rd.SetRange(data, size);
+	rd.typeTrees = cache;
+	if (!file.Read(rd)) {
+		return false;
+	}
+	index.Build(file.metadata.objects);
+	decoder.reset(new ObjectDecoder(file));
+	return true;
+}
+
+const char *AssetFile::ObjectData(const SerializedFile::ObjectInfo &object) const {
+	uint64_t offset = (uint64_t)(uint32_t)file.header.objectDataOffset + (uint32_t)object.dataOffset;
+	if (object.dataSize < 0 || offset + (uint64_t)object.dataSize > size) {
+		return nullptr;
+	}
+	return begin + offset;
+}
+
+bool BundleAsset::Open(const BundleFile &bundle, const BundleFile::Node &node, BlockCache &cache,
+	TypeTreeCache *typeTrees) {
+	this->bundle = &bundle;
+	this->cache = &cache;
+	offset = (uint64_t)node.offset;
+	size = (uint64_t)node.size;
+	// The header gives the size of the metadata which follows it.
+	const size_t headerSize = 20;
+	char header[headerSize];
+	if (node.offset < 0 || node.size < (int64_t)headerSize || !bundle.Read(offset, headerSize, header, cache)) {
+		return false;
+	}
+	uint32_t metadataSize = (uint32_t)(uint8_t)header[0] << 24 | (uint32_t)(uint8_t)header[1] << 16 |
+		(uint32_t)(uint8_t)header[2] << 8 | (uint8_t)header[3];
+	if (metadataSize > size - headerSize) {
+		return false;
+	}
+	std::vector<char> metadata(headerSize + metadataSize);
+	if (!bundle.Read(offset, metadata.size(), metadata.data(), cache)) {
+		return false;
+	}
+	serialize::MmapReaderT<serialize::Endian::Big> rd{};
+	rd.SetRange(metadata.data(), metadata.size());
+	rd.typeTrees = typeTrees;
+	if (!file.Read(rd)) {
+		return false;
+	}
+	index.Build(file.metadata.objects);
+	decoder.reset(new ObjectDecoder(file));
+	return true;
+}
+
+bool BundleAsset::ObjectData(const SerializedFile::ObjectInfo &object, std::vector<char> &out) const {
+	if (object.dataSize < 0) {
+		return false;
+	}
+	out.resize((size_t)object.dataSize);
+	return ReadObject(object, 0, out.size(), out.data());
+}
+
+bool BundleAsset::ReadObject(const SerializedFile::ObjectInfo &object, uint64_t at, size_t count,
+	char *out) const {
+	uint64_t start = (uint64_t)(uint32_t)file.header.objectDataOffset + (uint32_t)object.dataOffset;
+	if (object.dataSize < 0 || start + (uint64_t)object.dataSize > size || at + count > (uint64_t)object.dataSize) {
+		return false;
+	}
+	return bundle->Read(offset + start + at, count, out, *cache);
+}
+
+};
@@ -0,0 +1,111 @@
+// This header contains random access to the objects of a SerializedFile on disk.
+#pragma once
+
+#include "default.h"
+#include "BundleFile.h"
+#include "MmapReader.h"
+#include "ObjectDecoder.h"
+#include "SerializedFile.h"
+
+namespace unitypack {
+
+// ObjectIndex finds objects by pathID (ObjectInfo::objectID) with a binary search over a
+// flat, sorted array of IDs.
+struct ObjectIndex {
+	void Build(const std::pmr::vector<SerializedFile::ObjectInfo> &objects);
+
+	// Find returns the index into Metadata::objects of pathID, or -1.
+	int Find(uint64_t pathID) const;
+
+	std::vector<uint64_t> ids;
+	// order maps a position in ids to an index into Metadata::objects.  It is empty when the
+	// objects were already sorted, which is the usual case.
+	std::vector<uint32_t> order;
+};
+
+// AssetFile maps a SerializedFile, parses its header and metadata, and then reads and
+// decodes single objects on demand.
+struct AssetFile {
+	AssetFile() = default;
+	AssetFile(const AssetFile &) = delete;
+	AssetFile &operator=(const AssetFile &) = delete;
+
+	// Open returns false if path cannot be mapped or its metadata cannot be parsed.
+	// TypeTrees are shared through cache when one is given.
+	bool Open(const char *path, TypeTreeCache *cache = nullptr);
+	// OpenMemory is Open for a file already in memory, such as a BundleFile node.  data must
+	// outlive the AssetFile.
+	bool OpenMemory(const char *data, size_t size, TypeTreeCache *cache = nullptr);
+
+	// Find returns the object with the given pathID, or nullptr.
+	const SerializedFile::ObjectInfo *Find(uint64_t pathID) const {
+		int i = index.Find(pathID);
+		return i < 0 ? nullptr : &file.metadata.objects[i];
+	}
+
+	// ObjectData returns the dataSize bytes of object's payload, or nullptr if they lie
+	// outside the file.
+	const char *ObjectData(const SerializedFile::ObjectInfo &object) const;
+
+	// Decode runs the visitor over the object with the given pathID, touching only that
+	// object's payload.
+	template <typename Visitor>
+	bool Decode(uint64_t pathID, Visitor &visitor) {
+		const SerializedFile::ObjectInfo *object = Find(pathID);
+		if (!object) {
+			return false;
+		}
+		const char *data = ObjectData(*object);
+		return data && decoder->Decode(*object, data, visitor);
+	}
+
+	MappedFile mapped;
+	// The file's bytes: mapped, or the caller's memory.
+	const char *begin = nullptr;
+	size_t size = 0;
+	SerializedFile file{};
+	ObjectIndex index;
+	std::unique_ptr<ObjectDecoder> decoder;
+};
+
+// BundleAsset is AssetFile for a SerializedFile node of a bundle opened with
+// BundleFile::OpenTables.  Its metadata and objects are read through a BlockCache, so a
+// lookup only decompresses the blocks which hold what it reads.
+struct BundleAsset {
+	BundleAsset() = default;
+	BundleAsset(const BundleAsset &) = delete;
+	BundleAsset &operator=(const BundleAsset &) = delete;
+
+	// Open reads node's header and metadata.  bundle and cache must outlive the BundleAsset.
+	bool Open(const BundleFile &bundle, const BundleFile::Node &node, BlockCache &cache,
+		TypeTreeCache *typeTrees = nullptr);
+
+	const SerializedFile::ObjectInfo *Find(uint64_t pathID) const {
+		int i = index.Find(pathID);
+		return i < 0 ? nullptr : &file.metadata.objects[i];
+	}
+
+	// ObjectData reads the dataSize bytes of object's payload into out.
+	bool ObjectData(const SerializedFile::ObjectInfo &object, std::vector<char> &out) const;
+	// ReadObject reads count bytes at offset at of object's payload into out.
+	bool ReadObject(const SerializedFile::ObjectInfo &object, uint64_t at, size_t count, char *out) const;
+
+	// Decode runs the visitor over the object with the given pathID.  The payload is read
+	// into data, which the pointers the visitor is given point into.
+	template <typename Visitor>
+	bool Decode(uint64_t pathID, Visitor &visitor, std::vector<char> &data) {
+		const SerializedFile::ObjectInfo *object = Find(pathID);
+		return object && ObjectData(*object, data) && decoder->Decode(*object, data.data(), visitor);
+	}
+
+	const BundleFile *bundle = nullptr;
+	BlockCache *cache = nullptr;
+	// Where the node starts in the bundle's decompressed stream.
+	uint64_t offset = 0;
+	uint64_t size = 0;
+	SerializedFile file{};
+	ObjectIndex index;
+	std::unique_ptr<ObjectDecoder> decoder;
+};
+
+};
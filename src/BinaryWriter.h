@@ -0,0 +1,163 @@
+// This header contains the serializers which write a tree instead of reading it.
+//
+// SizeCounter walks a tree and only measures it; BinaryWriter writes it into a buffer the
+// caller provides.  Measuring first lets the buffer be allocated once, at its final size.
+#pragma once
+
+#include "default.h"
+#include "Serialize.h"
+
+namespace unitypack {
+namespace serialize {
+
+// WriterT holds what SizeCounter and BinaryWriter share: which bytes go where, including
+// byte order, CString terminators and alignment.  Output is the derived serializer, whose
+// Put(data, size) stores size bytes at offset, advances offset past them and returns
+// where they were stored, or nullptr if they were not.
+template <typename Output>
+struct WriterT : SerializerBase {
+	static constexpr bool Writes = true;
+
+	size_t offset;
+
+	template <typename T>
+	void Scalar(T &value) {
+		RecordScalar(&value, sizeof(T));
+		size_t stackSize = stack.size();
+		if (stackSize >= 3 && (stack[stackSize - 3].flags & Flags::CString) && std::is_same<T, int>::value) {
+			// A CString is written without its size, and End terminates it.
+			return;
+		}
+
+		size_t sz = sizeof(T);
+		if (stackSize >= 1) {
+			auto &node = stack[stackSize - 1];
+			if (node.flags & Flags::PreAlign) {
+				Align();
+			}
+			if (node.flags & Flags::ValueIs32Bit) {
+				// Only values of at least 4 bytes narrow to 4; a narrower one cannot be
+				// widened in place, so the tree is rejected.
+				if constexpr (sizeof(T) >= 4) {
+					sz = 4;
+				} else {
+					assert(false);
+					errored = true;
+					return;
+				}
+			}
+		}
+		uint8_t bytes[sizeof(T)];
+		memcpy(bytes, &value, sizeof(T));
+		if (IsBigEndian()) {
+			if constexpr (sizeof(T) > 4) {
+				if (sz == 4) {
+					ByteSwap<uint32_t>(bytes);
+				} else {
+					ByteSwap<T>(bytes);
+				}
+			} else {
+				ByteSwap<T>(bytes);
+			}
+		}
+		Out().Put(bytes, sz);
+
+		if (stackSize >= 1) {
+			auto &node = stack[stackSize - 1];
+			if (node.flags & Flags::PostAlign) {
+				Align();
+			}
+		}
+	}
+
+	template <typename T>
+	bool Block(const char *typeName, T *data, int count) {
+		Begin(typeName, "data", 0);
+		RecordScalar(data, count * (int)sizeof(T));
+		void *out = Out().Put(data, count * sizeof(T));
+		if (out && IsBigEndian()) {
+			BlockTraits<T>::Swap((T *)out, count);
+		}
+		End();
+		return true;
+	}
+
+	// End terminates CStrings and aligns after PostAlign nodes, as the readers do.
+	void End() {
+		size_t stackSize = stack.size();
+		int flags = stackSize >= 1 && !overflow ? stack[stackSize - 1].flags : 0;
+		SerializerBase::End();
+		if (flags & Flags::CString) {
+			char terminator = '\0';
+			Out().Put(&terminator, 1);
+		}
+		if (flags & Flags::PostAlign) {
+			Align();
+		}
+	}
+
+	void Align() {
+		static const char padding[4] = {};
+		size_t alignment = ((offset + 3) & ~(size_t)3) - offset;
+		if (alignment > 0) {
+			Out().Put(padding, alignment);
+		}
+	}
+
+private:
+	Output &Out() {
+		return *static_cast<Output *>(this);
+	}
+};
+
+// SizeCounter computes the exact size BinaryWriter would write, without writing anything.
+struct SizeCounter : WriterT<SizeCounter> {
+	void *Put(const void *data, size_t size) {
+		offset += size;
+		return nullptr;
+	}
+};
+
+// BinaryWriter writes into a fixed buffer, which it never grows.  Running out of room errors
+// the writer.
+struct BinaryWriter : WriterT<BinaryWriter> {
+	char *begin;
+	size_t capacity;
+
+	void SetBuffer(char *data, size_t size) {
+		begin = data;
+		capacity = size;
+		offset = 0;
+	}
+
+	void *Put(const void *data, size_t size) {
+		if (capacity - offset < size) {
+			errored = true;
+			eof = true;
+			return nullptr;
+		}
+		char *out = begin + offset;
+		memcpy(out, data, size);
+		offset += size;
+		return out;
+	}
+};
+
+// write_val serializes field into out, which a SizeCounter pass sizes exactly beforehand so
+// that writing never reallocates.  Returns false if either pass errored.
+template <typename T>
+bool write_val(T &field, const char *typeName, std::vector<char> &out) {
+	SizeCounter counter{};
+	struct_val(counter, field, typeName, "");
+	if (counter.IsErrored()) {
+		return false;
+	}
+	out.resize(counter.offset);
+	BinaryWriter writer{};
+	writer.SetBuffer(out.data(), out.size());
+	struct_val(writer, field, typeName, "");
+	return !writer.IsErrored() && writer.offset == out.size();
+}
+
+};
+};
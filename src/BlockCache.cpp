@@ -0,0 +1,75 @@
+#include "BlockCache.h"
+#include <algorithm>
+
+namespace unitypack {
+
+BlockCache::BlockCache(size_t budget, int shards) {
+	if (shards <= 0) {
+		const size_t minShardBudget = 4 << 20;
+		shards = (int)std::min<size_t>(16, std::max<size_t>(1, budget / minShardBudget));
+	}
+	numShards = shards;
+	this->shards.reset(new Shard[numShards]);
+	shardBudget = budget / numShards;
+}
+
+BlockCache::Block BlockCache::Find(Shard &shard, const Key &key) {
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	auto found = shard.entries.find(key);
+	if (found == shard.entries.end()) {
+		shard.misses++;
+		return nullptr;
+	}
+	shard.hits++;
+	shard.lru.splice(shard.lru.begin(), shard.lru, found->second);
+	return found->second->block;
+}
+
+BlockCache::Block BlockCache::Insert(Shard &shard, const Key &key, Block block) {
+	if (block->size() > shardBudget) {
+		return block;
+	}
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	auto found = shard.entries.find(key);
+	if (found != shard.entries.end()) {
+		// Another thread loaded the block first.
+		return found->second->block;
+	}
+	shard.lru.push_front(Entry{ key, block });
+	shard.entries.emplace(key, shard.lru.begin());
+	shard.bytes += block->size();
+	while (shard.bytes > shardBudget) {
+		Entry &oldest = shard.lru.back();
+		shard.bytes -= oldest.block->size();
+		shard.entries.erase(oldest.key);
+		shard.lru.pop_back();
+		shard.evictions++;
+	}
+	return block;
+}
+
+BlockCache::Stats BlockCache::GetStats() {
+	Stats stats{};
+	for (int i = 0; i < numShards; i++) {
+		Shard &shard = shards[i];
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		stats.hits += shard.hits;
+		stats.misses += shard.misses;
+		stats.evictions += shard.evictions;
+		stats.bytes += shard.bytes;
+	}
+	stats.budget = shardBudget * numShards;
+	return stats;
+}
+
+void BlockCache::Clear() {
+	for (int i = 0; i < numShards; i++) {
+		Shard &shard = shards[i];
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		shard.lru.clear();
+		shard.entries.clear();
+		shard.bytes = 0;
+	}
+}
+
+};
@@ -0,0 +1,98 @@
+// This header contains a cache of decompressed bundle blocks.
+#pragma once
+
+#include "default.h"
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace unitypack {
+
+// BlockCache keeps recently used decompressed blocks within a memory budget, so that
+// random reads from a compressed bundle only decompress the blocks they touch, once.  It
+// is split into shards, each an LRU list under its own mutex, so that threads reading
+// different blocks rarely contend.  Blocks are handed out as shared pointers: an evicted
+// block stays valid for whoever still holds it.
+struct BlockCache {
+	// budget is the number of bytes of blocks the cache may hold, divided evenly between
+	// the shards.  shards <= 0 picks up to 16, keeping at least 4 MB in each so that a
+	// small budget still holds several bundle blocks per shard.
+	explicit BlockCache(size_t budget, int shards = 0);
+	BlockCache(const BlockCache &) = delete;
+	BlockCache &operator=(const BlockCache &) = delete;
+
+	// Key names a block: owner identifies the bundle (see BundleFile::id) and index the
+	// block within it.
+	struct Key {
+		uint64_t owner;
+		uint64_t index;
+
+		bool operator==(const Key &other) const {
+			return owner == other.owner && index == other.index;
+		}
+	};
+	using Block = std::shared_ptr<const std::vector<char>>;
+
+	// Get returns the cached block for key, or calls load(std::vector<char> &) to fill a
+	// new one and caches it, unless it is larger than a shard's budget.  Returns nullptr if
+	// load returns false.  load runs without any lock held; threads missing the same block
+	// at once may both load it.
+	template <typename Load>
+	Block Get(const Key &key, Load &&load) {
+		Shard &shard = ShardOf(key);
+		if (Block block = Find(shard, key)) {
+			return block;
+		}
+		auto block = std::make_shared<std::vector<char>>();
+		if (!load(*block)) {
+			return nullptr;
+		}
+		return Insert(shard, key, std::move(block));
+	}
+
+	struct Stats {
+		size_t hits;
+		size_t misses;
+		size_t evictions;
+		// Bytes of blocks currently cached, and the budget for them.
+		size_t bytes;
+		size_t budget;
+	};
+	Stats GetStats();
+
+	// Clear drops every block, keeping the counters.
+	void Clear();
+
+private:
+	struct KeyHasher {
+		size_t operator()(const Key &key) const {
+			return (size_t)(key.owner * 0x9e3779b97f4a7c15ull ^ key.index);
+		}
+	};
+	struct Entry {
+		Key key;
+		Block block;
+	};
+	struct Shard {
+		std::mutex mutex;
+		// Most recently used first.
+		std::list<Entry> lru;
+		std::unordered_map<Key, std::list<Entry>::iterator, KeyHasher> entries;
+		size_t bytes = 0;
+		size_t hits = 0;
+		size_t misses = 0;
+		size_t evictions = 0;
+	};
+
+	Shard &ShardOf(const Key &key) {
+		return shards[KeyHasher()(key) % numShards];
+	}
+	Block Find(Shard &shard, const Key &key);
+	Block Insert(Shard &shard, const Key &key, Block block);
+
+	std::unique_ptr<Shard[]> shards;
+	int numShards;
+	size_t shardBudget;
+};
+
+};
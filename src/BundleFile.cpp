@@ -0,0 +1,202 @@
+#include "BundleFile.h"
+#include "Lz4.h"
+#include <algorithm>
+#include <atomic>
+#include <limits.h>
+
+namespace unitypack {
+
+namespace {
+
+const char Signature[] = "UnityFS";
+
+size_t Align16(size_t offset) {
+	return (offset + 15) & ~(size_t)15;
+}
+
+// DecompressBlock decodes exactly dstSize bytes from src.
+bool DecompressBlock(uint32_t compression, const char *src, size_t srcSize, char *dst, size_t dstSize) {
+	switch (compression) {
+	case BundleFile::None:
+		if (srcSize != dstSize) {
+			return false;
+		}
+		memcpy(dst, src, dstSize);
+		return true;
+	case BundleFile::Lz4:
+	case BundleFile::Lz4HC:
+		return dstSize <= INT_MAX && Lz4Decompress(src, srcSize, dst, dstSize) == (int)dstSize;
+	default:
+		return false;
+	}
+}
+
+// MaxLz4Ratio bounds how far an LZ4 block can expand, so that corrupt sizes are caught
+// before they are allocated.
+const uint64_t MaxLz4Ratio = 255;
+
+bool PlausibleSizes(uint32_t compression, uint64_t compressedSize, uint64_t uncompressedSize) {
+	if (compression == BundleFile::None) {
+		return compressedSize == uncompressedSize;
+	}
+	return uncompressedSize <= compressedSize * MaxLz4Ratio + 16;
+}
+
+};
+
+bool BundleFile::IsBundle(const char *data, size_t size) {
+	return size >= sizeof(Signature) && memcmp(data, Signature, sizeof(Signature)) == 0;
+}
+
+std::string BundleFile::NameKey(const std::string &path) {
+	size_t slash = path.find_last_of("/\\");
+	std::string key = slash == std::string::npos ? path : path.substr(slash + 1);
+	for (char &c : key) {
+		if (c >= 'A' && c <= 'Z') {
+			c = (char)(c - 'A' + 'a');
+		}
+	}
+	return key;
+}
+
+bool BundleFile::Open(const char *path, ThreadPool *pool) {
+	if (!OpenTables(path)) {
+		return false;
+	}
+	// Blocks are independent, so each decodes straight into its place in data.
+	data.reset(new char[dataSize]);
+	std::atomic<bool> failed{false};
+	auto decompress = [&](size_t i) {
+		if (!ReadBlock(i, data.get() + blockOffsets[i])) {
+			failed = true;
+		}
+	};
+	size_t count = info.blocks.size();
+	if (pool) {
+		pool->ParallelFor(count, decompress, 1);
+	} else {
+		for (size_t i = 0; i < count; i++) {
+			decompress(i);
+		}
+	}
+	return !failed;
+}
+
+bool BundleFile::OpenTables(const char *path) {
+	static std::atomic<uint64_t> nextID{1};
+	id = nextID++;
+	data.reset();
+	if (!mapped.Open(path) || !IsBundle(mapped.data, mapped.size)) {
+		return false;
+	}
+	serialize::MmapReaderT<serialize::Endian::Big> rd{};
+	rd.SetRange(mapped);
+	serialize::struct_val(rd, header, "BundleFile::Header", "header");
+	if (rd.IsErrored()) {
+		return false;
+	}
+
+	// Version 7 pads the header to 16 bytes.  The blocks info follows it, or sits at the
+	// end of the file, and the block data follows both, maybe padded again.
+	size_t offset = rd.Tell();
+	if (header.version >= 7) {
+		offset = Align16(offset);
+	}
+	size_t compressedSize = header.compressedBlocksInfoSize;
+	size_t uncompressedSize = header.uncompressedBlocksInfoSize;
+	uint32_t compression = header.flags & CompressionMask;
+	if (offset > mapped.size || compressedSize > mapped.size - offset ||
+		!PlausibleSizes(compression, compressedSize, uncompressedSize)) {
+		return false;
+	}
+	size_t infoOffset = offset;
+	size_t blocksOffset = offset + compressedSize;
+	if (header.flags & BlocksInfoAtTheEnd) {
+		infoOffset = mapped.size - compressedSize;
+		blocksOffset = offset;
+	}
+	if (header.flags & BlockInfoNeedPaddingAtStart) {
+		blocksOffset = Align16(blocksOffset);
+	}
+
+	std::vector<char> infoData(uncompressedSize);
+	if (!DecompressBlock(compression, mapped.data + infoOffset, compressedSize, infoData.data(), uncompressedSize)) {
+		return false;
+	}
+	serialize::MmapReaderT<serialize::Endian::Big> infoReader{};
+	infoReader.SetRange(infoData.data(), infoData.size());
+	serialize::struct_val(infoReader, info, "BundleFile::BlocksInfo", "info");
+	if (infoReader.IsErrored() || blocksOffset > mapped.size) {
+		return false;
+	}
+
+	size_t count = info.blocks.size();
+	blockSources.resize(count);
+	blockOffsets.resize(count);
+	uint64_t src = blocksOffset;
+	uint64_t dst = 0;
+	for (size_t i = 0; i < count; i++) {
+		auto &block = info.blocks[i];
+		if (!PlausibleSizes(block.flags & CompressionMask, block.compressedSize, block.uncompressedSize)) {
+			return false;
+		}
+		blockSources[i] = src;
+		blockOffsets[i] = dst;
+		src += block.compressedSize;
+		dst += block.uncompressedSize;
+	}
+	if (src > mapped.size || (uint64_t)(size_t)dst != dst) {
+		return false;
+	}
+	dataSize = (size_t)dst;
+	return true;
+}
+
+size_t BundleFile::BlockAt(uint64_t offset) const {
+	auto found = std::upper_bound(blockOffsets.begin(), blockOffsets.end(), offset);
+	return found == blockOffsets.begin() ? 0 : (size_t)(found - blockOffsets.begin()) - 1;
+}
+
+bool BundleFile::ReadBlock(size_t index, char *dst) const {
+	auto &block = info.blocks[index];
+	return DecompressBlock(block.flags & CompressionMask, mapped.data + blockSources[index], block.compressedSize,
+		dst, block.uncompressedSize);
+}
+
+bool BundleFile::Read(uint64_t offset, size_t size, char *out, BlockCache &cache) const {
+	if (offset > dataSize || size > dataSize - offset) {
+		return false;
+	}
+	if (data) {
+		memcpy(out, data.get() + offset, size);
+		return true;
+	}
+	uint64_t end = offset + size;
+	for (size_t i = BlockAt(offset); offset < end; i++) {
+		auto &block = info.blocks[i];
+		BlockCache::Block cached = cache.Get(BlockCache::Key{ id, i }, [&](std::vector<char> &buffer) {
+			buffer.resize(block.uncompressedSize);
+			return ReadBlock(i, buffer.data());
+		});
+		if (!cached) {
+			return false;
+		}
+		// Empty blocks are stepped over without copying.
+		size_t within = (size_t)(offset - blockOffsets[i]);
+		size_t n = (size_t)std::min<uint64_t>(end - offset, cached->size() - within);
+		memcpy(out, cached->data() + within, n);
+		out += n;
+		offset += n;
+	}
+	return true;
+}
+
+const char *BundleFile::NodeData(const Node &node) const {
+	if (!data || node.offset < 0 || node.size < 0 || (uint64_t)node.offset > dataSize ||
+		(uint64_t)node.size > dataSize - (uint64_t)node.offset) {
+		return nullptr;
+	}
+	return data.get() + node.offset;
+}
+
+};
@@ -0,0 +1,143 @@
+// This header contains UnityFS asset bundles, the container most SerializedFiles ship in.
+#pragma once
+
+#include "default.h"
+#include "BlockCache.h"
+#include "MmapReader.h"
+#include "SerializedFile.h"
+#include "ThreadPool.h"
+
+namespace unitypack {
+
+// BundleFile reads a UnityFS bundle: a header, a possibly compressed table of storage
+// blocks and directory nodes, and the blocks themselves.  The blocks concatenate into one
+// stream, which the nodes (embedded SerializedFiles and resource files) are ranges of.
+// Everything in the container is big-endian.
+struct BundleFile {
+	// The compression methods of Header::flags and StorageBlock::flags.
+	enum Compression {
+		None = 0,
+		Lzma = 1,
+		Lz4 = 2,
+		Lz4HC = 3,
+	};
+	enum HeaderFlags : uint32_t {
+		CompressionMask = 0x3f,
+		BlocksAndDirectoryInfoCombined = 0x40,
+		BlocksInfoAtTheEnd = 0x80,
+		BlockInfoNeedPaddingAtStart = 0x200,
+	};
+	enum NodeFlags : uint32_t {
+		NodeIsSerializedFile = 0x4,
+	};
+
+	struct Header {
+		std::string signature;
+		int version;
+		std::string unityVersion;
+		std::string unityRevision;
+		int64_t size;
+		uint32_t compressedBlocksInfoSize;
+		uint32_t uncompressedBlocksInfoSize;
+		uint32_t flags;
+
+		SerializeFn(BundleFile::Header) {
+			using serialize::Flags;
+			SerializeStructV(string, signature, Flags::CString);
+			SerializeScalar(int, version);
+			SerializeStructV(string, unityVersion, Flags::CString);
+			SerializeStructV(string, unityRevision, Flags::CString);
+			SerializeScalar(int64_t, size);
+			SerializeScalar(uint32_t, compressedBlocksInfoSize);
+			SerializeScalar(uint32_t, uncompressedBlocksInfoSize);
+			SerializeScalar(uint32_t, flags);
+		}
+	};
+
+	struct StorageBlock {
+		uint32_t uncompressedSize;
+		uint32_t compressedSize;
+		uint16_t flags;
+
+		SerializeFn(BundleFile::StorageBlock) {
+			SerializeScalar(uint32_t, uncompressedSize);
+			SerializeScalar(uint32_t, compressedSize);
+			SerializeScalar(uint16_t, flags);
+		}
+	};
+
+	struct Node {
+		int64_t offset;
+		int64_t size;
+		uint32_t flags;
+		std::string path;
+
+		SerializeFn(BundleFile::Node) {
+			using serialize::Flags;
+			SerializeScalar(int64_t, offset);
+			SerializeScalar(int64_t, size);
+			SerializeScalar(uint32_t, flags);
+			SerializeStructV(string, path, Flags::CString);
+		}
+	};
+
+	struct BlocksInfo {
+		Hash uncompressedDataHash;
+		std::vector<StorageBlock> blocks;
+		std::vector<Node> nodes;
+
+		SerializeFn(BundleFile::BlocksInfo) {
+			SerializeStruct(Hash, uncompressedDataHash);
+			SerializeStruct(vector, blocks);
+			SerializeStruct(vector, nodes);
+		}
+	};
+
+	BundleFile() = default;
+	BundleFile(const BundleFile &) = delete;
+	BundleFile &operator=(const BundleFile &) = delete;
+
+	// IsBundle reports whether data starts with the UnityFS signature.
+	static bool IsBundle(const char *data, size_t size);
+	// NameKey returns the lowercased last path component of path, which is how nodes and the
+	// paths naming them are matched: "archive:/CAB-x/CAB-x.resS" names the node "CAB-x.resS".
+	static std::string NameKey(const std::string &path);
+
+	// Open maps path, reads its tables and decompresses every block, spread over pool when
+	// one is given.  Returns false if the bundle is malformed, or uses LZMA, which is not
+	// supported.
+	bool Open(const char *path, ThreadPool *pool = nullptr);
+	// OpenTables is Open without decompressing anything.  Ranges of the stream are then
+	// decompressed on demand by Read.
+	bool OpenTables(const char *path);
+
+	// NodeData returns the node's bytes in the decompressed stream, or nullptr if the node
+	// lies outside it or the bundle was opened with OpenTables.  They stay valid while the
+	// BundleFile is open, and a SerializedFile node may be read in place with an MmapReader
+	// or AssetFile::OpenMemory.
+	const char *NodeData(const Node &node) const;
+
+	// Read copies size bytes at offset in the decompressed stream to out, decompressing only
+	// the blocks which cover them, through cache.  Returns false if the range lies outside
+	// the stream or a block is malformed.
+	bool Read(uint64_t offset, size_t size, char *out, BlockCache &cache) const;
+
+	// BlockAt returns the index of the block holding offset of the decompressed stream.
+	size_t BlockAt(uint64_t offset) const;
+	// ReadBlock decompresses block index into dst, which holds its uncompressedSize bytes.
+	bool ReadBlock(size_t index, char *dst) const;
+
+	Header header{};
+	BlocksInfo info{};
+	MappedFile mapped;
+	// id tells bundles apart in a BlockCache.  Each Open takes a new one.
+	uint64_t id = 0;
+	// Where each block starts in the file and in the decompressed stream.
+	std::vector<uint64_t> blockSources;
+	std::vector<uint64_t> blockOffsets;
+	// The decompressed stream, when it was decompressed whole.
+	std::unique_ptr<char[]> data;
+	size_t dataSize = 0;
+};
+
+};
@@ -0,0 +1,188 @@
+#include "CorpusScanner.h"
+#include "MetadataIndex.h"
+#include "MmapReader.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+
+namespace unitypack {
+
+namespace {
+
+// The header is 5 big-endian fields padded to 20 bytes; the metadata follows it.
+const int HeaderSize = 20;
+
+int ReadBigEndianInt(const unsigned char *data) {
+	return (int)((uint32_t)data[0] << 24 | (uint32_t)data[1] << 16 | (uint32_t)data[2] << 8 | data[3]);
+}
+
+};
+
+void CorpusSummary::Add(const SerializedFile &file, uint64_t size) {
+	files++;
+	fileBytes += size;
+	readBytes += HeaderSize + (uint32_t)file.header.metadataSize;
+	for (auto &object : file.metadata.objects) {
+		ClassStats &stats = classes[file.ClassID(object)];
+		stats.objects++;
+		stats.bytes += (uint32_t)object.dataSize;
+	}
+	for (auto &external : file.metadata.externalFiles) {
+		externalFiles[std::string(external.fileName)]++;
+	}
+}
+
+void CorpusSummary::Add(const MetadataIndex &index, size_t i) {
+	const MetadataIndex::File &file = index.files[i];
+	if (file.result == (int32_t)CorpusScanner::Result::Skipped) {
+		skipped++;
+		return;
+	}
+	if (file.result == (int32_t)CorpusScanner::Result::Failed) {
+		failed++;
+		failedPaths.push_back(index.GetString(file.path));
+		return;
+	}
+	files++;
+	fileBytes += file.size;
+	for (uint64_t j = file.firstObject; j < file.firstObject + file.objectCount; j++) {
+		ClassStats &stats = classes[index.objects.classID[j]];
+		stats.objects++;
+		stats.bytes += (uint32_t)index.objects.dataSize[j];
+	}
+	for (uint64_t j = file.firstExternal; j < file.firstExternal + file.externalCount; j++) {
+		externalFiles[index.GetString(index.externals[j].fileName)]++;
+	}
+}
+
+CorpusScanner::CorpusScanner(ThreadPool &pool, int maxInFlight) : pool(pool), maxInFlight(maxInFlight) {
+	if (this->maxInFlight <= 0) {
+		this->maxInFlight = pool.Size() * 2;
+	}
+}
+
+bool CorpusScanner::CollectFiles(const std::string &path, std::vector<std::string> &paths) {
+	namespace fs = std::filesystem;
+	std::error_code error;
+	fs::file_status status = fs::status(path, error);
+	if (error || !fs::exists(status)) {
+		return false;
+	}
+	if (!fs::is_directory(status)) {
+		paths.push_back(path);
+		return true;
+	}
+	size_t first = paths.size();
+	for (fs::recursive_directory_iterator it(path, error), end; !error && it != end; it.increment(error)) {
+		if (it->is_regular_file(error)) {
+			paths.push_back(it->path().string());
+		}
+	}
+	std::sort(paths.begin() + first, paths.end());
+	return true;
+}
+
+void CorpusScanner::AcquireRead() {
+	std::unique_lock<std::mutex> lock(inFlightMutex);
+	inFlightFreed.wait(lock, [&](){ return inFlight < maxInFlight; });
+	inFlight++;
+}
+
+void CorpusScanner::ReleaseRead() {
+	{
+		std::lock_guard<std::mutex> lock(inFlightMutex);
+		inFlight--;
+	}
+	inFlightFreed.notify_one();
+}
+
+CorpusScanner::Result CorpusScanner::ReadHead(const std::string &path, std::vector<char> &buffer,
+	uint64_t &fileSize) {
+	// Only the header and metadata are read; the object data, usually most of the file, is
+	// never touched.
+	FILE *fp = fopen(path.c_str(), "rb");
+	if (!fp) {
+		return Result::Failed;
+	}
+	Result result = Result::Ok;
+	unsigned char header[HeaderSize];
+	int64_t size = -1;
+	if (fseek(fp, 0, SEEK_END) == 0) {
+		size = (int64_t)ftell(fp);
+		rewind(fp);
+	}
+	int metadataSize = -1;
+	int version = -1;
+	if (size >= HeaderSize && fread(header, 1, HeaderSize, fp) == HeaderSize) {
+		metadataSize = ReadBigEndianInt(header);
+		version = ReadBigEndianInt(header + 8);
+	}
+	// Anything without a plausible header is some other kind of file in the build.
+	if (metadataSize <= 0 || version <= 0 || version > 100 || HeaderSize + (int64_t)metadataSize > size) {
+		result = Result::Skipped;
+	} else {
+		fileSize = (uint64_t)size;
+		buffer.resize(HeaderSize + (size_t)metadataSize);
+		memcpy(buffer.data(), header, HeaderSize);
+		if (fread(buffer.data() + HeaderSize, 1, (size_t)metadataSize, fp) != (size_t)metadataSize) {
+			result = Result::Failed;
+		}
+	}
+	fclose(fp);
+	return result;
+}
+
+CorpusScanner::Result CorpusScanner::ScanFile(const std::string &path, CorpusSummary &summary, std::mutex &summaryMutex) {
+	std::vector<char> buffer;
+	uint64_t size = 0;
+	AcquireRead();
+	Result result = ReadHead(path, buffer, size);
+	ReleaseRead();
+	if (result != Result::Ok) {
+		return result;
+	}
+
+	// The file is only summarized and dropped, so it is parsed into an arena sized after its
+	// metadata, which takes a few allocations and frees them together.
+	std::pmr::monotonic_buffer_resource arena(buffer.size() * 2);
+	SerializedFile file(&arena);
+	serialize::MmapReaderT<serialize::Endian::Big> rd{};
+	rd.SetRange(buffer.data(), buffer.size());
+	rd.skipFields = skipFields;
+#ifdef UNITYPACK_PROFILE
+	serialize::Profile fileProfile;
+	rd.profile = &fileProfile;
+#endif
+	bool ok = file.Read(rd);
+	std::lock_guard<std::mutex> lock(summaryMutex);
+#ifdef UNITYPACK_PROFILE
+	profile.Merge(fileProfile);
+#endif
+	if (!ok) {
+		return Result::Failed;
+	}
+	summary.Add(file, size);
+	return Result::Ok;
+}
+
+CorpusSummary CorpusScanner::Scan(const std::vector<std::string> &paths) {
+	auto start = std::chrono::steady_clock::now();
+	CorpusSummary summary;
+	std::mutex summaryMutex;
+	std::vector<Result> results(paths.size());
+	pool.ParallelFor(paths.size(), [&](size_t i) {
+		results[i] = ScanFile(paths[i], summary, summaryMutex);
+	}, 1);
+	for (size_t i = 0; i < paths.size(); i++) {
+		if (results[i] == Result::Failed) {
+			summary.failed++;
+			summary.failedPaths.push_back(paths[i]);
+		} else if (results[i] == Result::Skipped) {
+			summary.skipped++;
+		}
+	}
+	summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return summary;
+}
+
+};
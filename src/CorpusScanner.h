@@ -0,0 +1,83 @@
+// This header contains a batch scanner which summarizes the metadata of many SerializedFiles.
+#pragma once
+
+#include "default.h"
+#include "SerializedFile.h"
+#include "ThreadPool.h"
+#include <map>
+
+namespace unitypack {
+
+struct MetadataIndex;
+
+// CorpusSummary is the merged metadata of every file a CorpusScanner has read.
+struct CorpusSummary {
+	struct ClassStats {
+		size_t objects;
+		uint64_t bytes;
+	};
+
+	// Files which parsed, which looked like SerializedFiles but did not parse, and which
+	// did not look like SerializedFiles at all.
+	size_t files = 0;
+	size_t failed = 0;
+	size_t skipped = 0;
+	// fileBytes is the size of every file scanned; readBytes is the headers and metadata
+	// actually read from them.
+	uint64_t fileBytes = 0;
+	uint64_t readBytes = 0;
+	double seconds = 0;
+
+	// Objects and payload bytes per classID.
+	std::map<int, ClassStats> classes;
+	// The number of files which reference each external file name.
+	std::map<std::string, size_t> externalFiles;
+	std::vector<std::string> failedPaths;
+
+	void Add(const SerializedFile &file, uint64_t size);
+	// Add counts file i of index as scanning it would have, without reading it.
+	void Add(const MetadataIndex &index, size_t i);
+};
+
+// CorpusScanner reads the header and metadata, but no object data, of many files at once on
+// a ThreadPool.  At most maxInFlight files are being read from disk at any moment, so a large
+// pool does not turn into a large queue of outstanding reads.
+struct CorpusScanner {
+	explicit CorpusScanner(ThreadPool &pool, int maxInFlight = 0);
+
+	// Fields of the metadata which are not read.  The summary needs no TypeTrees.
+	uint32_t skipFields = SerializedFile::SkipTypeTrees;
+#ifdef UNITYPACK_PROFILE
+	// The merged profile of every file read.
+	serialize::Profile profile;
+#endif
+
+	// Scan reads every path and returns the merged summary.
+	CorpusSummary Scan(const std::vector<std::string> &paths);
+
+	// CollectFiles appends path to paths if it is a file, or every regular file below it, in
+	// sorted order, if it is a directory.  Returns false if path does not exist.
+	static bool CollectFiles(const std::string &path, std::vector<std::string> &paths);
+
+	enum class Result {
+		Ok,
+		Failed,
+		Skipped,
+	};
+	// ReadHead reads the header and metadata of path, but no object data, into buffer, and
+	// the size of the whole file into fileSize.  Files without a plausible header are Skipped.
+	static Result ReadHead(const std::string &path, std::vector<char> &buffer, uint64_t &fileSize);
+
+private:
+	Result ScanFile(const std::string &path, CorpusSummary &summary, std::mutex &summaryMutex);
+	void AcquireRead();
+	void ReleaseRead();
+
+	ThreadPool &pool;
+	int maxInFlight;
+	int inFlight = 0;
+	std::mutex inFlightMutex;
+	std::condition_variable inFlightFreed;
+};
+
+};
@@ -0,0 +1,312 @@
+#include "DependencyGraph.h"
+#include <algorithm>
+#include <chrono>
+
+namespace unitypack {
+
+namespace {
+
+// PPtrVisitor collects the m_FileID and m_PathID of every PPtr in an object.
+struct PPtrVisitor : DecodeVisitor {
+	struct Ref {
+		int64_t fileID;
+		int64_t pathID;
+	};
+	std::vector<Ref> refs;
+	bool inPPtr = false;
+	Ref current;
+
+	void BeginStruct(const Instruction &insn) {
+		if (strncmp(insn.type, "PPtr<", 5) == 0) {
+			inPPtr = true;
+			current = Ref{ 0, 0 };
+		}
+	}
+	void Scalar(const Instruction &insn, const void *value) {
+		if (!inPPtr) {
+			return;
+		}
+		if (strcmp(insn.name, "m_FileID") == 0) {
+			current.fileID = ScalarAsInt(insn.kind, value);
+		} else if (strcmp(insn.name, "m_PathID") == 0) {
+			current.pathID = ScalarAsInt(insn.kind, value);
+		}
+	}
+	void EndStruct(const Instruction &insn) {
+		// A PPtr holds only scalars, so the first EndStruct after it began ends it.
+		if (inPPtr) {
+			refs.push_back(current);
+			inPPtr = false;
+		}
+	}
+};
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+};
+
+std::vector<uint32_t> Reachable(const Csr &graph, const std::vector<uint32_t> &roots, ThreadPool &pool,
+	size_t parallelFrontier) {
+	const size_t Chunk = 1024;
+
+	size_t count = graph.NodeCount();
+	std::unique_ptr<std::atomic<uint64_t>[]> visited(new std::atomic<uint64_t>[(count + 63) / 64]());
+	auto visit = [&](uint32_t node) {
+		uint64_t bit = 1ull << (node & 63);
+		return !(visited[node >> 6].fetch_or(bit, std::memory_order_relaxed) & bit);
+	};
+
+	std::vector<uint32_t> order;
+	std::vector<uint32_t> frontier;
+	std::vector<uint32_t> next;
+	for (uint32_t root : roots) {
+		if (root < count && visit(root)) {
+			frontier.push_back(root);
+		}
+	}
+	while (!frontier.empty()) {
+		order.insert(order.end(), frontier.begin(), frontier.end());
+		next.clear();
+		if (frontier.size() < parallelFrontier) {
+			for (uint32_t node : frontier) {
+				for (const uint32_t *edge = graph.begin(node); edge != graph.end(node); edge++) {
+					if (visit(*edge)) {
+						next.push_back(*edge);
+					}
+				}
+			}
+		} else {
+			// Each chunk of the frontier collects the nodes it claimed first; the atomic
+			// visited bits make every node land in exactly one chunk.
+			size_t chunks = (frontier.size() + Chunk - 1) / Chunk;
+			std::vector<std::vector<uint32_t>> parts(chunks);
+			pool.ParallelFor(chunks, [&](size_t c) {
+				size_t end = std::min(frontier.size(), (c + 1) * Chunk);
+				for (size_t i = c * Chunk; i < end; i++) {
+					for (const uint32_t *edge = graph.begin(frontier[i]); edge != graph.end(frontier[i]); edge++) {
+						if (visit(*edge)) {
+							parts[c].push_back(*edge);
+						}
+					}
+				}
+			}, 1);
+			for (auto &part : parts) {
+				next.insert(next.end(), part.begin(), part.end());
+			}
+		}
+		frontier.swap(next);
+	}
+	return order;
+}
+
+bool DependencyGraph::Load(const std::vector<std::string> &paths, ThreadPool &pool) {
+	auto start = std::chrono::steady_clock::now();
+	stats = Stats{};
+
+	// Each path opens into its own slot, so that numbering follows the order of paths.
+	struct Opened {
+		std::unique_ptr<BundleFile> bundle;
+		std::vector<File> files;
+		std::vector<std::string> keys;
+		size_t failed = 0;
+	};
+	std::vector<Opened> opened(paths.size());
+	pool.ParallelFor(paths.size(), [&](size_t i) {
+		Opened &out = opened[i];
+		const std::string &path = paths[i];
+		MappedFile probe;
+		if (!probe.Open(path.c_str())) {
+			out.failed++;
+			return;
+		}
+		if (!BundleFile::IsBundle(probe.data, probe.size)) {
+			std::unique_ptr<AssetFile> asset(new AssetFile());
+			if (!asset->Open(path.c_str(), &TypeTreeCache::Shared())) {
+				out.failed++;
+				return;
+			}
+			out.files.push_back(File{ path, std::move(asset), {} });
+			out.keys.push_back(BundleFile::NameKey(path));
+			return;
+		}
+		// The pool is busy running this task, so the bundle decompresses on this thread.
+		out.bundle.reset(new BundleFile());
+		if (!out.bundle->Open(path.c_str())) {
+			out.failed++;
+			return;
+		}
+		for (auto &node : out.bundle->info.nodes) {
+			if (!(node.flags & BundleFile::NodeIsSerializedFile)) {
+				continue;
+			}
+			const char *data = out.bundle->NodeData(node);
+			std::unique_ptr<AssetFile> asset(new AssetFile());
+			if (!data || !asset->OpenMemory(data, (size_t)node.size, &TypeTreeCache::Shared())) {
+				out.failed++;
+				continue;
+			}
+			out.files.push_back(File{ path + ":" + node.path, std::move(asset), {} });
+			out.keys.push_back(BundleFile::NameKey(node.path));
+		}
+	}, 1);
+
+	files.clear();
+	bundles.clear();
+	names.clear();
+	for (Opened &out : opened) {
+		stats.failed += out.failed;
+		for (size_t i = 0; i < out.files.size(); i++) {
+			names.emplace_back(out.keys[i], (int)files.size());
+			files.push_back(std::move(out.files[i]));
+		}
+		if (out.bundle) {
+			bundles.push_back(std::move(out.bundle));
+		}
+	}
+	// Where several files share a name, the first listed wins.
+	std::stable_sort(names.begin(), names.end(), [](const auto &a, const auto &b) {
+		return a.first < b.first;
+	});
+	stats.files = files.size();
+	stats.loadSeconds = SecondsSince(start);
+	if (files.empty()) {
+		return false;
+	}
+
+	start = std::chrono::steady_clock::now();
+	Resolve();
+	BuildObjects(pool);
+	BuildFiles();
+	stats.buildSeconds = SecondsSince(start);
+	return true;
+}
+
+int DependencyGraph::FindFile(const std::string &name) const {
+	std::string key = BundleFile::NameKey(name);
+	auto found = std::lower_bound(names.begin(), names.end(), key, [](const auto &entry, const std::string &k) {
+		return entry.first < k;
+	});
+	return found != names.end() && found->first == key ? found->second : -1;
+}
+
+int64_t DependencyGraph::FindObject(int file, uint64_t pathID) const {
+	int i = files[file].asset->index.Find(pathID);
+	return i < 0 ? -1 : (int64_t)objectBase[file] + i;
+}
+
+int DependencyGraph::FileOf(uint32_t object) const {
+	return (int)(std::upper_bound(objectBase.begin(), objectBase.end(), object) - objectBase.begin()) - 1;
+}
+
+void DependencyGraph::Resolve() {
+	objectBase.resize(files.size() + 1);
+	objectBase[0] = 0;
+	for (size_t f = 0; f < files.size(); f++) {
+		const SerializedFile &file = files[f].asset->file;
+		auto &targets = files[f].targets;
+		targets.assign(1, (int32_t)f);
+		for (auto &external : file.metadata.externalFiles) {
+			targets.push_back(FindFile(std::string(external.fileName)));
+		}
+		objectBase[f + 1] = objectBase[f] + (uint32_t)file.metadata.objects.size();
+	}
+	stats.objects = objectBase.back();
+}
+
+void DependencyGraph::BuildObjects(ThreadPool &pool) {
+	// Objects are decoded in chunks, each collecting its edges in object order, so that the
+	// chunks concatenate into the CSR targets once every degree is known.
+	const size_t Chunk = 256;
+	size_t count = objectBase.back();
+	size_t chunks = (count + Chunk - 1) / Chunk;
+	std::vector<uint32_t> degree(count);
+	std::vector<std::vector<uint32_t>> parts(chunks);
+	std::atomic<size_t> undecoded{0};
+	std::atomic<size_t> references{0};
+	std::atomic<size_t> resolved{0};
+	pool.ParallelFor(chunks, [&](size_t c) {
+		PPtrVisitor visitor;
+		std::vector<uint32_t> &part = parts[c];
+		size_t end = std::min(count, (c + 1) * Chunk);
+		size_t chunkUndecoded = 0;
+		size_t chunkReferences = 0;
+		size_t chunkResolved = 0;
+		int f = FileOf((uint32_t)(c * Chunk));
+		for (size_t o = c * Chunk; o < end; o++) {
+			while (o >= objectBase[f + 1]) {
+				f++;
+			}
+			AssetFile &asset = *files[f].asset;
+			const SerializedFile::ObjectInfo &info = asset.file.metadata.objects[o - objectBase[f]];
+			const char *data = asset.ObjectData(info);
+			if (!data || !asset.decoder->Program(asset.file.TypeIndex(info))) {
+				chunkUndecoded++;
+				continue;
+			}
+			// A malformed object keeps the references read before the error.
+			visitor.refs.clear();
+			visitor.inPPtr = false;
+			asset.decoder->Decode(info, data, visitor);
+
+			size_t first = part.size();
+			const auto &targets = files[f].targets;
+			for (auto &ref : visitor.refs) {
+				if (ref.pathID == 0) {
+					continue;
+				}
+				chunkReferences++;
+				if (ref.fileID < 0 || ref.fileID >= (int64_t)targets.size() || targets[ref.fileID] < 0) {
+					continue;
+				}
+				int64_t target = FindObject(targets[ref.fileID], (uint64_t)ref.pathID);
+				if (target >= 0) {
+					chunkResolved++;
+					part.push_back((uint32_t)target);
+				}
+			}
+			std::sort(part.begin() + first, part.end());
+			part.erase(std::unique(part.begin() + first, part.end()), part.end());
+			degree[o] = (uint32_t)(part.size() - first);
+		}
+		undecoded += chunkUndecoded;
+		references += chunkReferences;
+		resolved += chunkResolved;
+	}, 1);
+
+	objects.offsets.resize(count + 1);
+	objects.offsets[0] = 0;
+	for (size_t o = 0; o < count; o++) {
+		objects.offsets[o + 1] = objects.offsets[o] + degree[o];
+	}
+	objects.targets.resize(objects.offsets[count]);
+	pool.ParallelFor(chunks, [&](size_t c) {
+		std::copy(parts[c].begin(), parts[c].end(), objects.targets.begin() + objects.offsets[c * Chunk]);
+	}, 1);
+
+	stats.undecoded = undecoded;
+	stats.references = references;
+	stats.resolved = resolved;
+	stats.edges = objects.targets.size();
+}
+
+void DependencyGraph::BuildFiles() {
+	fileGraph.offsets.assign(1, 0);
+	fileGraph.targets.clear();
+	for (size_t f = 0; f < files.size(); f++) {
+		size_t first = fileGraph.targets.size();
+		auto &targets = files[f].targets;
+		for (size_t i = 1; i < targets.size(); i++) {
+			if (targets[i] >= 0 && targets[i] != (int32_t)f) {
+				fileGraph.targets.push_back((uint32_t)targets[i]);
+			}
+		}
+		std::sort(fileGraph.targets.begin() + first, fileGraph.targets.end());
+		fileGraph.targets.erase(std::unique(fileGraph.targets.begin() + first, fileGraph.targets.end()),
+			fileGraph.targets.end());
+		fileGraph.offsets.push_back(fileGraph.targets.size());
+	}
+}
+
+};
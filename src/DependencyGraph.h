@@ -0,0 +1,108 @@
+// This header contains the graph of PPtr references between the objects of a corpus.
+#pragma once
+
+#include "default.h"
+#include "AssetFile.h"
+#include "BundleFile.h"
+#include "ThreadPool.h"
+#include <atomic>
+
+namespace unitypack {
+
+// Csr is a directed graph in compressed sparse row form: the edges of node i are
+// targets[offsets[i]] up to targets[offsets[i + 1]].
+struct Csr {
+	std::vector<uint64_t> offsets;
+	std::vector<uint32_t> targets;
+
+	size_t NodeCount() const {
+		return offsets.empty() ? 0 : offsets.size() - 1;
+	}
+	const uint32_t *begin(uint32_t node) const {
+		return targets.data() + offsets[node];
+	}
+	const uint32_t *end(uint32_t node) const {
+		return targets.data() + offsets[node + 1];
+	}
+};
+
+// Frontiers of a breadth-first search smaller than this are expanded on the calling thread.
+const size_t DefaultParallelFrontier = 4096;
+
+// Reachable returns every node reachable from roots, roots included, level by level of a
+// breadth-first search.  Each level of at least parallelFrontier nodes is spread over pool,
+// so the order of nodes within a level may differ between runs.
+std::vector<uint32_t> Reachable(const Csr &graph, const std::vector<uint32_t> &roots, ThreadPool &pool,
+	size_t parallelFrontier = DefaultParallelFrontier);
+
+// DependencyGraph loads a corpus of SerializedFiles, and the SerializedFiles in bundles, and
+// resolves the PPtrs in every object: each fileID through the referring file's externalFiles
+// to another file of the corpus, and each pathID to an object of that file.  Files are
+// matched by the last component of FileReference::fileName, case-insensitively, so
+// "archive:/CAB-x/CAB-x" finds bundle node CAB-x and "Assets/level0" finds level0.
+//
+// Objects are numbered across the corpus: file f owns [objectBase[f], objectBase[f + 1]), in
+// the order of its object table.
+struct DependencyGraph {
+	struct File {
+		// The path, or bundle path:node path, of the file.
+		std::string name;
+		std::unique_ptr<AssetFile> asset;
+		// targets[fileID] is the file a fileID refers to, or -1 when it is not in the corpus.
+		// fileID 0 is the file itself.
+		std::vector<int32_t> targets;
+	};
+
+	struct Stats {
+		size_t files = 0;
+		size_t failed = 0;
+		size_t objects = 0;
+		// Objects without a TypeTree, whose references cannot be read.
+		size_t undecoded = 0;
+		// PPtrs with a nonzero pathID, those which resolved to an object in the corpus, and
+		// the resolved edges kept after removing duplicates.
+		size_t references = 0;
+		size_t resolved = 0;
+		size_t edges = 0;
+		double loadSeconds = 0;
+		double buildSeconds = 0;
+	};
+
+	DependencyGraph() = default;
+	DependencyGraph(const DependencyGraph &) = delete;
+	DependencyGraph &operator=(const DependencyGraph &) = delete;
+
+	// Load opens every path and builds both graphs on pool.  Paths which cannot be read are
+	// counted in Stats::failed and left out.  Returns false if no file could be read.
+	bool Load(const std::vector<std::string> &paths, ThreadPool &pool);
+
+	// FindFile returns the file matching name as a FileReference would, or -1.
+	int FindFile(const std::string &name) const;
+	// FindObject returns the number of the object with pathID in file, or -1.
+	int64_t FindObject(int file, uint64_t pathID) const;
+	// FileOf returns the file which owns object.
+	int FileOf(uint32_t object) const;
+	const SerializedFile::ObjectInfo &Info(uint32_t object) const {
+		int f = FileOf(object);
+		return files[f].asset->file.metadata.objects[object - objectBase[f]];
+	}
+
+	std::vector<File> files;
+	std::vector<uint32_t> objectBase;
+	// objects has an edge for each distinct object a PPtr of an object resolves to.  fileGraph
+	// has an edge for each external file of a file which is in the corpus.
+	Csr objects;
+	Csr fileGraph;
+	Stats stats;
+
+private:
+	void Resolve();
+	void BuildObjects(ThreadPool &pool);
+	void BuildFiles();
+
+	std::vector<std::unique_ptr<BundleFile>> bundles;
+	// Lowercased names, sorted, with the file each refers to.
+	std::vector<std::pair<std::string, int>> names;
+};
+
+};
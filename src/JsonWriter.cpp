@@ -0,0 +1,338 @@
+#include "JsonWriter.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+
+namespace unitypack {
+
+namespace {
+
+const char digitPairs[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+const char hexDigits[] = "0123456789abcdef";
+
+// WriteDigits writes value in decimal so that it ends just before end, and returns where it
+// starts.
+char *WriteDigits(uint64_t value, char *end) {
+	while (value >= 100) {
+		unsigned pair = (unsigned)(value % 100);
+		value /= 100;
+		end -= 2;
+		memcpy(end, digitPairs + pair * 2, 2);
+	}
+	if (value >= 10) {
+		end -= 2;
+		memcpy(end, digitPairs + value * 2, 2);
+	} else {
+		*--end = (char)('0' + value);
+	}
+	return end;
+}
+
+// Escapes maps each byte to the letter of its escape: 'u' for \u00XX, or 0 for a byte
+// written as it is.  Bytes from 0x80 map to '8': they are written as they are if they
+// begin a well-formed UTF-8 sequence, and escaped otherwise.
+struct Escapes {
+	char table[256] = {};
+
+	Escapes() {
+		for (int c = 0; c < 0x20; c++) {
+			table[c] = 'u';
+		}
+		for (int c = 0x80; c < 0x100; c++) {
+			table[c] = '8';
+		}
+		table['"'] = '"';
+		table['\\'] = '\\';
+		table['\b'] = 'b';
+		table['\f'] = 'f';
+		table['\n'] = 'n';
+		table['\r'] = 'r';
+		table['\t'] = 't';
+	}
+};
+
+const Escapes escapes;
+
+// Utf8Length returns the length of the well-formed UTF-8 sequence starting at s, of which
+// size bytes are left, or 0 if there is none: a lone continuation byte, an overlong form, a
+// surrogate, a code point past U+10FFFF or a truncated sequence.
+size_t Utf8Length(const uint8_t *s, size_t size) {
+	size_t length;
+	uint8_t low = 0x80, high = 0xbf;
+	if (s[0] >= 0xc2 && s[0] <= 0xdf) {
+		length = 2;
+	} else if (s[0] >= 0xe0 && s[0] <= 0xef) {
+		length = 3;
+		if (s[0] == 0xe0) {
+			low = 0xa0;
+		} else if (s[0] == 0xed) {
+			high = 0x9f;
+		}
+	} else if (s[0] >= 0xf0 && s[0] <= 0xf4) {
+		length = 4;
+		if (s[0] == 0xf0) {
+			low = 0x90;
+		} else if (s[0] == 0xf4) {
+			high = 0x8f;
+		}
+	} else {
+		return 0;
+	}
+	if (size < length || s[1] < low || s[1] > high) {
+		return 0;
+	}
+	for (size_t i = 2; i < length; i++) {
+		if ((s[i] & 0xc0) != 0x80) {
+			return 0;
+		}
+	}
+	return length;
+}
+
+template <typename T>
+T Load(const char *value) {
+	T v;
+	memcpy(&v, value, sizeof(T));
+	return v;
+}
+
+// Elements writes count values of type T from data, separated by commas, with write.
+template <typename T, typename Write>
+void Elements(JsonWriter &out, const char *data, int count, Write &&write) {
+	for (int i = 0; i < count; i++) {
+		if (i > 0) {
+			out.Char(',');
+		}
+		write(Load<T>(data + (size_t)i * sizeof(T)));
+	}
+}
+
+};
+
+JsonWriter::JsonWriter(FILE *fp, size_t flushSize)
+	: fp(fp), flushSize(std::max<size_t>(flushSize, 64)), buffer(new char[this->flushSize]),
+	capacity(this->flushSize) {
+}
+
+void JsonWriter::Grow(size_t size) {
+	if (fp && used > 0) {
+		Flush();
+		if (size <= capacity - used) {
+			return;
+		}
+	}
+	// Only a buffer without fp, or a single value larger than flushSize, gets here.
+	size_t next = std::max(capacity * 2, used + size);
+	std::unique_ptr<char[]> grown(new char[next]);
+	memcpy(grown.get(), buffer.get(), used);
+	buffer = std::move(grown);
+	capacity = next;
+}
+
+void JsonWriter::Write(const char *data, size_t size) {
+	if (fp) {
+		Flush();
+		if (size >= capacity) {
+			if (fwrite(data, 1, size, fp) != size) {
+				failed = true;
+			}
+			written += size;
+			return;
+		}
+	} else {
+		Grow(size);
+	}
+	memcpy(buffer.get() + used, data, size);
+	used += size;
+}
+
+bool JsonWriter::Flush() {
+	if (fp && used > 0) {
+		if (fwrite(buffer.get(), 1, used, fp) != used) {
+			failed = true;
+		}
+		written += used;
+		used = 0;
+	}
+	return !failed;
+}
+
+void JsonWriter::String(const char *data, size_t size) {
+	Char('"');
+	size_t start = 0;
+	for (size_t i = 0; i < size; i++) {
+		char escape = escapes.table[(uint8_t)data[i]];
+		if (!escape) {
+			continue;
+		}
+		if (escape == '8') {
+			size_t length = Utf8Length((const uint8_t *)data + i, size - i);
+			if (length) {
+				i += length - 1;
+				continue;
+			}
+			escape = 'u';
+		}
+		Raw(data + start, i - start);
+		start = i + 1;
+		if (escape == 'u') {
+			char *dst = Reserve(6);
+			memcpy(dst, "\\u00", 4);
+			dst[4] = hexDigits[(uint8_t)data[i] >> 4];
+			dst[5] = hexDigits[data[i] & 15];
+			used += 6;
+		} else {
+			char *dst = Reserve(2);
+			dst[0] = '\\';
+			dst[1] = escape;
+			used += 2;
+		}
+	}
+	Raw(data + start, size - start);
+	Char('"');
+}
+
+void JsonWriter::UInt(uint64_t value) {
+	char digits[20];
+	char *start = WriteDigits(value, digits + sizeof(digits));
+	Raw(start, (size_t)(digits + sizeof(digits) - start));
+}
+
+void JsonWriter::Int(int64_t value) {
+	char digits[21];
+	char *start = WriteDigits(value < 0 ? 0 - (uint64_t)value : (uint64_t)value, digits + sizeof(digits));
+	if (value < 0) {
+		*--start = '-';
+	}
+	Raw(start, (size_t)(digits + sizeof(digits) - start));
+}
+
+void JsonWriter::Float(float value) {
+	if (!std::isfinite(value)) {
+		Null();
+		return;
+	}
+	char *dst = Reserve(32);
+	used += (size_t)(std::to_chars(dst, dst + 32, value).ptr - dst);
+}
+
+void JsonWriter::Double(double value) {
+	if (!std::isfinite(value)) {
+		Null();
+		return;
+	}
+	char *dst = Reserve(32);
+	used += (size_t)(std::to_chars(dst, dst + 32, value).ptr - dst);
+}
+
+void JsonVisitor::ScalarArray(const Instruction &insn, const void *data, int count) {
+	Key(insn);
+	out.Char('[');
+	const char *bytes = (const char *)data;
+	// One loop per kind, so that the kind is not looked at for every element.
+	switch (insn.kind) {
+	case ScalarKind::Bool:
+		Elements<uint8_t>(out, bytes, count, [&](uint8_t v) { out.Bool(v != 0); });
+		break;
+	case ScalarKind::Char:
+		Elements<char>(out, bytes, count, [&](char v) { out.Int(v); });
+		break;
+	case ScalarKind::Int8:
+		Elements<int8_t>(out, bytes, count, [&](int8_t v) { out.Int(v); });
+		break;
+	case ScalarKind::UInt8:
+		Elements<uint8_t>(out, bytes, count, [&](uint8_t v) { out.UInt(v); });
+		break;
+	case ScalarKind::Int16:
+		Elements<int16_t>(out, bytes, count, [&](int16_t v) { out.Int(v); });
+		break;
+	case ScalarKind::UInt16:
+		Elements<uint16_t>(out, bytes, count, [&](uint16_t v) { out.UInt(v); });
+		break;
+	case ScalarKind::Int32:
+		Elements<int32_t>(out, bytes, count, [&](int32_t v) { out.Int(v); });
+		break;
+	case ScalarKind::UInt32:
+		Elements<uint32_t>(out, bytes, count, [&](uint32_t v) { out.UInt(v); });
+		break;
+	case ScalarKind::Int64:
+		Elements<int64_t>(out, bytes, count, [&](int64_t v) { out.Int(v); });
+		break;
+	case ScalarKind::UInt64:
+		Elements<uint64_t>(out, bytes, count, [&](uint64_t v) { out.UInt(v); });
+		break;
+	case ScalarKind::Float:
+		Elements<float>(out, bytes, count, [&](float v) { out.Float(v); });
+		break;
+	case ScalarKind::Double:
+		Elements<double>(out, bytes, count, [&](double v) { out.Double(v); });
+		break;
+	case ScalarKind::Raw:
+		for (int i = 0; i < count; i++) {
+			if (i > 0) {
+				out.Char(',');
+			}
+			Value(insn.kind, insn.size, bytes + (size_t)i * insn.size);
+		}
+		break;
+	}
+	out.Char(']');
+}
+
+void JsonVisitor::Value(ScalarKind kind, int size, const char *value) {
+	switch (kind) {
+	case ScalarKind::Bool:
+		out.Bool(*value != 0);
+		break;
+	case ScalarKind::UInt8:
+	case ScalarKind::UInt16:
+	case ScalarKind::UInt32:
+		out.UInt((uint64_t)ScalarAsInt(kind, value));
+		break;
+	case ScalarKind::UInt64:
+		out.UInt(Load<uint64_t>(value));
+		break;
+	case ScalarKind::Float:
+		out.Float(Load<float>(value));
+		break;
+	case ScalarKind::Double:
+		out.Double(Load<double>(value));
+		break;
+	case ScalarKind::Raw: {
+		// The bytes in the order they are stored.
+		out.Char('"');
+		for (int i = 0; i < size; i++) {
+			char hex[2] = { hexDigits[(uint8_t)value[i] >> 4], hexDigits[value[i] & 15] };
+			out.Raw(hex, 2);
+		}
+		out.Char('"');
+		break;
+	}
+	default:
+		out.Int(ScalarAsInt(kind, value));
+		break;
+	}
+}
+
+void JsonVisitor::Finish() {
+	while (!open.empty()) {
+		Close();
+	}
+	if (first) {
+		out.Null();
+	}
+	first = true;
+}
+
+};
@@ -0,0 +1,162 @@
+// This header contains a streaming JSON writer, and the visitor which writes decoded objects
+// with it.
+#pragma once
+
+#include "default.h"
+#include "ObjectDecoder.h"
+
+namespace unitypack {
+
+// JsonWriter appends JSON text to one buffer, which is reused: with fp, the buffer is written
+// out whenever the next value would take it past flushSize, so memory stays bounded however
+// much is written.  Without fp the buffer only grows, until the caller takes its contents
+// and calls Clear.  Integers are formatted two digits at a time, and floats as the shortest
+// text which reads back to the same value.
+struct JsonWriter {
+	explicit JsonWriter(FILE *fp = nullptr, size_t flushSize = 1 << 20);
+	JsonWriter(const JsonWriter &) = delete;
+	JsonWriter &operator=(const JsonWriter &) = delete;
+	~JsonWriter() {
+		Flush();
+	}
+
+	void Raw(const char *data, size_t size) {
+		if (size > capacity - used) {
+			Write(data, size);
+			return;
+		}
+		memcpy(buffer.get() + used, data, size);
+		used += size;
+	}
+	void Raw(const char *text) {
+		Raw(text, strlen(text));
+	}
+	void Char(char c) {
+		*Reserve(1) = c;
+		used++;
+	}
+	// String writes data quoted, escaping quotes, backslashes and control characters.
+	// Well-formed UTF-8 is copied as it is.  Bytes which are not part of a well-formed
+	// sequence are written as \u00XX, so that the output is always valid JSON; such a byte
+	// reads back as the code point of the same value.
+	void String(const char *data, size_t size);
+	void String(const char *text) {
+		String(text, strlen(text));
+	}
+	void Int(int64_t value);
+	void UInt(uint64_t value);
+	// NaN and infinities have no JSON form; they are written as null.
+	void Float(float value);
+	void Double(double value);
+	void Bool(bool value) {
+		value ? Raw("true", 4) : Raw("false", 5);
+	}
+	void Null() {
+		Raw("null", 4);
+	}
+
+	// Flush writes the buffer to fp and empties it; without fp it does nothing.  It returns
+	// false if this or any earlier write failed.
+	bool Flush();
+
+	const char *data() const {
+		return buffer.get();
+	}
+	size_t size() const {
+		return used;
+	}
+	void Clear() {
+		used = 0;
+	}
+
+	// written counts the bytes written to fp so far.
+	uint64_t written = 0;
+
+private:
+	// Reserve makes room for size more bytes and returns where they go.
+	char *Reserve(size_t size) {
+		if (size > capacity - used) {
+			Grow(size);
+		}
+		return buffer.get() + used;
+	}
+	void Grow(size_t size);
+	// Write is Raw for data which does not fit; with fp, data larger than the buffer is
+	// written straight to it.
+	void Write(const char *data, size_t size);
+
+	FILE *fp;
+	size_t flushSize;
+	std::unique_ptr<char[]> buffer;
+	size_t used = 0;
+	size_t capacity = 0;
+	bool failed = false;
+};
+
+// JsonVisitor writes what a program decodes as one JSON value: structs become objects keyed
+// by field name, arrays and blocks of scalars become arrays, and strings, numbers and bools
+// become values.  Each callback appends to the writer as it comes, so no tree of values is
+// built.  Raw scalars, of types the decoder does not know, are written as hex strings.
+struct JsonVisitor : DecodeVisitor {
+	explicit JsonVisitor(JsonWriter &out) : out(out) {
+	}
+
+	void Scalar(const Instruction &insn, const void *value) {
+		Key(insn);
+		Value(insn.kind, insn.size, (const char *)value);
+	}
+	void ScalarArray(const Instruction &insn, const void *data, int count);
+	void String(const Instruction &insn, const char *data, int length) {
+		Key(insn);
+		out.String(data, (size_t)length);
+	}
+	void BeginArray(const Instruction &insn, int count) {
+		Open(insn, true);
+	}
+	void EndArray(const Instruction &insn) {
+		Close();
+	}
+	void BeginStruct(const Instruction &insn) {
+		Open(insn, false);
+	}
+	void EndStruct(const Instruction &insn) {
+		Close();
+	}
+
+	// Finish closes whatever a failed decode left open, so that the value is well formed,
+	// and readies the visitor for the next one.
+	void Finish();
+
+	JsonWriter &out;
+
+private:
+	void Key(const Instruction &insn) {
+		if (!first) {
+			out.Char(',');
+		}
+		first = false;
+		// Elements of arrays, and the value itself, have no key.
+		if (!open.empty() && open.back() == '}') {
+			out.String(insn.name);
+			out.Char(':');
+		}
+	}
+	void Open(const Instruction &insn, bool array) {
+		Key(insn);
+		out.Char(array ? '[' : '{');
+		open.push_back(array ? ']' : '}');
+		first = true;
+	}
+	void Close() {
+		out.Char(open.back());
+		open.pop_back();
+		first = false;
+	}
+	void Value(ScalarKind kind, int size, const char *value);
+
+	// The closing bracket of each open array or object, innermost last.
+	std::vector<char> open;
+	bool first = true;
+};
+
+};
@@ -0,0 +1,94 @@
+#include "Lz4.h"
+#include <string.h>
+
+namespace unitypack {
+
+namespace {
+
+// ReadLength adds the extension bytes of a literal or match length which saturated its
+// 4-bit field.  Returns false if the input ends first.
+bool ReadLength(const uint8_t *&ip, const uint8_t *iend, size_t &length) {
+	uint8_t s;
+	do {
+		if (ip >= iend) {
+			return false;
+		}
+		s = *ip++;
+		length += s;
+	} while (s == 255);
+	return true;
+}
+
+};
+
+int Lz4Decompress(const char *src, size_t srcSize, char *dst, size_t dstCapacity) {
+	const uint8_t *ip = (const uint8_t *)src;
+	const uint8_t *iend = ip + srcSize;
+	uint8_t *op = (uint8_t *)dst;
+	uint8_t *oend = op + dstCapacity;
+
+	// Each sequence is a token, literals, a 2-byte match offset and a match; the last
+	// sequence stops after its literals.  Copies run 16 or 8 bytes at a time when both
+	// buffers have room for the overshoot.
+	while (true) {
+		if (ip >= iend) {
+			return -1;
+		}
+		unsigned token = *ip++;
+
+		size_t length = token >> 4;
+		if (length == 15 && !ReadLength(ip, iend, length)) {
+			return -1;
+		}
+		if (length > (size_t)(iend - ip) || length > (size_t)(oend - op)) {
+			return -1;
+		}
+		if (length <= 16 && iend - ip >= 16 && oend - op >= 16) {
+			memcpy(op, ip, 16);
+		} else {
+			memcpy(op, ip, length);
+		}
+		ip += length;
+		op += length;
+		if (ip == iend) {
+			break;
+		}
+
+		if (iend - ip < 2) {
+			return -1;
+		}
+		size_t offset = (size_t)ip[0] | (size_t)ip[1] << 8;
+		ip += 2;
+		if (offset == 0 || offset > (size_t)(op - (uint8_t *)dst)) {
+			return -1;
+		}
+		size_t matchLength = token & 15;
+		if (matchLength == 15 && !ReadLength(ip, iend, matchLength)) {
+			return -1;
+		}
+		matchLength += 4;
+		size_t room = (size_t)(oend - op);
+		if (matchLength > room) {
+			return -1;
+		}
+		const uint8_t *match = op - offset;
+		if (offset >= 16 && room >= ((matchLength + 15) & ~(size_t)15)) {
+			for (size_t i = 0; i < matchLength; i += 16) {
+				memcpy(op + i, match + i, 16);
+			}
+		} else if (offset >= 8 && room >= ((matchLength + 7) & ~(size_t)7)) {
+			for (size_t i = 0; i < matchLength; i += 8) {
+				memcpy(op + i, match + i, 8);
+			}
+		} else {
+			// The match overlaps the bytes it produces, repeating a short pattern.
+			for (size_t i = 0; i < matchLength; i++) {
+				op[i] = match[i];
+			}
+		}
+		op += matchLength;
+	}
+	return (int)(op - (uint8_t *)dst);
+}
+
+};
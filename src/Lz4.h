@@ -0,0 +1,13 @@
+// This header contains a decoder for LZ4 blocks, which UnityFS bundles compress with.
+#pragma once
+
+#include "default.h"
+
+namespace unitypack {
+
+// Lz4Decompress decodes one raw LZ4 block (LZ4 and LZ4HC write the same format) from
+// src into dst.  It returns the number of bytes decoded, or -1 if the block is malformed
+// or does not fit in dstCapacity.  It never reads or writes outside either buffer.
+int Lz4Decompress(const char *src, size_t srcSize, char *dst, size_t dstCapacity);
+
+};
@@ -0,0 +1,400 @@
+#include "MetadataIndex.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+
+namespace unitypack {
+
+static_assert(sizeof(MetadataIndex::Header) == 56, "MetadataIndex::Header must match the format");
+static_assert(sizeof(MetadataIndex::File) == 104, "MetadataIndex::File must match the format");
+static_assert(sizeof(MetadataIndex::Type) == 40, "MetadataIndex::Type must match the format");
+static_assert(sizeof(MetadataIndex::External) == 40, "MetadataIndex::External must match the format");
+
+namespace {
+
+const char Magic[4] = { 'U', 'P', 'I', 'X' };
+
+// Layout holds where each array of an image starts, given the counts in its header.  Every
+// array starts on an 8-byte boundary.
+struct Layout {
+	size_t files;
+	size_t objectID;
+	size_t dataOffset;
+	size_t dataSize;
+	size_t classID;
+	size_t typeIndex;
+	size_t types;
+	size_t externals;
+	size_t strings;
+	size_t end;
+};
+
+// ComputeLayout fills layout, returning false if the arrays would not fit in limit bytes.
+bool ComputeLayout(const MetadataIndex::Header &header, size_t limit, Layout &layout) {
+	size_t offset = sizeof(MetadataIndex::Header);
+	auto place = [&](size_t &start, uint64_t count, size_t recordSize) {
+		start = offset;
+		if (count > (limit - offset) / recordSize) {
+			return false;
+		}
+		offset = (offset + (size_t)count * recordSize + 7) & ~(size_t)7;
+		return offset <= limit;
+	};
+	return place(layout.files, header.fileCount, sizeof(MetadataIndex::File)) &&
+		place(layout.objectID, header.objectCount, sizeof(uint64_t)) &&
+		place(layout.dataOffset, header.objectCount, sizeof(int32_t)) &&
+		place(layout.dataSize, header.objectCount, sizeof(int32_t)) &&
+		place(layout.classID, header.objectCount, sizeof(int32_t)) &&
+		place(layout.typeIndex, header.objectCount, sizeof(int32_t)) &&
+		place(layout.types, header.typeCount, sizeof(MetadataIndex::Type)) &&
+		place(layout.externals, header.externalCount, sizeof(MetadataIndex::External)) &&
+		place(layout.strings, header.stringsSize, 1) &&
+		(layout.end = offset, true);
+}
+
+bool RangeFits(uint64_t first, uint64_t count, uint64_t total) {
+	return first <= total && count <= total - first;
+}
+
+// HashBytes is 64-bit FNV-1a.
+uint64_t HashBytes(const char *data, size_t size) {
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ (uint8_t)data[i]) * 1099511628211ull;
+	}
+	return hash;
+}
+
+// Pending is one path being indexed: the stat results, and either the previous entry to
+// copy or the freshly parsed file.
+struct Pending {
+	bool exists = false;
+	uint64_t size = 0;
+	int64_t mtime = 0;
+	uint64_t contentHash = 0;
+	CorpusScanner::Result result = CorpusScanner::Result::Ok;
+	const MetadataIndex::File *previous = nullptr;
+	// Whether previous is copied, rather than file.
+	bool reuse = false;
+	SerializedFile file{};
+};
+
+// StringPool appends strings to the pool of an image under construction.
+struct StringPool {
+	std::string data;
+
+	MetadataIndex::String Add(std::string_view str) {
+		MetadataIndex::String string{ (uint32_t)data.size(), (uint32_t)str.size() };
+		data += str;
+		return string;
+	}
+};
+
+};
+
+bool MetadataIndex::Open(const char *path) {
+	Close();
+	if (!mapped.Open(path) || !Attach(mapped.data, mapped.size)) {
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MetadataIndex::Close() {
+	mapped.Close();
+	header = nullptr;
+	files = nullptr;
+	objects = Objects{};
+	types = nullptr;
+	externals = nullptr;
+	strings = nullptr;
+}
+
+bool MetadataIndex::Attach(const char *data, size_t size) {
+	if (size < sizeof(Header)) {
+		return false;
+	}
+	const Header *h = (const Header *)data;
+	Layout layout;
+	if (memcmp(h->magic, Magic, sizeof(Magic)) != 0 || h->formatVersion != FormatVersion ||
+		h->byteOrder != ByteOrderMark || h->imageSize != size || !ComputeLayout(*h, size, layout) ||
+		layout.end != size || h->stringsSize > UINT32_MAX) {
+		return false;
+	}
+	const File *f = (const File *)(data + layout.files);
+	for (uint32_t i = 0; i < h->fileCount; i++) {
+		if (!RangeFits(f[i].firstObject, f[i].objectCount, h->objectCount) ||
+			!RangeFits(f[i].firstType, f[i].typeCount, h->typeCount) ||
+			!RangeFits(f[i].firstExternal, f[i].externalCount, h->externalCount) ||
+			!RangeFits(f[i].path.offset, f[i].path.length, h->stringsSize) ||
+			!RangeFits(f[i].generatorVersion.offset, f[i].generatorVersion.length, h->stringsSize)) {
+			return false;
+		}
+	}
+	const External *e = (const External *)(data + layout.externals);
+	for (uint64_t i = 0; i < h->externalCount; i++) {
+		if (!RangeFits(e[i].assetName.offset, e[i].assetName.length, h->stringsSize) ||
+			!RangeFits(e[i].fileName.offset, e[i].fileName.length, h->stringsSize)) {
+			return false;
+		}
+	}
+
+	header = h;
+	files = f;
+	objects.objectID = (const uint64_t *)(data + layout.objectID);
+	objects.dataOffset = (const int32_t *)(data + layout.dataOffset);
+	objects.dataSize = (const int32_t *)(data + layout.dataSize);
+	objects.classID = (const int32_t *)(data + layout.classID);
+	objects.typeIndex = (const int32_t *)(data + layout.typeIndex);
+	types = (const Type *)(data + layout.types);
+	externals = e;
+	strings = data + layout.strings;
+	return true;
+}
+
+const MetadataIndex::File *MetadataIndex::Find(const std::string &path) const {
+	size_t lo = 0;
+	size_t hi = FileCount();
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		const String &name = files[mid].path;
+		int cmp = path.compare(0, std::string::npos, strings + name.offset, name.length);
+		if (cmp == 0) {
+			return &files[mid];
+		}
+		if (cmp < 0) {
+			hi = mid;
+		} else {
+			lo = mid + 1;
+		}
+	}
+	return nullptr;
+}
+
+MetadataIndex::BuildStats MetadataIndex::Build(const std::vector<std::string> &listed, const MetadataIndex *previous,
+	ThreadPool &pool, std::vector<char> &image) {
+	namespace fs = std::filesystem;
+	auto start = std::chrono::steady_clock::now();
+	BuildStats stats;
+	std::vector<std::string> paths = listed;
+	std::sort(paths.begin(), paths.end());
+	paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+
+	std::vector<Pending> pending(paths.size());
+	pool.ParallelFor(paths.size(), [&](size_t i) {
+		Pending &p = pending[i];
+		std::error_code error;
+		uint64_t size = fs::file_size(paths[i], error);
+		if (error) {
+			return;
+		}
+		auto mtime = fs::last_write_time(paths[i], error);
+		if (error) {
+			return;
+		}
+		p.exists = true;
+		p.size = size;
+		p.mtime = (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(mtime.time_since_epoch()).count();
+		p.previous = previous ? previous->Find(paths[i]) : nullptr;
+		if (p.previous && p.previous->size == p.size && p.previous->mtime == p.mtime) {
+			p.reuse = true;
+			return;
+		}
+
+		std::vector<char> buffer;
+		uint64_t fileSize = 0;
+		p.result = CorpusScanner::ReadHead(paths[i], buffer, fileSize);
+		if (p.result != CorpusScanner::Result::Ok) {
+			return;
+		}
+		p.contentHash = HashBytes(buffer.data(), buffer.size());
+		if (p.previous && p.previous->result == (int32_t)CorpusScanner::Result::Ok &&
+			p.previous->size == p.size && p.previous->contentHash == p.contentHash) {
+			p.reuse = true;
+			return;
+		}
+		serialize::MmapReaderT<serialize::Endian::Big> rd{};
+		rd.SetRange(buffer.data(), buffer.size());
+		rd.skipFields = SerializedFile::SkipTypeTrees;
+		if (!p.file.Read(rd)) {
+			// A failed file gets an entry without rows, so that it is not read again until
+			// it changes.
+			p.result = CorpusScanner::Result::Failed;
+			p.file = SerializedFile{};
+		}
+	}, 1);
+
+	// Size every array, then fill them in path order.
+	Header h{};
+	memcpy(h.magic, Magic, sizeof(Magic));
+	h.formatVersion = FormatVersion;
+	h.byteOrder = ByteOrderMark;
+	size_t matched = 0;
+	for (Pending &p : pending) {
+		if (!p.exists) {
+			continue;
+		}
+		h.fileCount++;
+		matched += p.previous != nullptr;
+		if (p.reuse) {
+			h.objectCount += p.previous->objectCount;
+			h.typeCount += p.previous->typeCount;
+			h.externalCount += p.previous->externalCount;
+			if (p.previous->mtime == p.mtime) {
+				stats.reused++;
+			} else {
+				stats.rehashed++;
+			}
+		} else {
+			h.objectCount += p.file.metadata.objects.size();
+			h.typeCount += p.file.metadata.types.size();
+			h.externalCount += p.file.metadata.externalFiles.size();
+			stats.parsed++;
+		}
+	}
+	stats.removed = (previous ? previous->FileCount() : 0) - matched;
+	image.clear();
+	if (previous && previous->header && stats.reused == h.fileCount && stats.removed == 0) {
+		stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return stats;
+	}
+
+	StringPool stringPool;
+	std::vector<File> fileRows;
+	std::vector<uint64_t> objectID;
+	std::vector<int32_t> dataOffset, dataSize, classID, typeIndex;
+	std::vector<Type> typeRows;
+	std::vector<External> externalRows;
+	fileRows.reserve(h.fileCount);
+	objectID.reserve(h.objectCount);
+	dataOffset.reserve(h.objectCount);
+	dataSize.reserve(h.objectCount);
+	classID.reserve(h.objectCount);
+	typeIndex.reserve(h.objectCount);
+	typeRows.reserve(h.typeCount);
+	externalRows.reserve(h.externalCount);
+	for (size_t i = 0; i < paths.size(); i++) {
+		Pending &p = pending[i];
+		if (!p.exists) {
+			continue;
+		}
+		File row{};
+		if (p.reuse) {
+			const File &old = *p.previous;
+			row = old;
+			row.mtime = p.mtime;
+			row.generatorVersion = stringPool.Add(previous->GetString(old.generatorVersion));
+			auto copyColumn = [&](auto &column, const auto *source) {
+				column.insert(column.end(), source + old.firstObject, source + old.firstObject + old.objectCount);
+			};
+			copyColumn(objectID, previous->objects.objectID);
+			copyColumn(dataOffset, previous->objects.dataOffset);
+			copyColumn(dataSize, previous->objects.dataSize);
+			copyColumn(classID, previous->objects.classID);
+			copyColumn(typeIndex, previous->objects.typeIndex);
+			typeRows.insert(typeRows.end(), previous->types + old.firstType,
+				previous->types + old.firstType + old.typeCount);
+			for (uint32_t j = 0; j < old.externalCount; j++) {
+				External external = previous->externals[old.firstExternal + j];
+				external.assetName = stringPool.Add(previous->GetString(external.assetName));
+				external.fileName = stringPool.Add(previous->GetString(external.fileName));
+				externalRows.push_back(external);
+			}
+		} else {
+			const SerializedFile &file = p.file;
+			const SerializedFile::Header &fh = file.header;
+			const SerializedFile::Metadata &metadata = file.metadata;
+			row.size = p.size;
+			row.mtime = p.mtime;
+			row.contentHash = p.contentHash;
+			row.result = (int32_t)p.result;
+			if (p.result == CorpusScanner::Result::Ok) {
+				row.platform = metadata.platform;
+				row.metadataSize = fh.metadataSize;
+				row.fileSize = fh.fileSize;
+				row.version = fh.version;
+				row.objectDataOffset = fh.objectDataOffset;
+				row.bigEndian = fh.bigEndian;
+				row.objectCount = (uint32_t)metadata.objects.size();
+				row.typeCount = (uint32_t)metadata.types.size();
+				row.externalCount = (uint32_t)metadata.externalFiles.size();
+				row.generatorVersion = stringPool.Add(metadata.generatorVersion);
+			}
+			for (auto &object : metadata.objects) {
+				objectID.push_back(object.objectID);
+				dataOffset.push_back(object.dataOffset);
+				dataSize.push_back(object.dataSize);
+				classID.push_back(file.ClassID(object));
+				typeIndex.push_back(file.TypeIndex(object));
+			}
+			for (auto &type : metadata.types) {
+				Type t{};
+				t.classID = fh.version >= 17 ? type.classID : type.oldClassID;
+				t.scriptID = type.scriptID;
+				t.typeHash = type.typeHash;
+				t.scriptHash = type.scriptHash;
+				typeRows.push_back(t);
+			}
+			for (auto &ref : metadata.externalFiles) {
+				External external{};
+				external.guid = ref.guid;
+				external.type = ref.type;
+				external.assetName = stringPool.Add(ref.assetName);
+				external.fileName = stringPool.Add(ref.fileName);
+				externalRows.push_back(external);
+			}
+		}
+		row.path = stringPool.Add(paths[i]);
+		row.firstObject = objectID.size() - row.objectCount;
+		row.firstType = typeRows.size() - row.typeCount;
+		row.firstExternal = externalRows.size() - row.externalCount;
+		fileRows.push_back(row);
+	}
+	h.stringsSize = stringPool.data.size();
+
+	Layout layout;
+	ComputeLayout(h, SIZE_MAX, layout);
+	h.imageSize = layout.end;
+	image.assign(layout.end, 0);
+	char *out = image.data();
+	auto put = [&](size_t offset, const void *data, size_t size) {
+		if (size > 0) {
+			memcpy(out + offset, data, size);
+		}
+	};
+	put(0, &h, sizeof(h));
+	put(layout.files, fileRows.data(), fileRows.size() * sizeof(File));
+	put(layout.objectID, objectID.data(), objectID.size() * sizeof(uint64_t));
+	put(layout.dataOffset, dataOffset.data(), dataOffset.size() * sizeof(int32_t));
+	put(layout.dataSize, dataSize.data(), dataSize.size() * sizeof(int32_t));
+	put(layout.classID, classID.data(), classID.size() * sizeof(int32_t));
+	put(layout.typeIndex, typeIndex.data(), typeIndex.size() * sizeof(int32_t));
+	put(layout.types, typeRows.data(), typeRows.size() * sizeof(Type));
+	put(layout.externals, externalRows.data(), externalRows.size() * sizeof(External));
+	put(layout.strings, stringPool.data.data(), stringPool.data.size());
+
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return stats;
+}
+
+bool MetadataIndex::Save(const char *path, const std::vector<char> &image) {
+	std::string temporary = std::string(path) + ".tmp";
+	FILE *fp = fopen(temporary.c_str(), "wb");
+	if (!fp) {
+		return false;
+	}
+	bool ok = fwrite(image.data(), 1, image.size(), fp) == image.size();
+	ok = fclose(fp) == 0 && ok;
+	std::error_code error;
+	if (ok) {
+		std::filesystem::rename(temporary, path, error);
+	}
+	if (!ok || error) {
+		std::filesystem::remove(temporary, error);
+		return false;
+	}
+	return true;
+}
+
+};
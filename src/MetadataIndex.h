@@ -0,0 +1,148 @@
+// This header contains a persistent index of the metadata of many SerializedFiles.
+#pragma once
+
+#include "default.h"
+#include "CorpusScanner.h"
+#include "MmapReader.h"
+#include "SerializedFile.h"
+#include "ThreadPool.h"
+
+namespace unitypack {
+
+// MetadataIndex is a file which holds, for every file of a corpus, its SerializedFile header,
+// its object table, the hashes of its types and its external file references.  The image is
+// a fixed header followed by arrays of fixed-size records in the host's byte order, so an
+// index is used straight from a MappedFile: Open only checks that the arrays fit.
+//
+// The object table is stored as columns, one array per field across every file, so that a
+// query over one field reads nothing else.  A file's rows are [firstObject, firstObject +
+// objectCount) of each column, and the same goes for its types and external files.
+struct MetadataIndex {
+	static const uint32_t FormatVersion = 1;
+
+	struct Header {
+		char magic[4];
+		uint32_t formatVersion;
+		// ByteOrderMark as the writing host stored it.  Indexes are not byte swapped: one
+		// written by a host of the other byte order is rebuilt.
+		uint32_t byteOrder;
+		uint32_t fileCount;
+		uint64_t objectCount;
+		uint64_t typeCount;
+		uint64_t externalCount;
+		uint64_t stringsSize;
+		uint64_t imageSize;
+	};
+	static const uint32_t ByteOrderMark = 0x01020304;
+
+	// A range of the string pool.
+	struct String {
+		uint32_t offset;
+		uint32_t length;
+	};
+
+	struct File {
+		String path;
+		// What the file looked like when it was indexed.  contentHash covers the header and
+		// metadata, the bytes the entry was built from.
+		uint64_t size;
+		int64_t mtime;
+		uint64_t contentHash;
+		// A CorpusScanner::Result.  Failed and Skipped files have no rows.
+		int32_t result;
+		int32_t platform;
+		// SerializedFile::Header.
+		int32_t metadataSize;
+		int32_t fileSize;
+		int32_t version;
+		int32_t objectDataOffset;
+		int32_t bigEndian;
+		uint32_t objectCount;
+		uint64_t firstObject;
+		uint64_t firstType;
+		uint64_t firstExternal;
+		uint32_t typeCount;
+		uint32_t externalCount;
+		String generatorVersion;
+	};
+
+	struct Type {
+		int32_t classID;
+		int32_t scriptID;
+		Hash typeHash;
+		Hash scriptHash;
+	};
+
+	struct External {
+		Hash guid;
+		int32_t type;
+		String assetName;
+		String fileName;
+		uint32_t padding;
+	};
+
+	// The object columns.  classID and typeIndex are resolved with SerializedFile::ClassID
+	// and TypeIndex, so they mean the same thing for every version.
+	struct Objects {
+		const uint64_t *objectID;
+		const int32_t *dataOffset;
+		const int32_t *dataSize;
+		const int32_t *classID;
+		const int32_t *typeIndex;
+	};
+
+	MetadataIndex() = default;
+	MetadataIndex(const MetadataIndex &) = delete;
+	MetadataIndex &operator=(const MetadataIndex &) = delete;
+
+	// Open maps an index file.  Returns false if it is missing, of another format version or
+	// byte order, or truncated.
+	bool Open(const char *path);
+	// Close unmaps the index, which must be done before Save replaces it on some platforms.
+	void Close();
+
+	size_t FileCount() const {
+		return header ? header->fileCount : 0;
+	}
+	// Find returns the entry for path, or nullptr.  Files are sorted by path.
+	const File *Find(const std::string &path) const;
+	std::string GetString(const String &string) const {
+		return std::string(strings + string.offset, string.length);
+	}
+
+	struct BuildStats {
+		// Entries copied from the previous index as they were, copied after their
+		// contentHash showed a changed mtime to be the only change, and read afresh.
+		size_t reused = 0;
+		size_t rehashed = 0;
+		size_t parsed = 0;
+		// Entries of the previous index whose files were not listed again.
+		size_t removed = 0;
+		double seconds = 0;
+	};
+
+	// Build indexes paths on pool into image, which Save writes out.  Files whose size and
+	// mtime, or failing that size and contentHash, match their entry in previous keep that
+	// entry; only the others are read.  Paths which cannot be stat'ed are left out.  If every
+	// entry of previous is still current, image is left empty and previous can be kept.
+	static BuildStats Build(const std::vector<std::string> &paths, const MetadataIndex *previous,
+		ThreadPool &pool, std::vector<char> &image);
+	// Save writes image to a temporary file beside path and renames it over path, so that
+	// readers never see a partly written index.
+	static bool Save(const char *path, const std::vector<char> &image);
+
+	const Header *header = nullptr;
+	const File *files = nullptr;
+	Objects objects{};
+	const Type *types = nullptr;
+	const External *externals = nullptr;
+	const char *strings = nullptr;
+
+private:
+	// Attach points the arrays into the image at data, returning false if they do not fit.
+	bool Attach(const char *data, size_t size);
+
+	MappedFile mapped;
+};
+
+};
@@ -0,0 +1,220 @@
+// This header contains a serializer which reads from memory instead of a FILE *.
+//
+// MmapReader walks a [begin, end) byte range with a cursor, so scalars are read with
+// a memcpy rather than a libc call.  The range is usually a MappedFile, but any
+// buffer which outlives the reader works.
+#pragma once
+
+#include "default.h"
+#include "Serialize.h"
+
+namespace unitypack {
+
+// MappedFile owns a read-only memory mapping of an entire file.
+struct MappedFile {
+	MappedFile() = default;
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+	MappedFile(MappedFile &&other);
+	MappedFile &operator=(MappedFile &&other);
+	~MappedFile() {
+		Close();
+	}
+
+	// Open maps path into memory, returning false if it could not be opened or mapped.
+	bool Open(const char *path);
+	void Close();
+
+	const char *data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	void *fileHandle = nullptr;
+	void *mappingHandle = nullptr;
+#endif
+};
+
+namespace serialize {
+
+template <Endian E = Endian::Runtime>
+struct MmapReaderT : SerializerBase {
+	const char *begin;
+	const char *cursor;
+	const char *end;
+	// CString data is not copied; cstring points at the string inside the range.
+	const char *cstring;
+	int stringIndex;
+
+	MmapReaderT() = default;
+
+	// Readers convert between byte orders, keeping their position and variables.
+	template <Endian F>
+	explicit MmapReaderT(const MmapReaderT<F> &other)
+		: SerializerBase(other), begin(other.begin), cursor(other.cursor), end(other.end),
+		cstring(other.cstring), stringIndex(other.stringIndex) {}
+
+	void SetRange(const char *data, size_t size) {
+		begin = data;
+		cursor = data;
+		end = data + size;
+	}
+
+	void SetRange(const MappedFile &file) {
+		SetRange(file.data, file.size);
+	}
+
+	// Tell returns the cursor's offset from the beginning of the range.
+	size_t Tell() const {
+		return (size_t)(cursor - begin);
+	}
+
+	// View returns a pointer to the next size bytes and advances past them, or
+	// returns nullptr when fewer than size bytes remain.
+	const char *View(size_t size) {
+		if ((size_t)(end - cursor) < size) {
+			errored = true;
+			eof = true;
+			return nullptr;
+		}
+		const char *data = cursor;
+		cursor += size;
+		return data;
+	}
+
+	template <typename T>
+	void Scalar(T &value) {
+		RecordScalar(&value, sizeof(T));
+		size_t stackSize = stack.size();
+		if (stackSize >= 3) {
+			// CString handling, see BinaryReader::Scalar.
+			auto &stringNode = stack[stackSize - 3];
+			if (stringNode.flags & Flags::CString) {
+				if (std::is_same<T, int>::value) {
+					const char *nul = (const char *)memchr(cursor, 0, end - cursor);
+					int size = 0;
+					cstring = cursor;
+					stringIndex = 0;
+					if (nul) {
+						size = (int)(nul - cursor);
+						cursor = nul + 1;
+					} else {
+						errored = true;
+						eof = true;
+					}
+					memcpy(&value, &size, sizeof(int));
+					return;
+				}
+				if (std::is_same<T, char>::value) {
+					char c = cstring[stringIndex++];
+					memcpy(&value, &c, sizeof(char));
+					return;
+				}
+			}
+		}
+
+		size_t sz = sizeof(T);
+		if (stackSize >= 1) {
+			auto &node = stack[stackSize - 1];
+			if (node.flags & Flags::PreAlign) {
+				Align();
+			}
+			if (node.flags & Flags::ValueIs32Bit) {
+				assert(sz >= 4);
+				sz = 4;
+			}
+		}
+		if ((size_t)(end - cursor) < sz) {
+			errored = true;
+			eof = true;
+		} else {
+			memcpy(&value, cursor, sz);
+			cursor += sz;
+			if (IsBigEndianAs<E>()) {
+				if (sz == 4) {
+					ByteSwap<uint32_t>(&value);
+				} else {
+					ByteSwap<T>(&value);
+				}
+			}
+		}
+
+		if (stackSize >= 1) {
+			auto &node = stack[stackSize - 1];
+			if (node.flags & Flags::PostAlign) {
+				Align();
+			}
+		}
+	}
+
+	template <typename T>
+	bool Block(const char *typeName, T *data, int count) {
+		Begin(typeName, "data", 0);
+		RecordScalar(data, count * (int)sizeof(T));
+		size_t stackSize = stack.size();
+		if (std::is_same<T, char>::value && stackSize >= 3 && (stack[stackSize - 3].flags & Flags::CString)) {
+			memcpy(data, cstring + stringIndex, count);
+			stringIndex += count;
+		} else if (const char *src = View(count * sizeof(T))) {
+			memcpy(data, src, count * sizeof(T));
+			if (IsBigEndianAs<E>()) {
+				BlockTraits<T>::Swap(data, count);
+			}
+		}
+		End();
+		return true;
+	}
+
+	bool Skip(size_t size) {
+		if (!View(size)) {
+			return false;
+		}
+		RecordSkip(size);
+		return true;
+	}
+
+	bool SkipCString() {
+		const char *nul = (const char *)memchr(cursor, 0, end - cursor);
+		if (!nul) {
+			errored = true;
+			eof = true;
+			return false;
+		}
+		RecordSkip((size_t)(nul + 1 - cursor));
+		cursor = nul + 1;
+		return true;
+	}
+
+	// Every element takes at least a byte of the range.  CString sizes were already
+	// measured against it.
+	bool CanHold(int count) {
+		size_t stackSize = stack.size();
+		if (stackSize >= 2 && (stack[stackSize - 2].flags & Flags::CString)) {
+			return true;
+		}
+		return (size_t)count <= (size_t)(end - cursor);
+	}
+
+	// End aligns after any PostAlign node, not only scalars, so that a struct or array
+	// may carry the alignment.  Aligning twice after a scalar is harmless.
+	void End() {
+		size_t stackSize = stack.size();
+		bool postAlign = stackSize >= 1 && !overflow && (stack[stackSize - 1].flags & Flags::PostAlign);
+		SerializerBase::End();
+		if (postAlign) {
+			Align();
+		}
+	}
+
+	void Align() {
+		size_t offset = Tell();
+		size_t alignment = ((offset + 3) & ~(size_t)3) - offset;
+		if (alignment > (size_t)(end - cursor)) {
+			alignment = (size_t)(end - cursor);
+		}
+		cursor += alignment;
+	}
+};
+
+using MmapReader = MmapReaderT<>;
+
+};
+};
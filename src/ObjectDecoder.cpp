@@ -0,0 +1,245 @@
+#include "ObjectDecoder.h"
+#include <algorithm>
+
+namespace unitypack {
+
+namespace {
+
+struct KindName {
+	const char *name;
+	ScalarKind kind;
+};
+
+const KindName kindNames[] = {
+	{ "bool", ScalarKind::Bool },
+	{ "char", ScalarKind::Char },
+	{ "SInt8", ScalarKind::Int8 },
+	{ "UInt8", ScalarKind::UInt8 },
+	{ "short", ScalarKind::Int16 },
+	{ "SInt16", ScalarKind::Int16 },
+	{ "unsigned short", ScalarKind::UInt16 },
+	{ "UInt16", ScalarKind::UInt16 },
+	{ "int", ScalarKind::Int32 },
+	{ "SInt32", ScalarKind::Int32 },
+	{ "unsigned int", ScalarKind::UInt32 },
+	{ "UInt32", ScalarKind::UInt32 },
+	{ "Type*", ScalarKind::UInt32 },
+	{ "long long", ScalarKind::Int64 },
+	{ "SInt64", ScalarKind::Int64 },
+	{ "unsigned long long", ScalarKind::UInt64 },
+	{ "UInt64", ScalarKind::UInt64 },
+	{ "FileSize", ScalarKind::UInt64 },
+	{ "float", ScalarKind::Float },
+	{ "double", ScalarKind::Double },
+};
+
+const int alignFlag = 0x4000;
+
+struct Compiler {
+	const TypeTree &tree;
+	DecodeProgram program;
+	int arrayDepth;
+
+	// End returns the index one past the last descendant of node i.
+	int End(int i) const {
+		int depth = tree.nodes[i].depth;
+		int j = i + 1;
+		while (j < (int)tree.nodes.size() && tree.nodes[j].depth > depth) {
+			j++;
+		}
+		return j;
+	}
+
+	uint32_t Emit(Instruction::Op op, int i, ScalarKind kind = ScalarKind::Raw, int size = 0) {
+		const TypeTreeNode &node = tree.nodes[i];
+		program.code.push_back(Instruction{ op, kind, (uint16_t)size, 0,
+			tree.GetString(node.type), tree.GetString(node.name) });
+		return (uint32_t)program.code.size() - 1;
+	}
+
+	// MinimumSize returns the fewest bytes the instructions from begin up to end read, at
+	// most 0xffff.  Every count takes 4 bytes; alignment may take none.
+	uint16_t MinimumSize(uint32_t begin, uint32_t end) const {
+		size_t size = 0;
+		for (uint32_t pc = begin; pc < end && size < 0xffff; pc++) {
+			const Instruction &insn = program.code[pc];
+			switch (insn.op) {
+			case Instruction::Scalar:
+				size += insn.size;
+				break;
+			case Instruction::BeginArray:
+				pc = insn.jump;
+				size += 4;
+				break;
+			case Instruction::ScalarArray:
+			case Instruction::String:
+				size += 4;
+				break;
+			default:
+				break;
+			}
+		}
+		return (uint16_t)std::min<size_t>(size, 0xffff);
+	}
+
+	// Leaf returns true and the kind of node i when it is a scalar leaf.
+	bool Leaf(int i, ScalarKind &kind, int &size) const {
+		const TypeTreeNode &node = tree.nodes[i];
+		if (End(i) != i + 1 || node.isArray) {
+			return false;
+		}
+		kind = ScalarKindOf(tree.GetString(node.type), node.byteSize);
+		size = kind == ScalarKind::Raw ? node.byteSize : ScalarSize(kind);
+		return size > 0 && size <= 0xffff;
+	}
+
+	void Node(int i) {
+		const TypeTreeNode &node = tree.nodes[i];
+		int end = End(i);
+		bool align = (node.metaFlag & alignFlag) != 0;
+		ScalarKind kind;
+		int size;
+
+		if (node.isArray) {
+			// Arrays have two children: int size, then the element.
+			int element = i + 2;
+			if (element >= end) {
+				Emit(Instruction::ScalarArray, i, ScalarKind::Raw, 1);
+			} else if (Leaf(element, kind, size) && !(tree.nodes[element].metaFlag & alignFlag)) {
+				// The block takes the element's type and the array's name.
+				uint32_t block = Emit(Instruction::ScalarArray, element, kind, size);
+				program.code[block].name = tree.GetString(node.name);
+			} else {
+				uint32_t begin = Emit(Instruction::BeginArray, i);
+				arrayDepth++;
+				if (arrayDepth > program.maxArrayDepth) {
+					program.maxArrayDepth = arrayDepth;
+				}
+				Node(element);
+				arrayDepth--;
+				uint32_t endArray = Emit(Instruction::EndArray, i);
+				program.code[begin].jump = endArray;
+				program.code[begin].size = MinimumSize(begin + 1, endArray);
+				program.code[endArray].jump = begin;
+			}
+		} else if (Leaf(i, kind, size)) {
+			Emit(Instruction::Scalar, i, kind, size);
+		} else if (end == i + 4 && strcmp(tree.GetString(node.type), "string") == 0 &&
+			tree.nodes[i + 1].isArray) {
+			// string is an array of char, which may carry the alignment itself.
+			Emit(Instruction::String, i, ScalarKind::Char, 1);
+			align = align || (tree.nodes[i + 1].metaFlag & alignFlag) != 0;
+		} else {
+			Emit(Instruction::BeginStruct, i);
+			for (int j = i + 1; j < end; j = End(j)) {
+				Node(j);
+			}
+			Emit(Instruction::EndStruct, i);
+		}
+
+		if (align) {
+			Emit(Instruction::Align, i);
+		}
+	}
+};
+
+};
+
+ScalarKind ScalarKindOf(const char *typeName, int byteSize) {
+	for (const KindName &kindName : kindNames) {
+		if (strcmp(typeName, kindName.name) == 0) {
+			return kindName.kind;
+		}
+	}
+	switch (byteSize) {
+	case 1: return ScalarKind::UInt8;
+	case 2: return ScalarKind::UInt16;
+	case 4: return ScalarKind::UInt32;
+	case 8: return ScalarKind::UInt64;
+	}
+	return ScalarKind::Raw;
+}
+
+int ScalarSize(ScalarKind kind) {
+	switch (kind) {
+	case ScalarKind::Bool:
+	case ScalarKind::Char:
+	case ScalarKind::Int8:
+	case ScalarKind::UInt8:
+		return 1;
+	case ScalarKind::Int16:
+	case ScalarKind::UInt16:
+		return 2;
+	case ScalarKind::Int32:
+	case ScalarKind::UInt32:
+	case ScalarKind::Float:
+		return 4;
+	case ScalarKind::Int64:
+	case ScalarKind::UInt64:
+	case ScalarKind::Double:
+		return 8;
+	case ScalarKind::Raw:
+		break;
+	}
+	return 0;
+}
+
+template <typename T>
+static T Load(const void *value) {
+	T v;
+	memcpy(&v, value, sizeof(T));
+	return v;
+}
+
+int64_t ScalarAsInt(ScalarKind kind, const void *value) {
+	switch (kind) {
+	case ScalarKind::Bool: return Load<uint8_t>(value) != 0;
+	case ScalarKind::Char: return Load<char>(value);
+	case ScalarKind::Int8: return Load<int8_t>(value);
+	case ScalarKind::UInt8: return Load<uint8_t>(value);
+	case ScalarKind::Int16: return Load<int16_t>(value);
+	case ScalarKind::UInt16: return Load<uint16_t>(value);
+	case ScalarKind::Int32: return Load<int32_t>(value);
+	case ScalarKind::UInt32: return Load<uint32_t>(value);
+	case ScalarKind::Int64: return Load<int64_t>(value);
+	case ScalarKind::UInt64: return (int64_t)Load<uint64_t>(value);
+	case ScalarKind::Float: return (int64_t)Load<float>(value);
+	case ScalarKind::Double: return (int64_t)Load<double>(value);
+	case ScalarKind::Raw: break;
+	}
+	return 0;
+}
+
+double ScalarAsDouble(ScalarKind kind, const void *value) {
+	switch (kind) {
+	case ScalarKind::Float: return Load<float>(value);
+	case ScalarKind::Double: return Load<double>(value);
+	case ScalarKind::UInt64: return (double)Load<uint64_t>(value);
+	default: return (double)ScalarAsInt(kind, value);
+	}
+}
+
+DecodeProgram CompileTypeTree(const TypeTree &tree) {
+	Compiler compiler{ tree, DecodeProgram{ {}, 0 }, 0 };
+	if (!tree.nodes.empty()) {
+		compiler.Node(0);
+	}
+	return std::move(compiler.program);
+}
+
+ObjectDecoder::ObjectDecoder(const SerializedFile &file)
+	: file(file), programs(file.metadata.types.size()),
+	compiled(new std::once_flag[file.metadata.types.size()]) {}
+
+const DecodeProgram *ObjectDecoder::Program(int typeIndex) {
+	if (typeIndex < 0 || typeIndex >= (int)programs.size()) {
+		return nullptr;
+	}
+	std::call_once(compiled[typeIndex], [&](){
+		programs[typeIndex] = CompileTypeTree(file.metadata.types[typeIndex].Tree());
+	});
+	const DecodeProgram &program = programs[typeIndex];
+	return program.code.empty() ? nullptr : &program;
+}
+
+};
@@ -0,0 +1,264 @@
+// This header contains the decoder for object payloads described by a TypeTree.
+//
+// A TypeTree is compiled once into a DecodeProgram, a flat list of instructions, which is
+// then run over each object of that type.  Running a program reports what it reads to a
+// visitor; it never builds a tree of values.
+#pragma once
+
+#include "default.h"
+#include "SerializedFile.h"
+#include <mutex>
+
+namespace unitypack {
+
+// ScalarKind identifies how the bytes of a TypeTree leaf are interpreted.
+enum class ScalarKind : uint8_t {
+	Bool,
+	Char,
+	Int8,
+	UInt8,
+	Int16,
+	UInt16,
+	Int32,
+	UInt32,
+	Int64,
+	UInt64,
+	Float,
+	Double,
+	// Raw is a leaf of unknown type; its bytes are passed through unconverted.
+	Raw,
+};
+
+// ScalarKindOf maps a TypeTree type name to the kind of its leaf, using byteSize for
+// unknown names.
+ScalarKind ScalarKindOf(const char *typeName, int byteSize);
+int ScalarSize(ScalarKind kind);
+// These convert a host-endian value of the given kind.
+int64_t ScalarAsInt(ScalarKind kind, const void *value);
+double ScalarAsDouble(ScalarKind kind, const void *value);
+
+struct Instruction {
+	enum Op : uint8_t {
+		// Read one scalar.
+		Scalar,
+		// Read an int count followed by count scalars, handed to the visitor as one block.
+		ScalarArray,
+		// Read an int length followed by that many chars.
+		String,
+		// Read an int count and run the instructions up to the matching EndArray count times.
+		BeginArray,
+		// Jump back to the matching BeginArray while elements remain.
+		EndArray,
+		BeginStruct,
+		EndStruct,
+		// Align the cursor to 4 bytes from the start of the object.
+		Align,
+	};
+
+	Op op;
+	ScalarKind kind;
+	// Size of a Scalar or of each ScalarArray element.  For BeginArray, the fewest bytes
+	// one element reads, at most 0xffff.
+	uint16_t size;
+	// For BeginArray the index of the matching EndArray, and the reverse.
+	uint32_t jump;
+	const char *type;
+	const char *name;
+};
+
+struct DecodeProgram {
+	std::vector<Instruction> code;
+	// Deepest nesting of BeginArray instructions.
+	int maxArrayDepth;
+};
+
+// CompileTypeTree flattens tree into a program.  The program refers to the tree's strings,
+// so tree must outlive it and not have strings added.
+DecodeProgram CompileTypeTree(const TypeTree &tree);
+
+// DecodeVisitor documents the callbacks which RunProgram makes.  Visitors derive from it
+// and hide the callbacks they are interested in; calls are resolved at compile time.
+// Values are always host-endian.
+struct DecodeVisitor {
+	void Scalar(const Instruction &insn, const void *value) {}
+	void ScalarArray(const Instruction &insn, const void *data, int count) {}
+	void String(const Instruction &insn, const char *data, int length) {}
+	void BeginArray(const Instruction &insn, int count) {}
+	void EndArray(const Instruction &insn) {}
+	void BeginStruct(const Instruction &insn) {}
+	void EndStruct(const Instruction &insn) {}
+};
+
+// SwapScratch is the buffer RunProgram swaps big-endian scalar arrays into.  There is one
+// per thread, reused from call to call, so a visitor must not run another program from its
+// ScalarArray callback.
+inline std::vector<char> &SwapScratch() {
+	static thread_local std::vector<char> scratch;
+	return scratch;
+}
+
+// RunProgram decodes one object from data, returning false if the object is truncated
+// or malformed.  The visitor may have seen part of the object when it fails.  An array
+// count is malformed if its elements could not fit in the bytes left, or, for elements
+// which may read nothing, if it is above MaxEmptyElements, so that a few corrupt bytes
+// cannot make the visitor run for billions of elements.
+template <typename Visitor>
+bool RunProgram(const DecodeProgram &program, const char *data, size_t size, bool bigEndian, Visitor &visitor) {
+	struct Loop {
+		uint32_t begin;
+		int remaining;
+	};
+	const int MaxArrayDepth = 64;
+	const int MaxEmptyElements = 1 << 16;
+	if (program.maxArrayDepth > MaxArrayDepth) {
+		return false;
+	}
+	Loop loops[MaxArrayDepth];
+	int depth = 0;
+
+	const char *cursor = data;
+	const char *end = data + size;
+	auto readCount = [&](int &count) {
+		if (end - cursor < 4) {
+			return false;
+		}
+		memcpy(&count, cursor, 4);
+		cursor += 4;
+		if (bigEndian) {
+			serialize::ByteSwap<int>(&count);
+		}
+		return count >= 0;
+	};
+
+	const Instruction *code = program.code.data();
+	uint32_t numInstructions = (uint32_t)program.code.size();
+	for (uint32_t pc = 0; pc < numInstructions; pc++) {
+		const Instruction &insn = code[pc];
+		switch (insn.op) {
+		case Instruction::Scalar: {
+			if ((size_t)(end - cursor) < insn.size) {
+				return false;
+			}
+			alignas(8) char value[8];
+			if (insn.kind == ScalarKind::Raw) {
+				visitor.Scalar(insn, cursor);
+			} else {
+				memcpy(value, cursor, insn.size);
+				if (bigEndian) {
+					switch (insn.size) {
+					case 2: serialize::ByteSwap<uint16_t>(value); break;
+					case 4: serialize::ByteSwap<uint32_t>(value); break;
+					case 8: serialize::ByteSwap<uint64_t>(value); break;
+					}
+				}
+				visitor.Scalar(insn, value);
+			}
+			cursor += insn.size;
+			break;
+		}
+		case Instruction::ScalarArray: {
+			int count;
+			if (!readCount(count) || (size_t)(end - cursor) / insn.size < (size_t)count) {
+				return false;
+			}
+			size_t bytes = (size_t)count * insn.size;
+			if (bigEndian && insn.size > 1 && count > 0) {
+				std::vector<char> &swapped = SwapScratch();
+				swapped.assign(cursor, cursor + bytes);
+				switch (insn.size) {
+				case 2: serialize::ByteSwapArray16(swapped.data(), count); break;
+				case 4: serialize::ByteSwapArray32(swapped.data(), count); break;
+				case 8: serialize::ByteSwapArray64(swapped.data(), count); break;
+				}
+				visitor.ScalarArray(insn, swapped.data(), count);
+			} else {
+				visitor.ScalarArray(insn, cursor, count);
+			}
+			cursor += bytes;
+			break;
+		}
+		case Instruction::String: {
+			int length;
+			if (!readCount(length) || end - cursor < length) {
+				return false;
+			}
+			visitor.String(insn, cursor, length);
+			cursor += length;
+			break;
+		}
+		case Instruction::BeginArray: {
+			int count;
+			if (!readCount(count)) {
+				return false;
+			}
+			if (insn.size ? (size_t)(end - cursor) / insn.size < (size_t)count : count > MaxEmptyElements) {
+				return false;
+			}
+			visitor.BeginArray(insn, count);
+			if (count == 0) {
+				visitor.EndArray(code[insn.jump]);
+				pc = insn.jump;
+			} else {
+				loops[depth++] = Loop{ pc, count };
+			}
+			break;
+		}
+		case Instruction::EndArray: {
+			Loop &loop = loops[depth - 1];
+			if (--loop.remaining > 0) {
+				pc = loop.begin;
+			} else {
+				depth--;
+				visitor.EndArray(insn);
+			}
+			break;
+		}
+		case Instruction::BeginStruct:
+			visitor.BeginStruct(insn);
+			break;
+		case Instruction::EndStruct:
+			visitor.EndStruct(insn);
+			break;
+		case Instruction::Align: {
+			size_t offset = (size_t)(cursor - data);
+			size_t aligned = (offset + 3) & ~(size_t)3;
+			if (aligned > size) {
+				return false;
+			}
+			cursor = data + aligned;
+			break;
+		}
+		}
+	}
+	return true;
+}
+
+// ObjectDecoder decodes the objects of one SerializedFile, compiling the program for each
+// TypeMetadata the first time an object of that type is decoded.  It is safe to decode
+// from several threads at once.
+struct ObjectDecoder {
+	explicit ObjectDecoder(const SerializedFile &file);
+	ObjectDecoder(const ObjectDecoder &) = delete;
+	ObjectDecoder &operator=(const ObjectDecoder &) = delete;
+
+	// Program returns the compiled program for metadata.types[typeIndex], or nullptr if
+	// the type has no tree.
+	const DecodeProgram *Program(int typeIndex);
+
+	// Decode runs object's program over its payload, data being the dataSize bytes at
+	// header.objectDataOffset + object.dataOffset.
+	template <typename Visitor>
+	bool Decode(const SerializedFile::ObjectInfo &object, const char *data, Visitor &visitor) {
+		const DecodeProgram *program = Program(file.TypeIndex(object));
+		if (!program) {
+			return false;
+		}
+		return RunProgram(*program, data, (size_t)object.dataSize, file.header.bigEndian, visitor);
+	}
+
+	const SerializedFile &file;
+	std::vector<DecodeProgram> programs;
+	std::unique_ptr<std::once_flag[]> compiled;
+};
+
+};
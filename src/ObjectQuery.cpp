@@ -0,0 +1,268 @@
+#include "ObjectQuery.h"
+#include <algorithm>
+#include <string_view>
+
+namespace unitypack {
+
+namespace {
+
+// NameCapture keeps the string read by the last instruction of a NamePlan's prefix.
+struct NameCapture : DecodeVisitor {
+	const Instruction *last;
+	const char *name = nullptr;
+	int length = 0;
+
+	void String(const Instruction &insn, const char *data, int size) {
+		if (&insn == last) {
+			name = data;
+			length = size;
+		}
+	}
+};
+
+// RunPrefix runs plan's prefix over the first size bytes of a payload.
+bool RunPrefix(const NamePlan &plan, const char *data, size_t size, bool bigEndian, NameCapture &capture) {
+	capture.last = &plan.prefix.code.back();
+	capture.name = nullptr;
+	return RunProgram(plan.prefix, data, size, bigEndian, capture) && capture.name;
+}
+
+int HexDigit(char c) {
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	}
+	if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	}
+	if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+	return -1;
+}
+
+};
+
+NamePlan PlanName(const DecodeProgram &program) {
+	NamePlan plan;
+	const std::vector<Instruction> &code = program.code;
+	int depth = 0;
+	int offset = 0;
+	bool fixed = true;
+	for (uint32_t pc = 0; pc < code.size(); pc++) {
+		const Instruction &insn = code[pc];
+		switch (insn.op) {
+		case Instruction::Scalar:
+			offset += insn.size;
+			break;
+		case Instruction::Align:
+			offset = (offset + 3) & ~3;
+			break;
+		case Instruction::BeginStruct:
+			depth++;
+			break;
+		case Instruction::EndStruct:
+			depth--;
+			break;
+		case Instruction::String:
+			if (depth == 1 && strcmp(insn.name, "m_Name") == 0) {
+				if (fixed) {
+					plan.offset = offset;
+				} else {
+					plan.prefix.code.assign(code.begin(), code.begin() + pc + 1);
+					plan.prefix.maxArrayDepth = program.maxArrayDepth;
+				}
+				return plan;
+			}
+			fixed = false;
+			break;
+		case Instruction::BeginArray:
+			// Nothing inside an array is a top-level field.
+			fixed = false;
+			pc = insn.jump;
+			break;
+		case Instruction::ScalarArray:
+		case Instruction::EndArray:
+			fixed = false;
+			break;
+		}
+	}
+	return plan;
+}
+
+bool ObjectQuery::TypeMatches(const SerializedFile &file, const SerializedFile::ObjectInfo &object) const {
+	if (!classIDs.empty() && std::find(classIDs.begin(), classIDs.end(), file.ClassID(object)) == classIDs.end()) {
+		return false;
+	}
+	if (typeIndices.empty() && !matchScriptHash) {
+		return true;
+	}
+	int typeIndex = file.TypeIndex(object);
+	if (!typeIndices.empty() && std::find(typeIndices.begin(), typeIndices.end(), typeIndex) == typeIndices.end()) {
+		return false;
+	}
+	return !matchScriptHash || (typeIndex >= 0 && file.metadata.types[typeIndex].scriptHash == scriptHash);
+}
+
+bool ObjectQuery::NameMatches(const char *data, int length) const {
+	std::string_view value(data, (size_t)length);
+	return namePrefix ? value.substr(0, name.size()) == name : value == name;
+}
+
+template <typename Asset, typename ReadName>
+std::vector<uint32_t> ObjectQuery::Select(Asset &asset, Stats *stats, ReadName &&readName) const {
+	const SerializedFile &file = asset.file;
+	auto &objects = file.metadata.objects;
+	// Plans are made the first time a type's name is needed.
+	std::vector<NamePlan> plans(file.metadata.types.size());
+	std::vector<bool> planned(file.metadata.types.size());
+	std::vector<uint32_t> selected;
+	Stats local;
+	for (uint32_t i = 0; i < objects.size(); i++) {
+		const SerializedFile::ObjectInfo &object = objects[i];
+		local.objects++;
+		if (!TypeMatches(file, object)) {
+			continue;
+		}
+		local.typeMatches++;
+		if (matchName) {
+			int typeIndex = file.TypeIndex(object);
+			if (typeIndex < 0) {
+				continue;
+			}
+			if (!planned[typeIndex]) {
+				const DecodeProgram *program = asset.decoder->Program(typeIndex);
+				if (program) {
+					plans[typeIndex] = PlanName(*program);
+				}
+				planned[typeIndex] = true;
+			}
+			const NamePlan &plan = plans[typeIndex];
+			const char *data;
+			int length;
+			if (!plan.HasName() || !readName(object, plan, data, length, local) || !NameMatches(data, length)) {
+				continue;
+			}
+		}
+		selected.push_back(i);
+	}
+	local.matches = selected.size();
+	if (stats) {
+		stats->objects += local.objects;
+		stats->typeMatches += local.typeMatches;
+		stats->fixedReads += local.fixedReads;
+		stats->prefixDecodes += local.prefixDecodes;
+		stats->nameBytes += local.nameBytes;
+		stats->matches += local.matches;
+	}
+	return selected;
+}
+
+std::vector<uint32_t> ObjectQuery::Select(AssetFile &asset, Stats *stats) const {
+	bool bigEndian = asset.file.header.bigEndian;
+	NameCapture capture;
+	return Select(asset, stats, [&](const SerializedFile::ObjectInfo &object, const NamePlan &plan,
+		const char *&data, int &length, Stats &local) {
+		const char *payload = asset.ObjectData(object);
+		if (!payload) {
+			return false;
+		}
+		size_t size = (size_t)object.dataSize;
+		if (plan.offset < 0) {
+			local.prefixDecodes++;
+			if (!RunPrefix(plan, payload, size, bigEndian, capture)) {
+				return false;
+			}
+			data = capture.name;
+			length = capture.length;
+			local.nameBytes += (size_t)(data + length - payload);
+			return true;
+		}
+		local.fixedReads++;
+		if (size < (size_t)plan.offset + 4) {
+			return false;
+		}
+		memcpy(&length, payload + plan.offset, 4);
+		if (bigEndian) {
+			serialize::ByteSwap<int>(&length);
+		}
+		if (length < 0 || (size_t)length > size - plan.offset - 4) {
+			return false;
+		}
+		data = payload + plan.offset + 4;
+		local.nameBytes += 4 + (size_t)length;
+		return true;
+	});
+}
+
+std::vector<uint32_t> ObjectQuery::Select(BundleAsset &asset, Stats *stats) const {
+	bool bigEndian = asset.file.header.bigEndian;
+	NameCapture capture;
+	std::vector<char> buffer;
+	return Select(asset, stats, [&](const SerializedFile::ObjectInfo &object, const NamePlan &plan,
+		const char *&data, int &length, Stats &local) {
+		size_t size = object.dataSize < 0 ? 0 : (size_t)object.dataSize;
+		if (plan.offset < 0) {
+			// How far m_Name lies is only known once the fields before it are read, so the
+			// window grows until the prefix fits in it.
+			local.prefixDecodes++;
+			size_t window = std::min(size, (size_t)256);
+			while (true) {
+				buffer.resize(window);
+				if (!asset.ReadObject(object, 0, window, buffer.data())) {
+					return false;
+				}
+				if (RunPrefix(plan, buffer.data(), window, bigEndian, capture)) {
+					break;
+				}
+				if (window == size) {
+					return false;
+				}
+				local.nameBytes += window;
+				window = std::min(size, window * 4);
+			}
+			data = capture.name;
+			length = capture.length;
+			local.nameBytes += window;
+			return true;
+		}
+		local.fixedReads++;
+		char count[4];
+		if (!asset.ReadObject(object, (uint64_t)plan.offset, 4, count)) {
+			return false;
+		}
+		memcpy(&length, count, 4);
+		if (bigEndian) {
+			serialize::ByteSwap<int>(&length);
+		}
+		if (length < 0 || (size_t)length > size - plan.offset - 4) {
+			return false;
+		}
+		buffer.resize((size_t)length);
+		if (length > 0 && !asset.ReadObject(object, (uint64_t)plan.offset + 4, buffer.size(), buffer.data())) {
+			return false;
+		}
+		data = buffer.data();
+		local.nameBytes += 4 + (size_t)length;
+		return true;
+	});
+}
+
+bool ObjectQuery::ParseHash(const char *text, Hash &hash) {
+	if (strlen(text) != 32) {
+		return false;
+	}
+	for (int i = 0; i < 4; i++) {
+		uint32_t word = 0;
+		for (int j = 0; j < 8; j++) {
+			int digit = HexDigit(text[i * 8 + j]);
+			if (digit < 0) {
+				return false;
+			}
+			word = word << 4 | (uint32_t)digit;
+		}
+		hash.hash[i] = word;
+	}
+	return true;
+}
+
+};
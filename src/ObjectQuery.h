@@ -0,0 +1,71 @@
+// This header contains queries which select objects by type and name without decoding them.
+#pragma once
+
+#include "default.h"
+#include "AssetFile.h"
+
+namespace unitypack {
+
+// ObjectQuery selects the objects of a file by class, TypeMetadata, script and m_Name.  Type
+// criteria are answered from the object table and TypeMetadata alone; only objects of a
+// matching type have their name read, and only the bytes up to the end of m_Name are touched.
+//
+// Where every field before a type's top-level m_Name has a fixed size, m_Name is at a fixed
+// offset of the payload, and reading it takes its length and characters.  Otherwise the
+// type's program is cut off after m_Name and run over the start of the payload.  Types
+// without a top-level m_Name never match a name.
+struct ObjectQuery {
+	// Empty lists accept any class or type.  typeIndices index metadata.types.
+	std::vector<int> classIDs;
+	std::vector<int> typeIndices;
+	bool matchScriptHash = false;
+	Hash scriptHash{};
+	// name matches m_Name exactly or, with namePrefix, as a prefix.
+	bool matchName = false;
+	bool namePrefix = false;
+	std::string name;
+
+	struct Stats {
+		size_t objects = 0;
+		// Objects whose type matched, and how many of their names were read at a fixed
+		// offset or by running the start of their program.
+		size_t typeMatches = 0;
+		size_t fixedReads = 0;
+		size_t prefixDecodes = 0;
+		// Bytes of payload read to get at names.
+		size_t nameBytes = 0;
+		size_t matches = 0;
+	};
+
+	// Select returns the indices into metadata.objects of the objects which match, in
+	// the order of the object table.  stats, when given, is added to.
+	std::vector<uint32_t> Select(AssetFile &asset, Stats *stats = nullptr) const;
+	// This Select reads names through the bundle's BlockCache, decompressing only the blocks
+	// which hold them.
+	std::vector<uint32_t> Select(BundleAsset &asset, Stats *stats = nullptr) const;
+
+	// ParseHash reads a Hash written as 32 hex digits, hash[0] first, as codegen prints it.
+	static bool ParseHash(const char *text, Hash &hash);
+
+private:
+	template <typename Asset, typename ReadName>
+	std::vector<uint32_t> Select(Asset &asset, Stats *stats, ReadName &&readName) const;
+	bool TypeMatches(const SerializedFile &file, const SerializedFile::ObjectInfo &object) const;
+	bool NameMatches(const char *data, int length) const;
+};
+
+// NamePlan is how a type's top-level m_Name is found in its payload.
+struct NamePlan {
+	// offset of m_Name's length, or -1 if fields of varying size come first.
+	int offset = -1;
+	// prefix is the type's program up to and including m_Name, used when offset is -1.
+	// Both are empty when the type has no top-level m_Name.
+	DecodeProgram prefix{ {}, 0 };
+
+	bool HasName() const {
+		return offset >= 0 || !prefix.code.empty();
+	}
+};
+NamePlan PlanName(const DecodeProgram &program);
+
+};
@@ -0,0 +1,114 @@
+#include "Profile.h"
+#include "Serialize.h"
+#include <algorithm>
+#include <map>
+
+namespace unitypack {
+namespace serialize {
+
+namespace {
+
+// Label names a frame after its node: fields by their name, and array elements, whose
+// name is always "data", by their type.
+std::string Label(const char *typeName, const char *name, int flags) {
+	std::string label;
+	if (flags & Flags::ConditionalIf) {
+		label = std::string("if (") + name + ")";
+	} else if (!*name || strcmp(name, "data") == 0) {
+		label = typeName;
+	} else {
+		label = name;
+	}
+	// ';' separates frames in the folded format.
+	for (char &c : label) {
+		if (c == ';') {
+			c = ',';
+		}
+	}
+	return label;
+}
+
+};
+
+Profile::Profile() {
+	frames.push_back(Frame{ 0, "", 0, 0, 0 });
+}
+
+void Profile::Enter(const char *typeName, const char *name, int flags) {
+	Key key{ current, typeName, name };
+	auto found = children.find(key);
+	uint32_t frame;
+	if (found != children.end()) {
+		frame = found->second;
+	} else {
+		frame = (uint32_t)frames.size();
+		frames.push_back(Frame{ current, Label(typeName, name, flags), 0, 0, 0 });
+		children.emplace(key, frame);
+	}
+	frames[frame].calls++;
+	open.push_back(Open{ frame, Clock::now() });
+	current = frame;
+}
+
+void Profile::Leave() {
+	Open top = open.back();
+	open.pop_back();
+	Frame &frame = frames[top.frame];
+	frame.nanoseconds += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - top.start).count();
+	current = frame.parent;
+}
+
+void Profile::Merge(const Profile &other) {
+	std::map<std::pair<uint32_t, std::string>, uint32_t> byLabel;
+	for (uint32_t i = 1; i < (uint32_t)frames.size(); i++) {
+		byLabel.emplace(std::make_pair(frames[i].parent, frames[i].label), i);
+	}
+	// Parents come before their children, so each parent is mapped before it is needed.
+	std::vector<uint32_t> mapped(other.frames.size(), 0);
+	for (uint32_t i = 1; i < (uint32_t)other.frames.size(); i++) {
+		const Frame &theirs = other.frames[i];
+		uint32_t parent = mapped[theirs.parent];
+		auto inserted = byLabel.emplace(std::make_pair(parent, theirs.label), (uint32_t)frames.size());
+		if (inserted.second) {
+			frames.push_back(Frame{ parent, theirs.label, 0, 0, 0 });
+		}
+		Frame &ours = frames[inserted.first->second];
+		ours.calls += theirs.calls;
+		ours.nanoseconds += theirs.nanoseconds;
+		ours.bytes += theirs.bytes;
+		mapped[i] = inserted.first->second;
+	}
+}
+
+void Profile::WriteFolded(FILE *fp, Metric metric) const {
+	std::vector<uint64_t> self(frames.size(), 0);
+	for (size_t i = 1; i < frames.size(); i++) {
+		switch (metric) {
+		case Metric::Time: self[i] += frames[i].nanoseconds; break;
+		case Metric::Bytes: self[i] += frames[i].bytes; break;
+		case Metric::Calls: self[i] += frames[i].calls; break;
+		}
+		if (metric == Metric::Time && frames[i].parent != 0) {
+			// Clock readings are not exact, so a parent may measure less than its children.
+			uint64_t &parent = self[frames[i].parent];
+			parent -= std::min(parent, frames[i].nanoseconds);
+		}
+	}
+	std::string path;
+	for (size_t i = 1; i < frames.size(); i++) {
+		if (self[i] == 0) {
+			continue;
+		}
+		path.clear();
+		for (uint32_t f = (uint32_t)i; f != 0; f = frames[f].parent) {
+			path.insert(0, frames[f].label);
+			if (frames[f].parent != 0) {
+				path.insert(0, ";");
+			}
+		}
+		fprintf(fp, "%s %llu\n", path.c_str(), (unsigned long long)self[i]);
+	}
+}
+
+};
+};
@@ -0,0 +1,84 @@
+// This header contains the profile which serializers fill in when built with UNITYPACK_PROFILE.
+#pragma once
+
+#include "default.h"
+#include <chrono>
+#include <unordered_map>
+
+namespace unitypack {
+namespace serialize {
+
+// Profile aggregates the calls, wall time and bytes of every node a serializer visits, per
+// path from the root: metadata;objects;SerializedFile::ObjectInfo;dataOffset is a different
+// frame than the dataOffset of another struct.  Serializers only fill one in when the build
+// defines UNITYPACK_PROFILE and their profile member points at it; otherwise SerializerBase
+// has no profile member and Begin and End carry no profiling code at all.
+//
+// A Profile is not thread-safe.  Give each thread its own and Merge them.
+struct Profile {
+	struct Frame {
+		uint32_t parent;
+		std::string label;
+		uint64_t calls;
+		// Time spent in the frame, including its children.
+		uint64_t nanoseconds;
+		// Bytes read into the frame's own values, or skipped over in it.
+		uint64_t bytes;
+	};
+
+	Profile();
+
+	void Enter(const char *typeName, const char *name, int flags);
+	void Leave();
+	void AddBytes(size_t size) {
+		frames[current].bytes += size;
+	}
+
+	// Merge adds other's frames to this profile's frames with the same path.
+	void Merge(const Profile &other);
+
+	enum class Metric {
+		Time,
+		Bytes,
+		Calls,
+	};
+	// WriteFolded writes one line per frame, "root;child;grandchild value", where value is
+	// the frame's own metric, excluding its children: the folded stack format which flame
+	// graph tools read.  Time is in nanoseconds.
+	void WriteFolded(FILE *fp, Metric metric) const;
+
+	// frames[0] is the root, which is never entered.
+	std::vector<Frame> frames;
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	// Frames are found by their parent and the addresses of their names, which are string
+	// literals, so that entering a frame does not compare strings.
+	struct Key {
+		uint32_t parent;
+		const char *typeName;
+		const char *name;
+
+		bool operator==(const Key &other) const {
+			return parent == other.parent && typeName == other.typeName && name == other.name;
+		}
+	};
+	struct KeyHasher {
+		size_t operator()(const Key &key) const {
+			return (size_t)key.parent * 31 ^ std::hash<const char *>()(key.typeName) ^
+				std::hash<const char *>()(key.name) * 17;
+		}
+	};
+	struct Open {
+		uint32_t frame;
+		Clock::time_point start;
+	};
+
+	std::unordered_map<Key, uint32_t, KeyHasher> children;
+	std::vector<Open> open;
+	uint32_t current = 0;
+};
+
+};
+};
@@ -0,0 +1,142 @@
+#include "ResourceFile.h"
+
+namespace unitypack {
+
+namespace {
+
+bool Stored(const BundleFile::StorageBlock &block) {
+	return (block.flags & BundleFile::CompressionMask) == BundleFile::None;
+}
+
+};
+
+bool ResourceFile::Open(const char *path) {
+	if (!mapped.Open(path)) {
+		return false;
+	}
+	begin = mapped.data;
+	size = mapped.size;
+	bundle = nullptr;
+	return true;
+}
+
+bool ResourceFile::Open(const BundleFile &bundle, const BundleFile::Node &node, BlockCache *cache) {
+	if (node.offset < 0 || node.size < 0 || (uint64_t)node.offset > bundle.dataSize ||
+		(uint64_t)node.size > bundle.dataSize - (uint64_t)node.offset) {
+		return false;
+	}
+	size = (uint64_t)node.size;
+	begin = bundle.NodeData(node);
+	if (begin) {
+		this->bundle = nullptr;
+		return true;
+	}
+	if (!cache) {
+		return false;
+	}
+	this->bundle = &bundle;
+	this->cache = cache;
+	offset = (uint64_t)node.offset;
+	return true;
+}
+
+const char *ResourceFile::View(uint64_t offset, uint64_t size) const {
+	if (offset > this->size || size > this->size - offset) {
+		return nullptr;
+	}
+	if (begin) {
+		return begin + offset;
+	}
+	if (!bundle || bundle->info.blocks.empty()) {
+		return nullptr;
+	}
+	// Blocks lie one after another in the bundle, so a range of stored blocks is a range
+	// of its mapping.  Any compressed block breaks the range, even an empty one, whose
+	// compressed bytes still lie between its neighbours.
+	uint64_t at = this->offset + offset;
+	uint64_t end = at + size;
+	size_t first = bundle->BlockAt(at);
+	for (size_t i = first; i < bundle->info.blocks.size() && bundle->blockOffsets[i] < end; i++) {
+		if (!Stored(bundle->info.blocks[i])) {
+			return nullptr;
+		}
+	}
+	return bundle->mapped.data + bundle->blockSources[first] + (at - bundle->blockOffsets[first]);
+}
+
+bool ResourceFile::Copy(uint64_t offset, uint64_t size, char *out) const {
+	return Read(offset, size, SIZE_MAX, [&](const char *data, size_t n) {
+		memcpy(out, data, n);
+		out += n;
+		return true;
+	});
+}
+
+bool ResourceFile::ReadBlocks(uint64_t offset, uint64_t size,
+	const std::function<bool(const char *, size_t)> &piece) const {
+	if (!bundle) {
+		return false;
+	}
+	uint64_t at = this->offset + offset;
+	uint64_t end = at + size;
+	for (size_t i = bundle->BlockAt(at); at < end; i++) {
+		auto &block = bundle->info.blocks[i];
+		size_t within = (size_t)(at - bundle->blockOffsets[i]);
+		size_t n = (size_t)std::min<uint64_t>(end - at, block.uncompressedSize - within);
+		if (n == 0) {
+			continue;
+		}
+		if (Stored(block)) {
+			if (!piece(bundle->mapped.data + bundle->blockSources[i] + within, n)) {
+				return false;
+			}
+		} else {
+			// The block is held until its piece is done with it, even if the cache evicts it.
+			BlockCache::Block cached = cache->Get(BlockCache::Key{ bundle->id, i }, [&](std::vector<char> &buffer) {
+				buffer.resize(block.uncompressedSize);
+				return bundle->ReadBlock(i, buffer.data());
+			});
+			if (!cached || !piece(cached->data() + within, n)) {
+				return false;
+			}
+		}
+		at += n;
+	}
+	return true;
+}
+
+ResourceResolver::ResourceResolver(std::string directory) : directory(std::move(directory)) {
+}
+
+ResourceResolver::ResourceResolver(const BundleFile &bundle, BlockCache *cache) : bundle(&bundle), cache(cache) {
+}
+
+const ResourceFile *ResourceResolver::Find(const std::string &path) {
+	std::string key = BundleFile::NameKey(path);
+	std::lock_guard<std::mutex> lock(mutex);
+	auto found = files.find(key);
+	if (found != files.end()) {
+		return found->second.get();
+	}
+	std::unique_ptr<ResourceFile> file(new ResourceFile());
+	bool opened = false;
+	if (bundle) {
+		for (auto &node : bundle->info.nodes) {
+			if (BundleFile::NameKey(node.path) == key) {
+				opened = file->Open(*bundle, node, cache);
+				break;
+			}
+		}
+	} else {
+		// The file is opened by its name as written; only the key ignores case.
+		size_t slash = path.find_last_of("/\\");
+		std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+		opened = file->Open((directory.empty() ? name : directory + "/" + name).c_str());
+	}
+	if (!opened) {
+		file.reset();
+	}
+	return (files[key] = std::move(file)).get();
+}
+
+};
@@ -0,0 +1,174 @@
+// This header contains the resource files (.resS, .resource) which streamed texture, mesh and
+// audio data is kept in, outside the objects which refer to it.
+#pragma once
+
+#include "default.h"
+#include "BlockCache.h"
+#include "BundleFile.h"
+#include "MmapReader.h"
+#include "ObjectDecoder.h"
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <mutex>
+
+namespace unitypack {
+
+// StreamingInfo is a range of a resource file, as an object's StreamingInfo (Texture2D,
+// Mesh) or StreamedResource (AudioClip, VideoClip) gives it.  path is as Unity wrote it,
+// such as "archive:/CAB-.../CAB-....resS" or "sharedassets0.assets.resS".
+struct StreamingInfo {
+	uint64_t offset = 0;
+	uint64_t size = 0;
+	std::string path;
+};
+
+// StreamingVisitor collects the StreamingInfo and StreamedResource structs of an object,
+// in the order they are read.  Those with an empty path or no bytes are left out, as Unity
+// writes them for data that was not streamed.
+struct StreamingVisitor : DecodeVisitor {
+	std::vector<StreamingInfo> streams;
+	int depth = 0;
+	// inStream is the depth of the struct being read, or 0.
+	int inStream = 0;
+	StreamingInfo current;
+
+	void BeginStruct(const Instruction &insn) {
+		depth++;
+		if (!inStream && (strcmp(insn.type, "StreamingInfo") == 0 || strcmp(insn.type, "StreamedResource") == 0)) {
+			inStream = depth;
+			current = StreamingInfo{};
+		}
+	}
+	void EndStruct(const Instruction &insn) {
+		if (inStream == depth) {
+			if (current.size > 0 && !current.path.empty()) {
+				streams.push_back(std::move(current));
+			}
+			inStream = 0;
+		}
+		depth--;
+	}
+	void Scalar(const Instruction &insn, const void *value) {
+		if (inStream != depth) {
+			return;
+		}
+		if (strcmp(insn.name, "offset") == 0 || strcmp(insn.name, "m_Offset") == 0) {
+			current.offset = (uint64_t)ScalarAsInt(insn.kind, value);
+		} else if (strcmp(insn.name, "size") == 0 || strcmp(insn.name, "m_Size") == 0) {
+			current.size = (uint64_t)ScalarAsInt(insn.kind, value);
+		}
+	}
+	void String(const Instruction &insn, const char *data, int length) {
+		if (inStream == depth && (strcmp(insn.name, "path") == 0 || strcmp(insn.name, "m_Source") == 0)) {
+			current.path.assign(data, (size_t)length);
+		}
+	}
+};
+
+// ResourceFile reads ranges of one resource file without copying them where it can.  A
+// file on disk is mapped, and so is a bundle decompressed whole by BundleFile::Open: ranges
+// of either are views of memory that is already there.  A node of a bundle opened with
+// BundleFile::OpenTables is read block by block through a BlockCache; its uncompressed
+// blocks are views of the bundle's mapping and only compressed ones are decompressed.
+struct ResourceFile {
+	ResourceFile() = default;
+	ResourceFile(const ResourceFile &) = delete;
+	ResourceFile &operator=(const ResourceFile &) = delete;
+
+	// Open maps the resource file at path.
+	bool Open(const char *path);
+	// Open reads node of bundle.  bundle, and cache when the bundle was opened with
+	// OpenTables, must outlive the ResourceFile.
+	bool Open(const BundleFile &bundle, const BundleFile::Node &node, BlockCache *cache = nullptr);
+
+	// View returns the size bytes at offset in place, or nullptr if they lie outside the file
+	// or any block their range touches is compressed.  The bytes stay valid while the file (and
+	// its bundle) is open.
+	const char *View(uint64_t offset, uint64_t size) const;
+	const char *View(const StreamingInfo &stream) const {
+		return View(stream.offset, stream.size);
+	}
+
+	// Read calls chunk(const char *data, size_t size) over the size bytes at offset, in order,
+	// in pieces of at most chunkSize bytes, and stops early if chunk returns false.  Pieces
+	// are views of a mapping or of a cached block, so only the blocks a piece lies in are
+	// held in memory at once.  Returns false if the range lies outside the file, a block is
+	// malformed, or chunk stopped.
+	template <typename Chunk>
+	bool Read(uint64_t offset, uint64_t size, size_t chunkSize, Chunk &&chunk) const {
+		if (offset > this->size || size > this->size - offset || chunkSize == 0) {
+			return false;
+		}
+		if (begin) {
+			return Split(begin + offset, size, chunkSize, chunk);
+		}
+		return ReadBlocks(offset, size, [&](const char *data, size_t n) {
+			return Split(data, n, chunkSize, chunk);
+		});
+	}
+	template <typename Chunk>
+	bool Read(const StreamingInfo &stream, size_t chunkSize, Chunk &&chunk) const {
+		return Read(stream.offset, stream.size, chunkSize, chunk);
+	}
+
+	// Copy reads the size bytes at offset into out.
+	bool Copy(uint64_t offset, uint64_t size, char *out) const;
+
+	MappedFile mapped;
+	// The file's bytes when they are all in memory: mapped, or a bundle's decompressed stream.
+	const char *begin = nullptr;
+	uint64_t size = 0;
+	// The bundle the file is a node of, and where the node starts in its stream, when it
+	// was opened with OpenTables.
+	const BundleFile *bundle = nullptr;
+	BlockCache *cache = nullptr;
+	uint64_t offset = 0;
+
+private:
+	template <typename Chunk>
+	static bool Split(const char *data, uint64_t size, size_t chunkSize, Chunk &chunk) {
+		while (size > 0) {
+			size_t n = (size_t)std::min<uint64_t>(size, chunkSize);
+			if (!chunk(data, n)) {
+				return false;
+			}
+			data += n;
+			size -= n;
+		}
+		return true;
+	}
+
+	// ReadBlocks calls piece over the bytes of each block the range covers.
+	bool ReadBlocks(uint64_t offset, uint64_t size, const std::function<bool(const char *, size_t)> &piece) const;
+};
+
+// ResourceResolver finds the resource files that StreamingInfo paths name, opening each
+// once.  Paths are matched by their last component, case-insensitively: among a bundle's
+// nodes for the SerializedFiles of a bundle, and in directory for files on disk.  Find
+// may be called from several threads.
+struct ResourceResolver {
+	// directory holds the resource files of SerializedFiles on disk; empty means the
+	// current directory.
+	explicit ResourceResolver(std::string directory);
+	// bundle's nodes are the resource files.  cache is needed when the bundle was opened
+	// with OpenTables, and both must outlive the resolver.
+	explicit ResourceResolver(const BundleFile &bundle, BlockCache *cache = nullptr);
+	ResourceResolver(const ResourceResolver &) = delete;
+	ResourceResolver &operator=(const ResourceResolver &) = delete;
+
+	// Find returns the resource file path names, or nullptr if it cannot be opened.
+	const ResourceFile *Find(const std::string &path);
+
+	std::string directory;
+	const BundleFile *bundle = nullptr;
+	BlockCache *cache = nullptr;
+
+private:
+	std::mutex mutex;
+	// Keyed by the lowercased last path component.  Files which failed to open are kept as
+	// nullptr, so that they are tried once.
+	std::map<std::string, std::unique_ptr<ResourceFile>> files;
+};
+
+};
@@ -1,16 +1,50 @@
 #include "Serialize.h"
 #include <string.h>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
 namespace unitypack {
 namespace serialize {
 
+template <> const char *type_string<bool>() { return "bool"; }
+template <> const char *type_string<char>() { return "char"; }
+template <> const char *type_string<int8_t>() { return "int8_t"; }
+template <> const char *type_string<uint8_t>() { return "uint8_t"; }
+template <> const char *type_string<int16_t>() { return "int16_t"; }
+template <> const char *type_string<uint16_t>() { return "uint16_t"; }
 template <> const char *type_string<int>() { return "int"; }
+template <> const char *type_string<uint32_t>() { return "uint32_t"; }
+template <> const char *type_string<int64_t>() { return "int64_t"; }
+template <> const char *type_string<uint64_t>() { return "uint64_t"; }
+template <> const char *type_string<float>() { return "float"; }
+template <> const char *type_string<double>() { return "double"; }
+template <> const char *type_string<std::string>() { return "string"; }
 
 void SerializerBase::Begin(const char *typeName, const char *name, int flags) {
+	if (overflow || stack.full()) {
+		overflow++;
+		errored = true;
+		return;
+	}
 	stack.push_back(SerializerBase::Node{ typeName, name, nullptr, (flags & Flags::Array) ? -1 : 0, flags });
+#ifdef UNITYPACK_PROFILE
+	if (profile) {
+		profile->Enter(typeName, name, flags);
+	}
+#endif
 }
 
 void SerializerBase::End() {
+	if (overflow) {
+		overflow--;
+		return;
+	}
 	auto &node = stack[stack.size() - 1];
 	if (node.flags & Flags::Variable) {
 		int value = 0;
@@ -19,7 +53,10 @@ void SerializerBase::End() {
 		case 2: value = *(int16_t *)node.data; break;
 		case 1: value = *(int8_t *)node.data; break;
 		}
-		SetVariable(node.name, value);
+		Var var = (Var)((unsigned)node.flags >> Flags::VariableShift);
+		if (var < Var::Count) {
+			SetVariable(var, value);
+		}
 	}
 	if (node.flags & Flags::BigEndianWhenTrue) {
 		bool value = false;
@@ -39,15 +76,11 @@ void SerializerBase::End() {
 		conditionWasTrue = false;
 	}
 	stack.pop_back();
-}
-
-bool SerializerBase::BeginIf(const char *varName, const char *condStr, std::function<bool(int)> condition) {
-	conditionWasTrue = condition(variables[varName]);
-	if (conditionWasTrue) {
-		Begin("if", condStr, Flags::ConditionalIf);
-		return true;
+#ifdef UNITYPACK_PROFILE
+	if (profile) {
+		profile->Leave();
 	}
-	return false;
+#endif
 }
 
 bool SerializerBase::BeginElse() {
@@ -68,6 +101,20 @@ void SerializerBase::RecordScalar(void *data, int size) {
 		}
 		node.size += size;
 	}
+#ifdef UNITYPACK_PROFILE
+	if (profile && stackSize >= 1) {
+		// Count the bytes the value takes in the stream: a CString stores a terminator
+		// instead of its size, and ValueIs32Bit values are narrowed.
+		int flags = stack[stackSize - 1].flags;
+		if (stackSize >= 3 && (stack[stackSize - 3].flags & Flags::CString) &&
+			strcmp(stack[stackSize - 1].name, "size") == 0) {
+			size = 1;
+		} else if (flags & Flags::ValueIs32Bit) {
+			size = 4;
+		}
+		profile->AddBytes((size_t)size);
+	}
+#endif
 }
 
 bool SerializerBase::IsBigEndian() const {
@@ -81,5 +128,100 @@ bool SerializerBase::IsBigEndian() const {
 	return false;
 }
 
+// The SIMD loops below handle whole vectors and leave the tail to ByteSwap<T>.
+// With SSSE3 or AVX2 the swap is a single byte shuffle; plain SSE2 has no byte shuffle,
+// so it swaps the bytes of each 16-bit word with shifts and then reorders the words.
+
+void ByteSwapArray16(void *data, size_t count) {
+	uint8_t *p = (uint8_t *)data;
+	size_t i = 0;
+#if defined(__AVX2__)
+	const __m256i mask = _mm256_setr_epi8(
+		1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+		1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+	for (; i + 16 <= count; i += 16) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(p + i * 2));
+		_mm256_storeu_si256((__m256i *)(p + i * 2), _mm256_shuffle_epi8(v, mask));
+	}
+#elif defined(__SSSE3__)
+	const __m128i mask = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+	for (; i + 8 <= count; i += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(p + i * 2));
+		_mm_storeu_si128((__m128i *)(p + i * 2), _mm_shuffle_epi8(v, mask));
+	}
+#elif defined(__SSE2__) || defined(_M_X64)
+	for (; i + 8 <= count; i += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(p + i * 2));
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		_mm_storeu_si128((__m128i *)(p + i * 2), v);
+	}
+#endif
+	for (; i < count; i++) {
+		ByteSwap<uint16_t>(p + i * 2);
+	}
+}
+
+void ByteSwapArray32(void *data, size_t count) {
+	uint8_t *p = (uint8_t *)data;
+	size_t i = 0;
+#if defined(__AVX2__)
+	const __m256i mask = _mm256_setr_epi8(
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	for (; i + 8 <= count; i += 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(p + i * 4));
+		_mm256_storeu_si256((__m256i *)(p + i * 4), _mm256_shuffle_epi8(v, mask));
+	}
+#elif defined(__SSSE3__)
+	const __m128i mask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	for (; i + 4 <= count; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(p + i * 4));
+		_mm_storeu_si128((__m128i *)(p + i * 4), _mm_shuffle_epi8(v, mask));
+	}
+#elif defined(__SSE2__) || defined(_M_X64)
+	for (; i + 4 <= count; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(p + i * 4));
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+		v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+		_mm_storeu_si128((__m128i *)(p + i * 4), v);
+	}
+#endif
+	for (; i < count; i++) {
+		ByteSwap<uint32_t>(p + i * 4);
+	}
+}
+
+void ByteSwapArray64(void *data, size_t count) {
+	uint8_t *p = (uint8_t *)data;
+	size_t i = 0;
+#if defined(__AVX2__)
+	const __m256i mask = _mm256_setr_epi8(
+		7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+		7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+	for (; i + 4 <= count; i += 4) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(p + i * 8));
+		_mm256_storeu_si256((__m256i *)(p + i * 8), _mm256_shuffle_epi8(v, mask));
+	}
+#elif defined(__SSSE3__)
+	const __m128i mask = _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+	for (; i + 2 <= count; i += 2) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(p + i * 8));
+		_mm_storeu_si128((__m128i *)(p + i * 8), _mm_shuffle_epi8(v, mask));
+	}
+#elif defined(__SSE2__) || defined(_M_X64)
+	for (; i + 2 <= count; i += 2) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(p + i * 8));
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+		v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+		_mm_storeu_si128((__m128i *)(p + i * 8), v);
+	}
+#endif
+	for (; i < count; i++) {
+		ByteSwap<uint64_t>(p + i * 8);
+	}
+}
+
 };
 };
@@ -5,38 +5,220 @@
 #pragma once
 
 #include "default.h"
-#include <functional>
-#include <unordered_map>
 #include <type_traits>
+#ifdef UNITYPACK_PROFILE
+#include "Profile.h"
+#endif
 
 namespace unitypack {
+
+struct TypeTreeCache;
+
 namespace serialize {
 
+enum Flags {
+	// This scalar value should always be serialized big-endian
+	BigEndian = 0x1,
+	// This integral value is a variable with which conditional serialization logic is defined,
+	// such as a version number.
+	Variable = 0x2,
+	// This boolean value determines the endianness of the rest of the stream.
+	BigEndianWhenTrue = 0x4,
+	// This std::string value should be serialized as a null-terminated string, not as an array of char.
+	CString = 0x8,
+	// This node is host to an array
+	Array = 0x10,
+	// This node is host to the taken branch of a conditional expression
+	ConditionalIf = 0x20,
+	// This node is host to the taken branch of a conditional expression
+	ConditionalElse = 0x40,
+	// This node has a scalar value which should serialize exactly 4 bytes
+	ValueIs32Bit = 0x80,
+	// This node contains a structure which is serialized recursively.
+	Recursive = 0x100,
+	// This node contains the count for an N-Ary tree node's children, where the serializer
+	// will recurse to the beginning of the current sibling list to serialize each child.
+	TreeNodeChildCount = 0x200,
+	// Align the stream to the next 4-byte boundary before serializing this node
+	PreAlign = 0x2000,
+	// Align the stream to the next 4-byte boundary after serializing this node
+	PostAlign = 0x4000,
+	// The Var slot of a Variable node is stored in the flags above this shift
+	VariableShift = 24,
+};
+
+// Endian selects how a reader decides the byte order of each scalar.  Runtime checks the
+// bigEndian bit and Flags::BigEndian for every scalar.  Little and Big fix the byte order
+// for the whole stream, so scalars are read without any endianness branch.
+enum class Endian {
+	Runtime,
+	Little,
+	Big,
+};
+
+// Var lists every variable that conditional serialization logic may depend on.  Each has a
+// fixed slot, so setting or testing a variable is an array index rather than a lookup by name.
+enum class Var : uint8_t {
+	version,
+	classID,
+	oldClassID,
+	serializeTypeTrees,
+	Count,
+};
+
+constexpr const char *VarNames[] = {
+	"version",
+	"classID",
+	"oldClassID",
+	"serializeTypeTrees",
+};
+
+constexpr bool StringsEqual(const char *a, const char *b) {
+	while (*a && *a == *b) {
+		a++;
+		b++;
+	}
+	return *a == *b;
+}
+
+// VarSlot maps a variable name to its slot, or Var::Count if it is not a variable.
+constexpr Var VarSlot(const char *name) {
+	for (int i = 0; i < (int)Var::Count; i++) {
+		if (StringsEqual(name, VarNames[i])) {
+			return (Var)i;
+		}
+	}
+	return Var::Count;
+}
+
+template <Var slot>
+constexpr Var CheckedVar() {
+	static_assert(slot != Var::Count, "not a serialization variable; add it to Var");
+	return slot;
+}
+
+// variable_flags stores name's slot in flags when they contain Flags::Variable.  Only then
+// must name be a variable, so that an unknown one fails to compile.
+template <Var slot, int flags>
+constexpr int variable_flags() {
+	if constexpr ((flags & Flags::Variable) != 0) {
+		return flags | (int)CheckedVar<slot>() << Flags::VariableShift;
+	} else {
+		return flags;
+	}
+}
+
+// FixedStack is a stack with inline storage, so that pushing never allocates.
+template <typename T, int Capacity>
+struct FixedStack {
+	T items[Capacity];
+	int count = 0;
+
+	size_t size() const {
+		return (size_t)count;
+	}
+	bool full() const {
+		return count == Capacity;
+	}
+	void push_back(const T &item) {
+		assert(count < Capacity);
+		items[count++] = item;
+	}
+	void pop_back() {
+		count--;
+	}
+	T &operator[](size_t i) {
+		return items[i];
+	}
+	const T &operator[](size_t i) const {
+		return items[i];
+	}
+};
+
 struct SerializerBase {
+	// Bit-fields cannot have default member initializers before C++20.
+	SerializerBase() : bigEndian(0), conditionWasTrue(0), errored(0), eof(0) {}
+
+	// Writes is true for serializers which only read the values they are given and never
+	// store into them, so that structures may hand them data they must not modify.
+	static constexpr bool Writes = false;
+
 	// Begin visits a new child node in the tree
 	void Begin(const char *typeName, const char *name, int flags);
 	// End goes up a level in the tree
 	void End();
 
-	// BeginIf returns true and visits a new child node when conditon(varName) is true.
-	bool BeginIf(const char *varName, const char *condStr, std::function<bool(int)> condition);
+	// BeginIf returns true and visits a new child node when conditon(variable) is true.
+	template <typename Condition>
+	bool BeginIf(Var var, const char *condStr, Condition &&condition) {
+		conditionWasTrue = condition(variables[(int)var]);
+		if (conditionWasTrue) {
+			Begin("if", condStr, Flags::ConditionalIf);
+			return true;
+		}
+		return false;
+	}
 
 	// BeginElse return true and visits a new child node when the previous sibling if node was false.
 	bool BeginElse();
 
 	// SetVariable configures the current node to set a variable to a constant value.
-	void SetVariable(const char *varName, int value) {
-		variables[varName] = value;
+	void SetVariable(Var var, int value) {
+		variables[(int)var] = value;
 	}
 
 	// Scalar makes the current node serialize a scalar value such as int or float.
 	template <typename T>
 	void Scalar(T &value) {}
 
+	// Block serializes count array elements as a single "data" node instead of one node per
+	// element.  T must satisfy BlockTraits.  It returns false when the serializer has no block
+	// path, and the caller must visit each element itself.
+	template <typename T>
+	bool Block(const char *typeName, T *data, int count) {
+		return false;
+	}
+
+	// Skip advances a reader past size bytes without serializing them.  It returns false
+	// when the serializer cannot skip.
+	bool Skip(size_t size) {
+		return false;
+	}
+
+	// SkipCString advances a reader past a NUL-terminated string.  It returns false when the
+	// serializer cannot skip.
+	bool SkipCString() {
+		return false;
+	}
+
+	// CanHold reports whether an array of count elements may follow, so that a corrupt size
+	// errors the reader instead of allocating the array.  Readers which cannot tell say yes.
+	bool CanHold(int count) {
+		return true;
+	}
+
 	// Called by Scalar to give the node a data pointer and size so that the data may be used later.
 	void RecordScalar(void *data, int size);
+	// Called by Skip and SkipCString with the number of bytes passed over.
+	void RecordSkip(size_t size) {
+#ifdef UNITYPACK_PROFILE
+		if (profile) {
+			profile->AddBytes(size);
+		}
+#endif
+	}
 
 	bool IsBigEndian() const;
+
+	// IsBigEndianAs is IsBigEndian for readers fixed to byte order E.
+	template <Endian E>
+	bool IsBigEndianAs() const {
+		if constexpr (E == Endian::Runtime) {
+			return IsBigEndian();
+		} else {
+			return E == Endian::Big;
+		}
+	}
 	bool IsErrored() const {
 		return errored;
 	}
@@ -48,8 +230,20 @@ struct SerializerBase {
 		int size;
 		int flags;
 	};
-	std::vector<SerializerBase::Node> stack;
-	std::unordered_map<const char *, int> variables;
+	// Nodes deeper than the stack's capacity are not stored; they error the serializer and
+	// are only counted so that Begin and End stay balanced.
+	FixedStack<SerializerBase::Node, 128> stack;
+	int overflow = 0;
+	int variables[(int)Var::Count] = {};
+	// Readers given a TypeTreeCache share TypeTrees with other files instead of parsing them.
+	TypeTreeCache *typeTrees = nullptr;
+	// skipFields selects fields which readers pass over instead of storing.  The bits are
+	// defined by the structures which honor them, such as SerializedFile::SkipFields.
+	uint32_t skipFields = 0;
+#ifdef UNITYPACK_PROFILE
+	// profile, when set, is given the calls, time and bytes of every node.
+	Profile *profile = nullptr;
+#endif
 	uint32_t bigEndian : 1;
 	uint32_t conditionWasTrue : 1;
 	uint32_t errored : 1;
@@ -64,46 +258,19 @@ struct SerializerBase {
 
 // These macros are used primarily to get strings for typeName and name.
 // They assume "Serializer &s" is present in the scope.
-#define SerializeScalarV(typeName, name, ...)  unitypack::serialize::scalar_val(s, name, #typeName, #name, __VA_ARGS__)
+#define SerializeScalarV(typeName, name, ...)  unitypack::serialize::scalar_val(s, name, #typeName, #name, \
+	unitypack::serialize::variable_flags<unitypack::serialize::VarSlot(#name), (__VA_ARGS__)>())
 #define SerializeScalar(typeName, name)        unitypack::serialize::scalar_val(s, name, #typeName, #name)
 #define SerializeStructV(typeName, name, ...)  unitypack::serialize::struct_val(s, name, #typeName, #name, __VA_ARGS__)
 #define SerializeStruct(typeName, name)        unitypack::serialize::struct_val(s, name, #typeName, #name)
 
 // Usage: SerializeIf(variable, variable > 0, [&](){ ... }, [&](){ ... })
+// The variable must be listed in Var.
 #define SerializeIf(varName, condition, ...) \
-	unitypack::serialize::ifcond(s, #varName, \
+	unitypack::serialize::ifcond(s, unitypack::serialize::CheckedVar<unitypack::serialize::VarSlot(#varName)>(), \
 	#condition, [](int varName) -> bool { return condition; }, \
 	__VA_ARGS__)
 
-enum Flags {
-	// This scalar value should always be serialized big-endian
-	BigEndian = 0x1,
-	// This integral value is a variable with which conditional serialization logic is defined,
-	// such as a version number.
-	Variable = 0x2,
-	// This boolean value determines the endianness of the rest of the stream.
-	BigEndianWhenTrue = 0x4,
-	// This std::string value should be serialized as a null-terminated string, not as an array of char.
-	CString = 0x8,
-	// This node is host to an array
-	Array = 0x10,
-	// This node is host to the taken branch of a conditional expression
-	ConditionalIf = 0x20,
-	// This node is host to the taken branch of a conditional expression
-	ConditionalElse = 0x40,
-	// This node has a scalar value which should serialize exactly 4 bytes
-	ValueIs32Bit = 0x80,
-	// This node contains a structure which is serialized recursively.
-	Recursive = 0x100,
-	// This node contains the count for an N-Ary tree node's children, where the serializer
-	// will recurse to the beginning of the current sibling list to serialize each child.
-	TreeNodeChildCount = 0x200,
-	// Align the stream to the next 4-byte boundary before serializing this node
-	PreAlign = 0x2000,
-	// Align the stream to the next 4-byte boundary after serializing this node
-	PostAlign = 0x4000,
-};
-
 template <typename T>
 void ByteSwap(void *v) {
 	static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8,
@@ -146,11 +313,52 @@ void ByteSwap(void *v) {
 	}
 }
 
-struct BinaryReader : SerializerBase {
+// These byte-swap count values in place, using SIMD where the target allows.
+void ByteSwapArray16(void *data, size_t count);
+void ByteSwapArray32(void *data, size_t count);
+void ByteSwapArray64(void *data, size_t count);
+
+template <typename T>
+void ByteSwapArray(T *data, size_t count) {
+	static_assert(std::is_integral<T>::value || std::is_floating_point<T>::value,
+		"T should be an integer or a float");
+	switch (sizeof(T)) {
+	case 2: ByteSwapArray16(data, count); break;
+	case 4: ByteSwapArray32(data, count); break;
+	case 8: ByteSwapArray64(data, count); break;
+	}
+}
+
+// BlockTraits<T>::value is true when T is serialized as exactly its in-memory bytes, with no
+// flags, conditionals or padding, so that an array of T may be copied as one block.
+// Swap converts count elements between big and little endian in place.
+// Structs opt in by specializing BlockTraits next to their definition.
+template <typename T, typename Enable = void>
+struct BlockTraits {
+	static constexpr bool value = false;
+};
+
+template <typename T>
+struct BlockTraits<T, typename std::enable_if<std::is_arithmetic<T>::value>::type> {
+	static constexpr bool value = true;
+	static void Swap(T *data, size_t count) {
+		ByteSwapArray(data, count);
+	}
+};
+
+template <Endian E = Endian::Runtime>
+struct BinaryReaderT : SerializerBase {
 	FILE *stream;
 	std::string cstring;
 	int stringIndex;
 
+	BinaryReaderT() = default;
+
+	// Readers convert between byte orders, keeping their position and variables.
+	template <Endian F>
+	explicit BinaryReaderT(const BinaryReaderT<F> &other)
+		: SerializerBase(other), stream(other.stream), cstring(other.cstring), stringIndex(other.stringIndex) {}
+
 	template <typename T>
 	void Scalar(T &value) {
 		RecordScalar(&value, sizeof(T));
@@ -206,7 +414,7 @@ struct BinaryReader : SerializerBase {
 				eof = true;
 			}
 		} else {
-			if (IsBigEndian()) {
+			if (IsBigEndianAs<E>()) {
 				if (sz == 4) {
 					ByteSwap<uint32_t>(&value);
 				} else {
@@ -223,6 +431,61 @@ struct BinaryReader : SerializerBase {
 		}
 	}
 
+	template <typename T>
+	bool Block(const char *typeName, T *data, int count) {
+		Begin(typeName, "data", 0);
+		RecordScalar(data, count * (int)sizeof(T));
+		size_t stackSize = stack.size();
+		if (std::is_same<T, char>::value && stackSize >= 3 && (stack[stackSize - 3].flags & Flags::CString)) {
+			memcpy(data, cstring.data() + stringIndex, count);
+			stringIndex += count;
+		} else if (fread(data, sizeof(T), count, stream) != (size_t)count) {
+			errored = true;
+			if (feof(stream)) {
+				eof = true;
+			}
+		} else if (IsBigEndianAs<E>()) {
+			BlockTraits<T>::Swap(data, count);
+		}
+		End();
+		return true;
+	}
+
+	bool Skip(size_t size) {
+		if (fseek(stream, (long)size, SEEK_CUR) != 0) {
+			errored = true;
+			return false;
+		}
+		RecordSkip(size);
+		return true;
+	}
+
+	bool SkipCString() {
+		int c;
+		size_t size = 1;
+		while ((c = getc(stream)) > 0) {
+			size++;
+		}
+		if (c == EOF) {
+			errored = true;
+			eof = true;
+			return false;
+		}
+		RecordSkip(size);
+		return true;
+	}
+
+	// End aligns after any PostAlign node, not only scalars, so that a struct or array
+	// may carry the alignment.  Aligning twice after a scalar is harmless.
+	void End() {
+		size_t stackSize = stack.size();
+		bool postAlign = stackSize >= 1 && !overflow && (stack[stackSize - 1].flags & Flags::PostAlign);
+		SerializerBase::End();
+		if (postAlign) {
+			Align();
+		}
+	}
+
 	void Align() {
 		int offset = ftell(stream);
 		int alignment = ((offset + 3) & -4) - offset;
@@ -232,9 +495,15 @@ struct BinaryReader : SerializerBase {
 	}
 };
 
+using BinaryReader = BinaryReaderT<>;
+
 template <typename T, typename Serializer>
 void serialize(Serializer &s, T &field) {
-	field.Serialize(s);
+	if constexpr (std::is_arithmetic<T>::value) {
+		s.Scalar(field);
+	} else {
+		field.Serialize(s);
+	}
 }
 
 template <typename T, typename Serializer>
@@ -251,17 +520,26 @@ void struct_val(Serializer &s, T &field, const char *typeName, const char *name,
 	s.End();
 }
 
-template <typename Serializer>
-void ifcond(Serializer &s, const char *varName, const char *condStr,
-	std::function<bool(int)> condition,
-	std::function<void()> thenLambda,
-	std::function<void()> elseLambda = nullptr)
+// ifcond takes its lambdas as template parameters so that conditions and branches inline.
+template <typename Serializer, typename Condition, typename Then>
+void ifcond(Serializer &s, Var var, const char *condStr,
+	Condition &&condition,
+	Then &&thenLambda)
 {
-	if (s.BeginIf(varName, condStr, condition)) {
+	if (s.BeginIf(var, condStr, condition)) {
 		thenLambda();
 		s.End();
 	}
-	if (elseLambda && s.BeginElse()) {
+}
+
+template <typename Serializer, typename Condition, typename Then, typename Else>
+void ifcond(Serializer &s, Var var, const char *condStr,
+	Condition &&condition,
+	Then &&thenLambda,
+	Else &&elseLambda)
+{
+	ifcond(s, var, condStr, condition, thenLambda);
+	if (s.BeginElse()) {
 		elseLambda();
 		s.End();
 	}
@@ -273,19 +551,40 @@ void begin_array(Serializer &s, int &size) {
 	s.Begin("int", "size", 0);
 	s.Scalar(size);
 	s.End();
+	if (size < 0 || !s.CanHold(size)) {
+		s.errored = true;
+		size = 0;
+	}
 }
 
-template <typename Serializer>
-void serialize(Serializer &s, std::string &field) {
-	int size = (int)field.size();
-	begin_array(s, size);
-	field.resize(size);
-	for (int i = 0; i < size; i++) {
+template <typename Traits, typename Alloc, typename Serializer>
+void serialize(Serializer &s, std::basic_string<char, Traits, Alloc> &field);
+
+template <typename U, typename Alloc, typename Serializer>
+void serialize(Serializer &s, std::vector<U, Alloc> &field);
+
+// array_val serializes the "data" elements of an array, in one block when T allows it.
+template <typename T, typename Serializer>
+void array_val(Serializer &s, const char *typeName, T *data, int count) {
+	if constexpr (BlockTraits<T>::value) {
+		if (count > 0 && s.Block(typeName, data, count)) {
+			return;
+		}
+	}
+	for (int i = 0; i < count; i++) {
 		if (s.IsErrored()) break;
-		s.Begin("char", "data", 0);
-		s.Scalar(field[i]);
+		s.Begin(typeName, "data", 0);
+		serialize(s, data[i]);
 		s.End();
 	}
+}
+
+template <typename Traits, typename Alloc, typename Serializer>
+void serialize(Serializer &s, std::basic_string<char, Traits, Alloc> &field) {
+	int size = (int)field.size();
+	begin_array(s, size);
+	field.resize(size);
+	array_val(s, "char", &field[0], size);
 	s.End();
 }
 
@@ -294,19 +593,26 @@ const char *type_string() {
 	return T::type_string;
 }
 
+template <> const char *type_string<bool>();
+template <> const char *type_string<char>();
+template <> const char *type_string<int8_t>();
+template <> const char *type_string<uint8_t>();
+template <> const char *type_string<int16_t>();
+template <> const char *type_string<uint16_t>();
 template <> const char *type_string<int>();
+template <> const char *type_string<uint32_t>();
+template <> const char *type_string<int64_t>();
+template <> const char *type_string<uint64_t>();
+template <> const char *type_string<float>();
+template <> const char *type_string<double>();
+template <> const char *type_string<std::string>();
 
-template <typename U, typename Serializer>
-void serialize(Serializer &s, std::vector<U> &field) {
+template <typename U, typename Alloc, typename Serializer>
+void serialize(Serializer &s, std::vector<U, Alloc> &field) {
 	int size = (int)field.size();
 	begin_array(s, size);
 	field.resize(size);
-	for (int i = 0; i < size; i++) {
-		if (s.IsErrored()) break;
-		s.Begin(type_string<U>(), "data", 0);
-		serialize(s, field[i]);
-		s.End();
-	}
+	array_val(s, type_string<U>(), field.data(), size);
 	s.End();
 }
 
@@ -1,19 +1,224 @@
 #include "SerializedFile.h"
+#include "BinaryWriter.h"
+#include <algorithm>
 
 namespace unitypack {
 
-const char TypeTree::globalBuffer[] =
-		"AABB\0AnimationClip\0AnimationCurve\0AnimationState\0Array\0Base\0BitField\0bitset\0bool\0char\0"
-		"ColorRGBA\0Component\0data\0deque\0double\0dynamic_array\0FastPropertyName\0first\0float\0Font\0"
-		"GameObject\0Generic Mono\0GradientNEW\0GUID\0GUIStyle\0int\0list\0long long\0map\0Matrix4x4f\0"
-		"MdFour\0MonoBehaviour\0MonoScript\0m_ByteSize\0m_Curve\0m_EditorClassIdentifier\0m_EditorHideFlags\0"
-		"m_Enabled\0m_ExtensionPtr\0m_GameObject\0m_Index\0m_IsArray\0m_IsStatic\0m_MetaFlag\0m_Name\0"
-		"m_ObjectHideFlags\0m_PrefabInternal\0m_PrefabParentObject\0m_Script\0m_StaticEditorFlags\0m_Type\0"
-		"m_Version\0Object\0pair\0PPtr<Component>\0PPtr<GameObject>\0PPtr<Material>\0PPtr<MonoBehaviour>\0"
-		"PPtr<MonoScript>\0PPtr<Object>\0PPtr<Prefab>\0PPtr<Sprite>\0PPtr<TextAsset>\0PPtr<Texture>\0"
-		"PPtr<Texture2D>\0PPtr<Transform>\0Prefab\0Quaternionf\0Rectf\0RectInt\0RectOffset\0second\0set\0"
-		"short\0size\0SInt16\0SInt32\0SInt64\0SInt8\0staticvector\0string\0TextAsset\0TextMesh\0Texture\0"
-		"Texture2D\0Transform\0TypelessData\0UInt16\0UInt32\0UInt64\0UInt8\0unsigned int\0unsigned long long\0"
-		"unsigned short\0vector\0Vector2f\0Vector3f\0Vector4f\0m_ScriptingClassIdentifier\0Gradient\0";
+// The global string table is a macro so that its hash index can be built at compile time.
+#define UNITYPACK_GLOBAL_STRINGS \
+	"AABB\0AnimationClip\0AnimationCurve\0AnimationState\0Array\0Base\0BitField\0bitset\0bool\0char\0" \
+	"ColorRGBA\0Component\0data\0deque\0double\0dynamic_array\0FastPropertyName\0first\0float\0Font\0" \
+	"GameObject\0Generic Mono\0GradientNEW\0GUID\0GUIStyle\0int\0list\0long long\0map\0Matrix4x4f\0" \
+	"MdFour\0MonoBehaviour\0MonoScript\0m_ByteSize\0m_Curve\0m_EditorClassIdentifier\0m_EditorHideFlags\0" \
+	"m_Enabled\0m_ExtensionPtr\0m_GameObject\0m_Index\0m_IsArray\0m_IsStatic\0m_MetaFlag\0m_Name\0" \
+	"m_ObjectHideFlags\0m_PrefabInternal\0m_PrefabParentObject\0m_Script\0m_StaticEditorFlags\0m_Type\0" \
+	"m_Version\0Object\0pair\0PPtr<Component>\0PPtr<GameObject>\0PPtr<Material>\0PPtr<MonoBehaviour>\0" \
+	"PPtr<MonoScript>\0PPtr<Object>\0PPtr<Prefab>\0PPtr<Sprite>\0PPtr<TextAsset>\0PPtr<Texture>\0" \
+	"PPtr<Texture2D>\0PPtr<Transform>\0Prefab\0Quaternionf\0Rectf\0RectInt\0RectOffset\0second\0set\0" \
+	"short\0size\0SInt16\0SInt32\0SInt64\0SInt8\0staticvector\0string\0TextAsset\0TextMesh\0Texture\0" \
+	"Texture2D\0Transform\0TypelessData\0UInt16\0UInt32\0UInt64\0UInt8\0unsigned int\0unsigned long long\0" \
+	"unsigned short\0vector\0Vector2f\0Vector3f\0Vector4f\0m_ScriptingClassIdentifier\0Gradient\0"
+
+const char TypeTree::globalBuffer[] = UNITYPACK_GLOBAL_STRINGS;
+const size_t TypeTree::globalBufferSize = sizeof(TypeTree::globalBuffer);
+
+namespace {
+
+// HashString is FNV-1a over the characters of str, also returning its length.
+constexpr uint32_t HashString(const char *str, size_t &length) {
+	uint32_t hash = 2166136261u;
+	size_t i = 0;
+	for (; str[i]; i++) {
+		hash = (hash ^ (uint8_t)str[i]) * 16777619u;
+	}
+	length = i;
+	return hash;
+}
+
+// GlobalIndex is an open-addressing table of globalBuffer offsets + 1.
+struct GlobalIndex {
+	static constexpr uint32_t Size = 256;
+	uint16_t slots[Size];
+};
+
+constexpr GlobalIndex BuildGlobalIndex(const char *strings) {
+	GlobalIndex index{};
+	for (size_t offset = 0; strings[offset];) {
+		size_t length = 0;
+		uint32_t slot = HashString(strings + offset, length) & (GlobalIndex::Size - 1);
+		while (index.slots[slot]) {
+			slot = (slot + 1) & (GlobalIndex::Size - 1);
+		}
+		index.slots[slot] = (uint16_t)(offset + 1);
+		offset += length + 1;
+	}
+	return index;
+}
+
+constexpr GlobalIndex globalIndex = BuildGlobalIndex(UNITYPACK_GLOBAL_STRINGS);
+static_assert(sizeof(UNITYPACK_GLOBAL_STRINGS) < 0xffff, "global string offsets must fit in 16 bits");
+
+void InsertLocal(std::pmr::vector<uint32_t> &index, uint32_t hash, uint32_t offset) {
+	size_t mask = index.size() - 1;
+	size_t slot = hash & mask;
+	while (index[slot]) {
+		slot = (slot + 1) & mask;
+	}
+	index[slot] = offset + 1;
+}
+
+};
+
+uint32_t TypeTree::GetIndex(const char *str) {
+	size_t length = 0;
+	uint32_t hash = HashString(str, length);
+
+	for (uint32_t slot = hash & (GlobalIndex::Size - 1);; slot = (slot + 1) & (GlobalIndex::Size - 1)) {
+		uint32_t entry = globalIndex.slots[slot];
+		if (!entry) break;
+		if (strcmp(globalBuffer + entry - 1, str) == 0) {
+			return 0x80000000u | (entry - 1);
+		}
+	}
+
+	// Index any strings which were added to buffer without going through GetIndex,
+	// growing the table to keep it at most half full.
+	auto &index = bufferIndex;
+	while (index.indexed < buffer.size()) {
+		const char *local = buffer.data() + index.indexed;
+		const char *nul = (const char *)memchr(local, 0, buffer.size() - index.indexed);
+		if (!nul) break;
+		if (2 * (index.count + 1) > index.slots.size()) {
+			std::pmr::vector<uint32_t> grown(index.slots.empty() ? 16 : index.slots.size() * 2, 0,
+				index.slots.get_allocator());
+			for (uint32_t entry : index.slots) {
+				if (entry) {
+					size_t entryLength = 0;
+					InsertLocal(grown, HashString(buffer.data() + entry - 1, entryLength), entry - 1);
+				}
+			}
+			index.slots.swap(grown);
+		}
+		size_t localLength = 0;
+		InsertLocal(index.slots, HashString(local, localLength), (uint32_t)index.indexed);
+		index.count++;
+		index.indexed += localLength + 1;
+	}
+
+	if (!index.slots.empty()) {
+		size_t mask = index.slots.size() - 1;
+		for (size_t slot = hash & mask; index.slots[slot]; slot = (slot + 1) & mask) {
+			uint32_t offset = index.slots[slot] - 1;
+			if (offset < buffer.size() && buffer.size() - offset > length && memcmp(buffer.data() + offset, str, length + 1) == 0) {
+				return offset;
+			}
+		}
+	}
+
+	size_t idx = buffer.size();
+	buffer.insert(buffer.end(), str, str + length + 1);
+	return (uint32_t)idx;
+}
+
+bool SerializedFile::Write(std::vector<char> &out) {
+	serialize::SizeCounter counter{};
+	serialize::struct_val(counter, header, "SerializedFile::Header", "header");
+	size_t headerSize = counter.offset;
+	serialize::struct_val(counter, metadata, "SerializedFile::Metadata", "metadata");
+	if (counter.IsErrored()) {
+		return false;
+	}
+	header.metadataSize = (int)(counter.offset - headerSize);
+
+	out.resize(counter.offset);
+	serialize::BinaryWriter writer{};
+	writer.SetBuffer(out.data(), out.size());
+	serialize::struct_val(writer, *this, "SerializedFile", "file");
+	return !writer.IsErrored() && writer.offset == out.size();
+}
+
+int SerializedFile::TypeIndex(const ObjectInfo &object) const {
+	if (header.version >= 17) {
+		if (object.typeIndex < 0 || object.typeIndex >= (int)metadata.types.size()) {
+			return -1;
+		}
+		return object.typeIndex;
+	}
+	if (typeIDs.size() != metadata.types.size()) {
+		for (size_t i = 0; i < metadata.types.size(); i++) {
+			if (metadata.types[i].oldClassID == object.typeID) {
+				return (int)i;
+			}
+		}
+		return -1;
+	}
+	auto found = std::lower_bound(typeIDs.begin(), typeIDs.end(), object.typeID,
+		[](const TypeID &entry, int typeID) { return entry.typeID < typeID; });
+	return found != typeIDs.end() && found->typeID == object.typeID ? found->index : -1;
+}
+
+void SerializedFile::IndexTypes() {
+	typeIDs.clear();
+	if (header.version >= 17) {
+		return;
+	}
+	typeIDs.reserve(metadata.types.size());
+	for (size_t i = 0; i < metadata.types.size(); i++) {
+		typeIDs.push_back(TypeID{ metadata.types[i].oldClassID, (int)i });
+	}
+	// Where types share an oldClassID, the first one wins, as it did for a scan.
+	std::sort(typeIDs.begin(), typeIDs.end(), [](const TypeID &a, const TypeID &b) {
+		return a.typeID != b.typeID ? a.typeID < b.typeID : a.index < b.index;
+	});
+}
+
+int SerializedFile::ClassID(const ObjectInfo &object) const {
+	if (header.version >= 17) {
+		int typeIndex = TypeIndex(object);
+		return typeIndex < 0 ? -1 : metadata.types[typeIndex].classID;
+	}
+	return object.classID;
+}
+
+TypeTreeCache &TypeTreeCache::Shared() {
+	static TypeTreeCache cache;
+	return cache;
+}
+
+std::shared_ptr<const TypeTree> TypeTreeCache::Find(const Hash &typeHash, const Hash &scriptHash) {
+	Key key{ typeHash, scriptHash };
+	Shard &shard = ShardOf(key);
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	auto found = shard.trees.find(key);
+	if (found == shard.trees.end()) {
+		shard.misses++;
+		return nullptr;
+	}
+	shard.hits++;
+	shard.bytesShared += found->second->nodes.size() * sizeof(TypeTreeNode) + found->second->buffer.size();
+	return found->second;
+}
+
+std::shared_ptr<const TypeTree> TypeTreeCache::Insert(const Hash &typeHash, const Hash &scriptHash, TypeTree &&tree) {
+	Key key{ typeHash, scriptHash };
+	// Cached trees outlive the file which parsed them, so they are moved out of its arena.
+	auto shared = std::make_shared<const TypeTree>(std::move(tree), TypeTree::allocator_type());
+	Shard &shard = ShardOf(key);
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	auto inserted = shard.trees.emplace(key, std::move(shared));
+	return inserted.first->second;
+}
+
+TypeTreeCache::Stats TypeTreeCache::GetStats() {
+	Stats stats{};
+	for (Shard &shard : shards) {
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		stats.hits += shard.hits;
+		stats.misses += shard.misses;
+		stats.trees += shard.trees.size();
+		stats.bytesShared += shard.bytesShared;
+	}
+	return stats;
+}
 
 }
@@ -2,12 +2,33 @@
 
 #include "default.h"
 #include "Serialize.h"
+#include <memory_resource>
+#include <mutex>
+#include <unordered_map>
 
 namespace unitypack {
 
+// Parsed metadata lives in std::pmr containers.  They use the heap unless the SerializedFile is
+// constructed with a memory resource, such as a std::pmr::monotonic_buffer_resource arena:
+// then parsing makes a few large allocations instead of one per string and array, and the
+// arena frees the whole file at once.  The structs which hold containers are allocator-aware
+// so that the arena reaches every level: each has an allocator_type, a constructor taking
+// one, and, when they are container elements, copy and move constructors taking one, which
+// assign into the new allocator.  Their allocator constructors are what std::pmr containers
+// build elements with, so every scalar has a default member initializer: fields a version
+// does not store stay zero, as they would in a value-initialized element.
+using MetadataAllocator = std::pmr::polymorphic_allocator<char>;
+
 struct Hash {
 	uint32_t hash[4];
 
+	bool IsZero() const {
+		return (hash[0] | hash[1] | hash[2] | hash[3]) == 0;
+	}
+	bool operator==(const Hash &other) const {
+		return memcmp(hash, other.hash, sizeof(hash)) == 0;
+	}
+
 	SerializeFn(Hash) {
 		SerializeScalar(uint32_t, hash[0]);
 		SerializeScalar(uint32_t, hash[1]);
@@ -38,44 +59,81 @@ struct TypeTreeNode {
 	}
 };
 
+namespace serialize {
+
+// TypeTreeNode is 24 bytes on disk and in memory, so node arrays are read as one block.
+template <>
+struct BlockTraits<TypeTreeNode> {
+	static constexpr bool value = true;
+	static void Swap(TypeTreeNode *nodes, size_t count) {
+		static_assert(sizeof(TypeTreeNode) == 24 && offsetof(TypeTreeNode, type) == 4,
+			"TypeTreeNode must match its serialized layout");
+		// Every field from type onwards is 32 bits, so swap the whole array as 32-bit words
+		// and then repair the leading version/depth/isArray word of each node.
+		ByteSwapArray32(nodes, count * sizeof(TypeTreeNode) / 4);
+		for (size_t i = 0; i < count; i++) {
+			uint8_t *head = (uint8_t *)&nodes[i];
+			uint8_t swapped[4] = { head[2], head[3], head[1], head[0] };
+			memcpy(head, swapped, sizeof(swapped));
+		}
+	}
+};
+
+};
+
 struct TypeTree {
-	std::vector<TypeTreeNode> nodes;
-	std::vector<char> buffer;
+	using allocator_type = MetadataAllocator;
+
+	TypeTree() = default;
+	TypeTree(const TypeTree &) = default;
+	TypeTree(TypeTree &&) = default;
+	explicit TypeTree(const allocator_type &alloc) : nodes(alloc), buffer(alloc), bufferIndex(alloc) {}
+	TypeTree(const TypeTree &other, const allocator_type &alloc) : TypeTree(alloc) {
+		*this = other;
+	}
+	TypeTree(TypeTree &&other, const allocator_type &alloc) : TypeTree(alloc) {
+		*this = std::move(other);
+	}
+	TypeTree &operator=(const TypeTree &) = default;
+	TypeTree &operator=(TypeTree &&) = default;
+
+	std::pmr::vector<TypeTreeNode> nodes;
+	std::pmr::vector<char> buffer;
 
 	const char *GetString(uint32_t index) const {
 		if (index & 0x80000000u) {
+			if (globalBufferSize <= (index & 0x7fffffffu)) {
+				return "";
+			}
 			return globalBuffer + (index & 0x7fffffffu);
 		} else {
-			if (buffer.size() <= index) {
+			// A buffer read from a file need not end with a terminator.
+			if (buffer.size() <= index || buffer.back() != '\0') {
 				return "";
 			}
 			return buffer.data() + index;
 		}
 	}
 
-	uint32_t GetIndex(const char *str) {
-		for (const char *g = globalBuffer; *g;) {
-			if (strcmp(str, g) == 0) {
-				return 0x80000000u | (uint32_t)(g - globalBuffer);
-			}
-			g += 1 + strlen(g);
-		}
-		for (size_t i = 0; i < buffer.size();) {
-			if (strcmp(str, buffer.data() + i) == 0) {
-				return (uint32_t)i;
-			}
-			i += 1 + strlen(buffer.data());
-		}
-		size_t idx = buffer.size();
-		size_t sz = 1 + strlen(str);
-		buffer.resize(idx + sz);
-		for (size_t i = 0; i < sz; i++) {
-			buffer[idx + i] = str[i];
-		}
-		return (uint32_t)idx;
-	}
+	// GetIndex returns the index of str, adding it to buffer if it is not yet a global or
+	// local string.  Both lookups are hashed; the local index is extended lazily to cover
+	// strings which were deserialized into buffer.
+	uint32_t GetIndex(const char *str);
+
+	// LocalIndex is an open-addressing table of buffer offsets + 1.  It holds count strings
+	// and covers the first `indexed` bytes of buffer.
+	struct LocalIndex {
+		LocalIndex() = default;
+		explicit LocalIndex(const allocator_type &alloc) : slots(alloc) {}
+
+		std::pmr::vector<uint32_t> slots;
+		size_t count = 0;
+		size_t indexed = 0;
+	};
+	LocalIndex bufferIndex;
 
 	static const char globalBuffer[];
+	static const size_t globalBufferSize;
 
 	SerializeFn(TypeTree) {
 		using serialize::Flags;
@@ -84,25 +142,35 @@ struct TypeTree {
 		SerializeIf(version, version == 10 || version >= 12, [&](){
 			int numNodes = (int)nodes.size();
 			SerializeScalar(int, numNodes);
-			nodes.resize(numNodes);
-
 			int bufferSize = (int)buffer.size();
 			SerializeScalar(int, bufferSize);
-			buffer.resize(bufferSize);
+			if constexpr (!Serializer::Writes) {
+				if (numNodes < 0 || bufferSize < 0 || !s.CanHold(numNodes) || !s.CanHold(bufferSize)) {
+					s.errored = true;
+					numNodes = 0;
+					bufferSize = 0;
+				}
+				nodes.resize(numNodes);
+				buffer.resize(bufferSize);
+				// The strings are about to be replaced, so offsets indexed from the old ones no
+				// longer hold.
+				bufferIndex = LocalIndex(buffer.get_allocator());
+			}
 
 			s.Begin("Array", "Array", Flags::Array);
-			for (int i = 0; i < numNodes; i++) {
-				unitypack::serialize::struct_val(s, nodes[i], "TypeTreeNode", "data");
-			}
+			unitypack::serialize::array_val(s, "TypeTreeNode", nodes.data(), numNodes);
 			s.End();
 
 			s.Begin("Array", "Array", Flags::Array);
-			for (int i = 0; i < bufferSize; i++) {
-				unitypack::serialize::scalar_val(s, buffer[i], "char", "data");
-			}
+			unitypack::serialize::array_val(s, "char", buffer.data(), bufferSize);
 			s.End();
 		}, [&](){
 			if (nodes.size() < 1) {
+				if constexpr (Serializer::Writes) {
+					// A legacy tree has at least its root.
+					s.errored = true;
+					return;
+				}
 				nodes.resize(1);
 			}
 			int numNodesKnown = 1;
@@ -111,29 +179,65 @@ struct TypeTree {
 		});
 	}
 
+	// SerializeSkipped advances a reader past a tree without storing it.  New-format trees
+	// give their node and string sizes up front; legacy trees are walked node by node.
+	template <typename Serializer>
+	static void SerializeSkipped(Serializer &s) {
+		s.Begin("TypeTree", "tree", 0);
+		SerializeIf(version, version == 10 || version >= 12, [&](){
+			int numNodes = 0;
+			int bufferSize = 0;
+			SerializeScalar(int, numNodes);
+			SerializeScalar(int, bufferSize);
+			if (numNodes < 0 || bufferSize < 0 ||
+				!s.Skip((size_t)numNodes * sizeof(TypeTreeNode) + (size_t)bufferSize)) {
+				s.errored = true;
+			}
+		}, [&](){
+			// A legacy node is its type and name strings, byteSize, index, isArray, version
+			// and metaFlag, and then its children.
+			for (int pending = 1; pending > 0 && !s.IsErrored(); pending--) {
+				if (!s.SkipCString() || !s.SkipCString() || !s.Skip(5 * sizeof(int))) {
+					s.errored = true;
+					break;
+				}
+				int numChildren = 0;
+				SerializeScalar(int, numChildren);
+				if (numChildren < 0 || !s.CanHold(numChildren)) {
+					s.errored = true;
+					break;
+				}
+				pending += numChildren;
+			}
+		});
+		s.End();
+	}
+
 	template <typename Serializer>
 	void SerializeRecursiveNode(Serializer &s, TypeTreeNode *node, int &i, int depth, int &numNodesKnown) {
 		using serialize::Flags;
 
 		s.Begin("TypeTreeNode", "node", Flags::Recursive);
 
-		std::string type = GetString(node->type);
-		std::string name = GetString(node->name);
-		SerializeStruct(string, type);
-		SerializeStruct(string, name);
-		node->type = GetIndex(type.c_str());
-		node->name = GetIndex(name.c_str());
-
+		// Long names would otherwise take a heap allocation each, even when parsing into an arena.
+		std::pmr::string type(GetString(node->type), buffer.get_allocator());
+		std::pmr::string name(GetString(node->name), buffer.get_allocator());
+		SerializeStructV(string, type, Flags::CString);
+		SerializeStructV(string, name, Flags::CString);
+		int isArray = node->isArray;
+		int version = node->version;
 		unitypack::serialize::scalar_val(s, node->byteSize, "int", "byteSize");
 		unitypack::serialize::scalar_val(s, node->index, "int", "index");
-		int isArray = node->isArray;
 		unitypack::serialize::scalar_val(s, isArray, "int", "isArray");
-		node->isArray = isArray != 0;
-		int version = node->version;
 		unitypack::serialize::scalar_val(s, version, "int", "version");
-		node->version = (uint16_t)version;
 		unitypack::serialize::scalar_val(s, node->metaFlag, "int", "metaFlag");
-		node->depth = (uint8_t)depth;
+		if constexpr (!Serializer::Writes) {
+			node->type = GetIndex(type.c_str());
+			node->name = GetIndex(name.c_str());
+			node->isArray = isArray != 0;
+			node->version = (uint16_t)version;
+			node->depth = (uint8_t)depth;
+		}
 
 		int numChildren = 0;
 		for (int j = i + 1; j < (int)nodes.size(); j++) {
@@ -142,8 +246,13 @@ struct TypeTree {
 		}
 		s.Begin("Array", "Array", Flags::Array);
 		SerializeScalarV(int, numChildren, Flags::TreeNodeChildCount);
+		if (numChildren < 0 || !s.CanHold(numChildren)) {
+			s.errored = true;
+			numChildren = 0;
+		}
 		numNodesKnown += numChildren;
 		if (numNodesKnown > (int)nodes.size()) {
+			// Only readers get here: writers count the children the nodes already have.
 			nodes.resize(numNodesKnown);
 		}
 		for (int j = 0; j < numChildren; j++) {
@@ -156,13 +265,72 @@ struct TypeTree {
 	}
 };
 
+// TypeTreeCache shares parsed TypeTrees between SerializedFiles.  Trees are keyed by the
+// typeHash and scriptHash of their TypeMetadata, and are immutable once cached.  It is safe
+// to use from several threads.
+struct TypeTreeCache {
+	// Shared returns the process-wide cache.
+	static TypeTreeCache &Shared();
+
+	// Find returns the cached tree for the hashes, or nullptr.
+	std::shared_ptr<const TypeTree> Find(const Hash &typeHash, const Hash &scriptHash);
+	// Insert caches tree, returning the tree which is cached for the hashes afterwards: tree
+	// itself, or one another thread inserted first.
+	std::shared_ptr<const TypeTree> Insert(const Hash &typeHash, const Hash &scriptHash, TypeTree &&tree);
+
+	struct Stats {
+		size_t hits;
+		size_t misses;
+		size_t trees;
+		// Bytes of nodes and strings which hits did not have to store again.
+		size_t bytesShared;
+	};
+	Stats GetStats();
+
+private:
+	struct Key {
+		Hash typeHash;
+		Hash scriptHash;
+
+		bool operator==(const Key &other) const {
+			return typeHash == other.typeHash && scriptHash == other.scriptHash;
+		}
+	};
+	struct KeyHasher {
+		size_t operator()(const Key &key) const {
+			// The hashes are already uniformly distributed.
+			return (size_t)(((uint64_t)key.typeHash.hash[0] << 32 | key.typeHash.hash[1]) ^ key.scriptHash.hash[0]);
+		}
+	};
+	struct Shard {
+		std::mutex mutex;
+		std::unordered_map<Key, std::shared_ptr<const TypeTree>, KeyHasher> trees;
+		size_t hits = 0;
+		size_t misses = 0;
+		size_t bytesShared = 0;
+	};
+	static const int NumShards = 16;
+	Shard shards[NumShards];
+
+	Shard &ShardOf(const Key &key) {
+		return shards[key.typeHash.hash[2] % NumShards];
+	}
+};
+
 struct SerializedFile {
+	// Fields readers pass over when their bit is set in SerializerBase::skipFields.  Skipped
+	// fields are left empty.
+	enum SkipFields : uint32_t {
+		// TypeMetadata::tree, which only object decoding needs.
+		SkipTypeTrees = 1 << 0,
+	};
+
 	struct Header {
-		int metadataSize;
-		int fileSize;
-		int version;
-		int objectDataOffset;
-		bool bigEndian;
+		int metadataSize = 0;
+		int fileSize = 0;
+		int version = 0;
+		int objectDataOffset = 0;
+		bool bigEndian = false;
 
 		SerializeFn(SerializedFile::Header) {
 			using serialize::Flags;
@@ -175,24 +343,45 @@ struct SerializedFile {
 	};
 
 	struct TypeMetadata {
-		int oldClassID;
-		int classID;
-		uint8_t unk0;
-		int16_t scriptID;
-		Hash scriptHash;
-		Hash typeHash;
+		using allocator_type = MetadataAllocator;
+
+		TypeMetadata() = default;
+		TypeMetadata(const TypeMetadata &) = default;
+		TypeMetadata(TypeMetadata &&) = default;
+		explicit TypeMetadata(const allocator_type &alloc) : tree(alloc) {}
+		TypeMetadata(const TypeMetadata &other, const allocator_type &alloc) : TypeMetadata(alloc) {
+			*this = other;
+		}
+		TypeMetadata(TypeMetadata &&other, const allocator_type &alloc) : TypeMetadata(alloc) {
+			*this = std::move(other);
+		}
+		TypeMetadata &operator=(const TypeMetadata &) = default;
+		TypeMetadata &operator=(TypeMetadata &&) = default;
+
+		int oldClassID = 0;
+		int classID = 0;
+		uint8_t unk0 = 0;
+		int16_t scriptID = 0;
+		Hash scriptHash{};
+		Hash typeHash{};
 		TypeTree tree;
+		// sharedTree replaces tree when the tree came from a TypeTreeCache.
+		std::shared_ptr<const TypeTree> sharedTree;
+
+		const TypeTree &Tree() const {
+			return sharedTree ? *sharedTree : tree;
+		}
 
 		SerializeFn(SerializedFile::TypeMetadata) {
 			using serialize::Flags;
 			SerializeIf(version, version >= 17, [&](){
-				s.SetVariable("oldClassID", 0);
+				s.SetVariable(serialize::Var::oldClassID, 0);
 				SerializeScalarV(int, classID, Flags::Variable);
 				SerializeScalar(uint8_t, unk0);
 				SerializeScalar(int16_t, scriptID);
 			}, [&](){
 				SerializeScalarV(int, oldClassID, Flags::Variable);
-				s.SetVariable("classID", 0);
+				s.SetVariable(serialize::Var::classID, 0);
 			});
 			SerializeIf(version, version >= 13, [&](){
 				SerializeIf(oldClassID, oldClassID < 0, [&](){
@@ -204,9 +393,41 @@ struct SerializedFile {
 				SerializeStruct(Hash, typeHash);
 			});
 			SerializeIf(serializeTypeTrees, serializeTypeTrees != 0, [&](){
-				SerializeStruct(TypeTree, tree);
+				if constexpr (Serializer::Writes) {
+					// Writers only read the tree, so a shared one is written where it is, and
+					// stays shared.
+					serialize::struct_val(s, const_cast<TypeTree &>(Tree()), "TypeTree", "tree");
+				} else if (s.skipFields & SkipTypeTrees) {
+					TypeTree::SerializeSkipped(s);
+				} else if (!s.typeTrees || typeHash.IsZero()) {
+					// Readers without a cache work on a private copy of a shared tree.
+					if (sharedTree) {
+						tree = *sharedTree;
+						sharedTree.reset();
+					}
+					SerializeStruct(TypeTree, tree);
+				} else {
+					SerializeSharedTree(s);
+				}
 			});
 		}
+
+		// SerializeSharedTree reads the tree through the reader's TypeTreeCache.  Hashes are
+		// only stored by versions which use the new tree format, whose node and string sizes
+		// are known up front, so a tree which is already cached is skipped over whole.
+		template <typename Serializer>
+		void SerializeSharedTree(Serializer &s) {
+			sharedTree = s.typeTrees->Find(typeHash, scriptHash);
+			if (!sharedTree) {
+				SerializeStruct(TypeTree, tree);
+				if (!s.IsErrored()) {
+					sharedTree = s.typeTrees->Insert(typeHash, scriptHash, std::move(tree));
+				}
+				tree = TypeTree{};
+				return;
+			}
+			TypeTree::SerializeSkipped(s);
+		}
 	};
 
 	struct ObjectPtr {
@@ -259,10 +480,25 @@ struct SerializedFile {
 	};
 
 	struct FileReference {
-		std::string assetName;
-		Hash guid;
-		int type;
-		std::string fileName;
+		using allocator_type = MetadataAllocator;
+
+		FileReference() = default;
+		FileReference(const FileReference &) = default;
+		FileReference(FileReference &&) = default;
+		explicit FileReference(const allocator_type &alloc) : assetName(alloc), fileName(alloc) {}
+		FileReference(const FileReference &other, const allocator_type &alloc) : FileReference(alloc) {
+			*this = other;
+		}
+		FileReference(FileReference &&other, const allocator_type &alloc) : FileReference(alloc) {
+			*this = std::move(other);
+		}
+		FileReference &operator=(const FileReference &) = default;
+		FileReference &operator=(FileReference &&) = default;
+
+		std::pmr::string assetName;
+		Hash guid{};
+		int type = 0;
+		std::pmr::string fileName;
 
 		SerializeFn(SerializedFile::FileReference) {
 			using serialize::Flags;
@@ -278,15 +514,22 @@ struct SerializedFile {
 	};
 
 	struct Metadata {
-		std::string generatorVersion;
-		int platform;
-		bool serializeTypeTrees;
-		std::vector<TypeMetadata> types;
-		int unk0;
-		std::vector<ObjectInfo> objects;
-		std::vector<ObjectPtr> adds;
-		std::vector<FileReference> externalFiles;
-		std::string unk1;
+		using allocator_type = MetadataAllocator;
+
+		Metadata() = default;
+		explicit Metadata(const allocator_type &alloc)
+			: generatorVersion(alloc), types(alloc), objects(alloc), adds(alloc), externalFiles(alloc),
+			unk1(alloc) {}
+
+		std::pmr::string generatorVersion;
+		int platform = 0;
+		bool serializeTypeTrees = false;
+		std::pmr::vector<TypeMetadata> types;
+		int unk0 = 0;
+		std::pmr::vector<ObjectInfo> objects;
+		std::pmr::vector<ObjectPtr> adds;
+		std::pmr::vector<FileReference> externalFiles;
+		std::pmr::string unk1;
 
 		SerializeFn(SerializedFile::Metadata) {
 			using serialize::Flags;
@@ -295,7 +538,7 @@ struct SerializedFile {
 			SerializeIf(version, version >= 13, [&](){
 				SerializeScalarV(bool, serializeTypeTrees, Flags::Variable);
 			}, [&](){
-				s.SetVariable("serializeTypeTrees", true);
+				s.SetVariable(serialize::Var::serializeTypeTrees, true);
 			});
 			SerializeStruct(vector, types);
 			SerializeIf(version, 7 <= version && version <= 13, [&](){
@@ -312,6 +555,11 @@ struct SerializedFile {
 		}
 	};
 
+	SerializedFile() = default;
+	// A SerializedFile constructed with an allocator parses its metadata into it.  Pass a
+	// std::pmr::memory_resource * to use an arena.
+	explicit SerializedFile(const MetadataAllocator &alloc) : metadata(alloc), typeIDs(alloc) {}
+
 	Header header;
 	Metadata metadata;
 
@@ -319,6 +567,57 @@ struct SerializedFile {
 		SerializeStruct(SerializedFile::Header, header);
 		SerializeStruct(SerializedFile::Metadata, metadata);
 	}
+
+	// Write serializes the header and metadata into out, which is allocated once at the size
+	// a SizeCounter measures.  header.metadataSize is updated to match; the other header
+	// fields describe the object data, which callers lay out and append themselves.  Nothing
+	// else is modified: TypeTrees shared through a cache are written where they are.  Files
+	// read with skipFields cannot be written back.
+	bool Write(std::vector<char> &out);
+
+	// TypeIndex returns the index into metadata.types which describes object, or -1.
+	int TypeIndex(const ObjectInfo &object) const;
+	// IndexTypes builds the index TypeIndex searches for versions before 17, whose objects
+	// name their type by oldClassID.  Read and ReadMetadata call it; callers which serialize
+	// the metadata themselves call it afterwards, or TypeIndex scans the types.
+	void IndexTypes();
+	// ClassID returns object's class, which older versions store in the object itself.
+	int ClassID(const ObjectInfo &object) const;
+
+	// Read parses the same tree as Serialize, with readers fixed to one byte order.  The header
+	// is always big-endian; the metadata is read by a reader converted, once, to the byte order
+	// given by header.bigEndian.  Returns false if the reader errored.
+	template <template <serialize::Endian> class Reader>
+	bool Read(Reader<serialize::Endian::Big> &s) {
+		SerializeStruct(SerializedFile::Header, header);
+		if (s.IsErrored()) {
+			return false;
+		}
+		return ReadMetadata(s);
+	}
+
+	// ReadMetadata is the second half of Read, for callers which read the header on its own.
+	// s must be the reader which read the header, or carry its variables.
+	template <template <serialize::Endian> class Reader>
+	bool ReadMetadata(Reader<serialize::Endian::Big> &s) {
+		using serialize::Endian;
+		if (header.bigEndian) {
+			SerializeStruct(SerializedFile::Metadata, metadata);
+		} else {
+			Reader<Endian::Little> le(s);
+			serialize::struct_val(le, metadata, "SerializedFile::Metadata", "metadata");
+			s = Reader<Endian::Big>(le);
+		}
+		IndexTypes();
+		return !s.IsErrored();
+	}
+
+	struct TypeID {
+		int typeID;
+		int index;
+	};
+	// typeIDs holds the oldClassID and index of each type, sorted by oldClassID and then index.
+	std::pmr::vector<TypeID> typeIDs;
 };
 
 };
@@ -0,0 +1,125 @@
+#include "StreamParser.h"
+#include <algorithm>
+
+namespace unitypack {
+
+namespace {
+
+// The header is 5 big-endian fields padded to 20 bytes; the metadata follows it.
+const size_t HeaderSize = 20;
+
+};
+
+const char *StreamParser::Take(size_t size, const char *&data, size_t &remaining) {
+	if (pending.empty() && remaining >= size) {
+		const char *taken = data;
+		data += size;
+		remaining -= size;
+		position += size;
+		return taken;
+	}
+	size_t copy = std::min(size - pending.size(), remaining);
+	pending.insert(pending.end(), data, data + copy);
+	data += copy;
+	remaining -= copy;
+	position += copy;
+	return pending.size() == size ? pending.data() : nullptr;
+}
+
+bool StreamParser::Feed(const char *data, size_t size) {
+	while (true) {
+		switch (state) {
+		case State::Header: {
+			const char *header = Take(HeaderSize, data, size);
+			if (!header) {
+				return true;
+			}
+			reader.SetRange(header, HeaderSize);
+			serialize::struct_val(reader, file.header, "SerializedFile::Header", "header");
+			pending.clear();
+			int64_t metadataEnd = (int64_t)HeaderSize + file.header.metadataSize;
+			if (reader.IsErrored() || file.header.metadataSize <= 0 ||
+				(file.header.fileSize > 0 && metadataEnd > file.header.fileSize)) {
+				state = State::Errored;
+				return false;
+			}
+			state = State::Metadata;
+			break;
+		}
+
+		case State::Metadata: {
+			const char *metadata = Take((size_t)file.header.metadataSize, data, size);
+			if (!metadata) {
+				return true;
+			}
+			reader.SetRange(metadata, (size_t)file.header.metadataSize);
+			reader.typeTrees = typeTrees;
+			reader.skipFields = skipFields;
+			bool ok = file.ReadMetadata(reader);
+			pending.clear();
+			if (!ok) {
+				state = State::Errored;
+				return false;
+			}
+			auto &objects = file.metadata.objects;
+			order.resize(objects.size());
+			for (size_t i = 0; i < order.size(); i++) {
+				order[i] = (uint32_t)i;
+			}
+			std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+				return (uint32_t)objects[a].dataOffset < (uint32_t)objects[b].dataOffset;
+			});
+			state = State::Objects;
+			if (onMetadata) {
+				onMetadata(file);
+			}
+			break;
+		}
+
+		case State::Objects: {
+			if (next == order.size()) {
+				state = State::Done;
+				break;
+			}
+			auto &object = file.metadata.objects[order[next]];
+			uint64_t start = (uint64_t)(uint32_t)file.header.objectDataOffset + (uint32_t)object.dataOffset;
+			if (pending.empty()) {
+				if (object.dataSize < 0 || start < position) {
+					if (onObject) {
+						onObject(object, nullptr);
+					}
+					next++;
+					break;
+				}
+				// Skip the padding between payloads.
+				size_t gap = (size_t)std::min<uint64_t>(start - position, size);
+				data += gap;
+				size -= gap;
+				position += gap;
+				if (position < start) {
+					return true;
+				}
+			}
+			const char *payload = Take((size_t)object.dataSize, data, size);
+			if (!payload) {
+				return true;
+			}
+			if (onObject) {
+				onObject(object, payload);
+			}
+			pending.clear();
+			next++;
+			break;
+		}
+
+		case State::Done:
+			position += size;
+			return true;
+
+		case State::Errored:
+			return false;
+		}
+	}
+}
+
+};
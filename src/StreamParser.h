@@ -0,0 +1,64 @@
+// This header contains a push parser for SerializedFiles which arrive in pieces.
+#pragma once
+
+#include "default.h"
+#include "MmapReader.h"
+#include "SerializedFile.h"
+#include <functional>
+
+namespace unitypack {
+
+// StreamParser parses a SerializedFile from chunks of any size, such as reads from a pipe
+// or the output of a decompressor.  It is a state machine over the sections of the file:
+// it buffers the header and metadata, parses them as soon as the last metadata byte
+// arrives, and then hands out each object as soon as its payload is complete, so that the
+// caller's work overlaps with the rest of the stream arriving.
+struct StreamParser {
+	enum class State {
+		Header,
+		Metadata,
+		Objects,
+		Done,
+		Errored,
+	};
+
+	// Passed on to the metadata reader.
+	TypeTreeCache *typeTrees = nullptr;
+	uint32_t skipFields = 0;
+
+	// onMetadata is called once file's header and metadata are parsed.
+	std::function<void(const SerializedFile &file)> onMetadata;
+	// onObject is called with each object's dataSize bytes, in the order they appear in the
+	// stream.  data is only valid during the call, and is nullptr for an object which lies
+	// outside the stream or overlaps an earlier one.
+	std::function<void(const SerializedFile::ObjectInfo &object, const char *data)> onObject;
+
+	// Feed parses as much as data completes.  Chunks are not used after Feed returns.
+	// Returns false once the stream is malformed.
+	bool Feed(const char *data, size_t size);
+
+	// Finish reports whether the whole file was parsed once the stream has ended.
+	bool Finish() const {
+		return state == State::Done;
+	}
+
+	State state = State::Header;
+	SerializedFile file{};
+	// The offset in the stream of the next byte Feed will be given.
+	uint64_t position = 0;
+
+private:
+	// Take returns the next size bytes of the stream, consuming them from data, or nullptr
+	// if they have not all arrived yet.  Bytes are only copied into pending when they
+	// span chunks.
+	const char *Take(size_t size, const char *&data, size_t &remaining);
+
+	// The reader which parsed the header keeps its variables for the metadata.
+	serialize::MmapReaderT<serialize::Endian::Big> reader{};
+	std::vector<char> pending;
+	// Metadata::objects indices ordered by payload offset, and the next one to hand out.
+	std::vector<uint32_t> order;
+	size_t next = 0;
+};
+
+};
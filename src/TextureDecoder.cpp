@@ -0,0 +1,555 @@
+#include "TextureDecoder.h"
+#include <algorithm>
+
+// On x86 with GCC or Clang, blocks are expanded with the widest instruction set the CPU
+// supports, chosen at run time: the SIMD functions are compiled for their instruction set
+// with target attributes, whatever the flags of the build.  Elsewhere only the scalar loop
+// is built.
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define UNITYPACK_TEXTURE_SIMD
+#include <immintrin.h>
+#define UNITYPACK_TARGET(isa) __attribute__((target(isa)))
+#define UNITYPACK_TARGET_ROW(isa) __attribute__((target(isa), flatten))
+#endif
+
+namespace unitypack {
+
+namespace {
+
+// Each block decodes to a palette of up to eight colors and a palette index per pixel, which
+// WriteBlock expands.  Pixels are uint32_t holding the bytes R, G, B, A in memory order.
+uint32_t Pack(int r, int g, int b, int a) {
+	uint8_t bytes[4] = { (uint8_t)r, (uint8_t)g, (uint8_t)b, (uint8_t)a };
+	uint32_t pixel;
+	memcpy(&pixel, bytes, 4);
+	return pixel;
+}
+
+const uint32_t alphaMask = Pack(0, 0, 0, 255);
+
+int Clamp(int value) {
+	return value < 0 ? 0 : value > 255 ? 255 : value;
+}
+
+uint32_t PackClamped(int r, int g, int b) {
+	return Pack(Clamp(r), Clamp(g), Clamp(b), 255);
+}
+
+using DecodeBlock = void (*)(const uint8_t *src, uint8_t *dst, size_t stride);
+
+// DecodeRow decodes one row of blocks, of which rows pixel rows are in the image.
+template <DecodeBlock Decode>
+void DecodeRow(const uint8_t *src, size_t blockSize, int width, int rows, uint8_t *dst, size_t stride) {
+	for (int x = 0; x < width; x += 4, src += blockSize) {
+		if (x + 4 <= width && rows == 4) {
+			Decode(src, dst + (size_t)x * 4, stride);
+			continue;
+		}
+		uint8_t block[64];
+		Decode(src, block, 16);
+		int columns = std::min(4, width - x);
+		for (int y = 0; y < rows; y++) {
+			memcpy(dst + y * stride + (size_t)x * 4, block + y * 16, (size_t)columns * 4);
+		}
+	}
+}
+
+// Each instruction set is a struct whose WriteBlock writes the 4x4 pixels palette[index[i]],
+// i being y * 4 + x, to dst.  With Alpha, each pixel's alpha is replaced by
+// alphas[alphaIndex[i]], whose other bytes are 0.  Palettes always have eight entries.  Row
+// is DecodeRow compiled for the instruction set, with the block decoder inlined into it, so
+// that the decoder's WriteBlock is too.
+struct Scalar {
+	template <bool Alpha>
+	static void WriteBlock(const uint32_t *palette, const uint8_t *index, const uint32_t *alphas,
+		const uint8_t *alphaIndex, uint8_t *dst, size_t stride) {
+		for (int y = 0; y < 4; y++) {
+			uint32_t row[4];
+			for (int x = 0; x < 4; x++) {
+				int i = y * 4 + x;
+				row[x] = Alpha ? (palette[index[i]] & ~alphaMask) | alphas[alphaIndex[i]] : palette[index[i]];
+			}
+			memcpy(dst + y * stride, row, sizeof(row));
+		}
+	}
+
+	template <DecodeBlock Decode>
+	static void Row(const uint8_t *src, size_t blockSize, int width, int rows, uint8_t *dst, size_t stride) {
+		DecodeRow<Decode>(src, blockSize, width, rows, dst, stride);
+	}
+};
+
+#ifdef UNITYPACK_TEXTURE_SIMD
+// A byte shuffle reaches four pixels, so each row looks up both halves of the palette and
+// keeps the one its index's third bit picks.  Plain SSE2 has no variable shuffle, and
+// selecting among broadcast entries there is slower than the scalar loop.  So is this, in
+// the texture benchmark, against the scalar loop as the compiler vectorizes it: Best does
+// not pick it, and it is kept for comparison.
+struct Ssse3 {
+	UNITYPACK_TARGET("ssse3")
+	static __m128i Lookup(__m128i low, __m128i high, const uint8_t *row) {
+		int packed;
+		memcpy(&packed, row, 4);
+		__m128i i = _mm_shuffle_epi8(_mm_cvtsi32_si128(packed),
+			_mm_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3));
+		__m128i bytes = _mm_add_epi8(_mm_slli_epi16(_mm_and_si128(i, _mm_set1_epi8(3)), 2),
+			_mm_setr_epi8(0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3));
+		const __m128i four = _mm_set1_epi8(4);
+		__m128i upper = _mm_cmpeq_epi8(_mm_and_si128(i, four), four);
+		return _mm_or_si128(_mm_and_si128(upper, _mm_shuffle_epi8(high, bytes)),
+			_mm_andnot_si128(upper, _mm_shuffle_epi8(low, bytes)));
+	}
+
+	template <bool Alpha>
+	UNITYPACK_TARGET("ssse3")
+	static void WriteBlock(const uint32_t *palette, const uint8_t *index, const uint32_t *alphas,
+		const uint8_t *alphaIndex, uint8_t *dst, size_t stride) {
+		const __m128i low = _mm_loadu_si128((const __m128i *)palette);
+		const __m128i high = _mm_loadu_si128((const __m128i *)(palette + 4));
+		for (int y = 0; y < 4; y++) {
+			__m128i pixels = Lookup(low, high, index + y * 4);
+			if (Alpha) {
+				const __m128i mask = _mm_set1_epi32((int)alphaMask);
+				__m128i a = Lookup(_mm_loadu_si128((const __m128i *)alphas),
+					_mm_loadu_si128((const __m128i *)(alphas + 4)), alphaIndex + y * 4);
+				pixels = _mm_or_si128(_mm_andnot_si128(mask, pixels), a);
+			}
+			_mm_storeu_si128((__m128i *)(dst + y * stride), pixels);
+		}
+	}
+
+	template <DecodeBlock Decode>
+	UNITYPACK_TARGET_ROW("ssse3")
+	static void Row(const uint8_t *src, size_t blockSize, int width, int rows, uint8_t *dst, size_t stride) {
+		DecodeRow<Decode>(src, blockSize, width, rows, dst, stride);
+	}
+};
+
+// Two rows at a time: one permute looks up eight pixels.
+struct Avx2 {
+	template <bool Alpha>
+	UNITYPACK_TARGET("avx2")
+	static void WriteBlock(const uint32_t *palette, const uint8_t *index, const uint32_t *alphas,
+		const uint8_t *alphaIndex, uint8_t *dst, size_t stride) {
+		const __m256i colors = _mm256_loadu_si256((const __m256i *)palette);
+		for (int half = 0; half < 2; half++) {
+			__m256i i = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(index + half * 8)));
+			__m256i pixels = _mm256_permutevar8x32_epi32(colors, i);
+			if (Alpha) {
+				const __m256i mask = _mm256_set1_epi32((int)alphaMask);
+				__m256i a = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(alphaIndex + half * 8)));
+				pixels = _mm256_or_si256(_mm256_andnot_si256(mask, pixels),
+					_mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *)alphas), a));
+			}
+			_mm_storeu_si128((__m128i *)(dst + half * 2 * stride), _mm256_castsi256_si128(pixels));
+			_mm_storeu_si128((__m128i *)(dst + (half * 2 + 1) * stride), _mm256_extracti128_si256(pixels, 1));
+		}
+	}
+
+	template <DecodeBlock Decode>
+	UNITYPACK_TARGET_ROW("avx2")
+	static void Row(const uint8_t *src, size_t blockSize, int width, int rows, uint8_t *dst, size_t stride) {
+		DecodeRow<Decode>(src, blockSize, width, rows, dst, stride);
+	}
+};
+#endif
+
+void WritePixels(const uint32_t *pixels, uint8_t *dst, size_t stride) {
+	for (int y = 0; y < 4; y++) {
+		memcpy(dst + y * stride, pixels + y * 4, 16);
+	}
+}
+
+// BC1Palette decodes the two RGB565 endpoints of a BC1 color block.  BC3 color blocks always
+// use four colors; BC1 blocks whose first endpoint is not the greater use three and
+// transparent black.
+void BC1Palette(const uint8_t *src, bool fourColors, uint32_t *palette) {
+	int c0 = src[0] | src[1] << 8;
+	int c1 = src[2] | src[3] << 8;
+	int r0 = (c0 >> 11) << 3 | (c0 >> 13);
+	int g0 = (c0 >> 5 & 63) << 2 | (c0 >> 9 & 3);
+	int b0 = (c0 & 31) << 3 | (c0 >> 2 & 7);
+	int r1 = (c1 >> 11) << 3 | (c1 >> 13);
+	int g1 = (c1 >> 5 & 63) << 2 | (c1 >> 9 & 3);
+	int b1 = (c1 & 31) << 3 | (c1 >> 2 & 7);
+	palette[0] = Pack(r0, g0, b0, 255);
+	palette[1] = Pack(r1, g1, b1, 255);
+	if (c0 > c1 || fourColors) {
+		palette[2] = Pack((2 * r0 + r1) / 3, (2 * g0 + g1) / 3, (2 * b0 + b1) / 3, 255);
+		palette[3] = Pack((r0 + 2 * r1) / 3, (g0 + 2 * g1) / 3, (b0 + 2 * b1) / 3, 255);
+	} else {
+		palette[2] = Pack((r0 + r1) / 2, (g0 + g1) / 2, (b0 + b1) / 2, 255);
+		palette[3] = Pack(0, 0, 0, 0);
+	}
+}
+
+// BC1Index reads the 2-bit indices of a BC1 color block, lowest bits first.
+void BC1Index(const uint8_t *src, uint8_t *index) {
+	uint32_t bits = (uint32_t)src[4] | (uint32_t)src[5] << 8 | (uint32_t)src[6] << 16 | (uint32_t)src[7] << 24;
+	for (int i = 0; i < 16; i++) {
+		index[i] = bits >> (i * 2) & 3;
+	}
+}
+
+template <typename Isa>
+void DecodeBC1(const uint8_t *src, uint8_t *dst, size_t stride) {
+	uint32_t palette[8] = {};
+	uint8_t index[16];
+	BC1Palette(src, false, palette);
+	BC1Index(src, index);
+	Isa::template WriteBlock<false>(palette, index, nullptr, nullptr, dst, stride);
+}
+
+template <typename Isa>
+void DecodeBC3(const uint8_t *src, uint8_t *dst, size_t stride) {
+	// The alpha block: two endpoints, then 3-bit indices.
+	uint32_t alphas[8];
+	uint8_t alphaIndex[16];
+	int a0 = src[0];
+	int a1 = src[1];
+	alphas[0] = Pack(0, 0, 0, a0);
+	alphas[1] = Pack(0, 0, 0, a1);
+	if (a0 > a1) {
+		for (int k = 1; k < 7; k++) {
+			alphas[k + 1] = Pack(0, 0, 0, ((7 - k) * a0 + k * a1) / 7);
+		}
+	} else {
+		for (int k = 1; k < 5; k++) {
+			alphas[k + 1] = Pack(0, 0, 0, ((5 - k) * a0 + k * a1) / 5);
+		}
+		alphas[6] = Pack(0, 0, 0, 0);
+		alphas[7] = Pack(0, 0, 0, 255);
+	}
+	uint64_t bits = 0;
+	for (int i = 7; i >= 2; i--) {
+		bits = bits << 8 | src[i];
+	}
+	for (int i = 0; i < 16; i++) {
+		alphaIndex[i] = bits >> (i * 3) & 7;
+	}
+
+	uint32_t palette[8] = {};
+	uint8_t index[16];
+	BC1Palette(src + 8, true, palette);
+	BC1Index(src + 8, index);
+	Isa::template WriteBlock<true>(palette, index, alphas, alphaIndex, dst, stride);
+}
+
+const int etcModifiers[8][2] = {
+	{ 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 },
+};
+const int etcDistances[8] = { 3, 6, 11, 16, 23, 32, 41, 64 };
+const int eacModifiers[16][8] = {
+	{ -3, -6, -9, -15, 2, 5, 8, 14 },
+	{ -3, -7, -10, -13, 2, 6, 9, 12 },
+	{ -2, -5, -8, -13, 1, 4, 7, 12 },
+	{ -2, -4, -6, -13, 1, 3, 5, 12 },
+	{ -3, -6, -8, -12, 2, 5, 7, 11 },
+	{ -3, -7, -9, -11, 2, 6, 8, 10 },
+	{ -4, -7, -8, -11, 3, 6, 7, 10 },
+	{ -3, -5, -8, -11, 2, 4, 7, 10 },
+	{ -2, -6, -8, -10, 1, 5, 7, 9 },
+	{ -2, -5, -8, -10, 1, 4, 7, 9 },
+	{ -2, -4, -8, -10, 1, 3, 7, 9 },
+	{ -2, -5, -7, -10, 1, 4, 6, 9 },
+	{ -3, -4, -7, -10, 2, 3, 6, 9 },
+	{ -1, -2, -3, -10, 0, 1, 2, 9 },
+	{ -4, -6, -8, -9, 3, 5, 7, 8 },
+	{ -3, -5, -7, -9, 2, 4, 6, 8 },
+};
+
+// EtcIndex reads the 2-bit indices of an ETC block, whose bits run down the columns: pixel
+// (x, y) has its high bit at 16 + x * 4 + y and its low bit at x * 4 + y.
+void EtcIndex(const uint8_t *src, uint8_t *index) {
+	uint32_t bits = (uint32_t)src[4] << 24 | (uint32_t)src[5] << 16 | (uint32_t)src[6] << 8 | src[7];
+	for (int x = 0; x < 4; x++) {
+		for (int y = 0; y < 4; y++) {
+			int p = x * 4 + y;
+			index[y * 4 + x] = (bits >> (16 + p) & 1) << 1 | (bits >> p & 1);
+		}
+	}
+}
+
+// EtcColors decodes the color half of an ETC1 or ETC2 block into a palette and indices or,
+// for an ETC2 planar block, straight into pixels, returning true in that case.  In a
+// punch-through block bit 33 tells whether the block is opaque instead of choosing the
+// differential mode, and index 2 of a block which is not opaque is transparent black.
+bool EtcColors(const uint8_t *src, bool etc2, bool punchThrough, uint32_t *palette, uint8_t *index,
+	uint32_t *pixels) {
+	bool differential = punchThrough || (src[3] & 2);
+	bool opaque = !punchThrough || (src[3] & 2);
+	int base[2][3];
+	if (!differential) {
+		for (int c = 0; c < 3; c++) {
+			base[0][c] = (src[c] >> 4) * 17;
+			base[1][c] = (src[c] & 15) * 17;
+		}
+	} else {
+		int second[3];
+		for (int c = 0; c < 3; c++) {
+			int first = src[c] >> 3;
+			second[c] = first + (((src[c] & 7) ^ 4) - 4);
+			base[0][c] = first << 3 | first >> 2;
+			// ETC1 leaves a second color out of 0-31 undefined; it wraps.  In ETC2 such a
+			// block is in one of the modes below, which do not use base.
+			int low = second[c] & 31;
+			base[1][c] = low << 3 | low >> 2;
+		}
+		// ETC2 gives the combinations which overflow a channel their own modes.
+		if (etc2 && (second[0] < 0 || second[0] > 31)) {
+			int r1 = (src[0] >> 3 & 3) << 2 | (src[0] & 3);
+			int g1 = src[1] >> 4;
+			int b1 = src[1] & 15;
+			int r2 = src[2] >> 4;
+			int g2 = src[2] & 15;
+			int b2 = src[3] >> 4;
+			int d = etcDistances[(src[3] >> 1 & 6) | (src[3] & 1)];
+			palette[0] = Pack(r1 * 17, g1 * 17, b1 * 17, 255);
+			palette[1] = PackClamped(r2 * 17 + d, g2 * 17 + d, b2 * 17 + d);
+			palette[2] = Pack(r2 * 17, g2 * 17, b2 * 17, 255);
+			palette[3] = PackClamped(r2 * 17 - d, g2 * 17 - d, b2 * 17 - d);
+			if (!opaque) {
+				palette[2] = 0;
+			}
+			EtcIndex(src, index);
+			return false;
+		}
+		if (etc2 && (second[1] < 0 || second[1] > 31)) {
+			int r1 = src[0] >> 3 & 15;
+			int g1 = (src[0] & 7) << 1 | (src[1] >> 4 & 1);
+			int b1 = (src[1] & 8) | (src[1] & 3) << 1 | src[2] >> 7;
+			int r2 = src[2] >> 3 & 15;
+			int g2 = (src[2] & 7) << 1 | src[3] >> 7;
+			int b2 = src[3] >> 3 & 15;
+			int distance = (src[3] & 4) | (src[3] & 1) << 1;
+			if ((r1 << 8 | g1 << 4 | b1) >= (r2 << 8 | g2 << 4 | b2)) {
+				distance |= 1;
+			}
+			int d = etcDistances[distance];
+			palette[0] = PackClamped(r1 * 17 + d, g1 * 17 + d, b1 * 17 + d);
+			palette[1] = PackClamped(r1 * 17 - d, g1 * 17 - d, b1 * 17 - d);
+			palette[2] = PackClamped(r2 * 17 + d, g2 * 17 + d, b2 * 17 + d);
+			palette[3] = PackClamped(r2 * 17 - d, g2 * 17 - d, b2 * 17 - d);
+			if (!opaque) {
+				palette[2] = 0;
+			}
+			EtcIndex(src, index);
+			return false;
+		}
+		if (etc2 && (second[2] < 0 || second[2] > 31)) {
+			// Planar: three colors, interpolated across the block.  Always opaque.
+			int o[3];
+			int h[3];
+			int v[3];
+			o[0] = src[0] >> 1 & 63;
+			o[1] = (src[0] & 1) << 6 | (src[1] >> 1 & 63);
+			o[2] = (src[1] & 1) << 5 | (src[2] & 0x18) | (src[2] & 3) << 1 | src[3] >> 7;
+			h[0] = (src[3] & 0x7c) >> 1 | (src[3] & 1);
+			h[1] = src[4] >> 1 & 127;
+			h[2] = (src[4] & 1) << 5 | src[5] >> 3;
+			v[0] = (src[5] & 7) << 3 | src[6] >> 5;
+			v[1] = (src[6] & 31) << 2 | src[7] >> 6;
+			v[2] = src[7] & 63;
+			for (int c = 0; c < 3; c += 2) {
+				o[c] = o[c] << 2 | o[c] >> 4;
+				h[c] = h[c] << 2 | h[c] >> 4;
+				v[c] = v[c] << 2 | v[c] >> 4;
+			}
+			o[1] = o[1] << 1 | o[1] >> 6;
+			h[1] = h[1] << 1 | h[1] >> 6;
+			v[1] = v[1] << 1 | v[1] >> 6;
+			for (int y = 0; y < 4; y++) {
+				for (int x = 0; x < 4; x++) {
+					int rgb[3];
+					for (int c = 0; c < 3; c++) {
+						rgb[c] = (x * (h[c] - o[c]) + y * (v[c] - o[c]) + 4 * o[c] + 2) >> 2;
+					}
+					pixels[y * 4 + x] = PackClamped(rgb[0], rgb[1], rgb[2]);
+				}
+			}
+			return true;
+		}
+	}
+
+	// Two subblocks, side by side or, when flipped, one above the other.
+	bool flip = src[3] & 1;
+	int tables[2] = { src[3] >> 5, src[3] >> 2 & 7 };
+	for (int s = 0; s < 2; s++) {
+		for (int k = 0; k < 4; k++) {
+			int modifier = etcModifiers[tables[s]][k & 1];
+			if (k & 2) {
+				modifier = -modifier;
+			}
+			if (!opaque && !(k & 1)) {
+				modifier = 0;
+			}
+			palette[s * 4 + k] = PackClamped(base[s][0] + modifier, base[s][1] + modifier, base[s][2] + modifier);
+		}
+		if (!opaque) {
+			palette[s * 4 + 2] = 0;
+		}
+	}
+	EtcIndex(src, index);
+	for (int y = 0; y < 4; y++) {
+		for (int x = 0; x < 4; x++) {
+			if (flip ? y >= 2 : x >= 2) {
+				index[y * 4 + x] += 4;
+			}
+		}
+	}
+	return false;
+}
+
+template <typename Isa, bool Etc2, bool PunchThrough>
+void DecodeEtc(const uint8_t *src, uint8_t *dst, size_t stride) {
+	uint32_t palette[8] = {};
+	uint8_t index[16];
+	uint32_t pixels[16];
+	if (EtcColors(src, Etc2, PunchThrough, palette, index, pixels)) {
+		WritePixels(pixels, dst, stride);
+	} else {
+		Isa::template WriteBlock<false>(palette, index, nullptr, nullptr, dst, stride);
+	}
+}
+
+// DecodeEtc2Alpha decodes an ETC2_RGBA8 block: an EAC block of alpha, then an ETC2 block.
+template <typename Isa>
+void DecodeEtc2Alpha(const uint8_t *src, uint8_t *dst, size_t stride) {
+	uint32_t alphas[8];
+	uint8_t alphaIndex[16];
+	int alphaBase = src[0];
+	int multiplier = src[1] >> 4;
+	const int *modifiers = eacModifiers[src[1] & 15];
+	for (int k = 0; k < 8; k++) {
+		alphas[k] = Pack(0, 0, 0, Clamp(alphaBase + modifiers[k] * multiplier));
+	}
+	// 3-bit indices, most significant first, running down the columns.
+	uint64_t bits = 0;
+	for (int i = 2; i < 8; i++) {
+		bits = bits << 8 | src[i];
+	}
+	for (int x = 0; x < 4; x++) {
+		for (int y = 0; y < 4; y++) {
+			alphaIndex[y * 4 + x] = bits >> (45 - (x * 4 + y) * 3) & 7;
+		}
+	}
+
+	uint32_t palette[8] = {};
+	uint8_t index[16];
+	uint32_t pixels[16];
+	if (EtcColors(src + 8, true, false, palette, index, pixels)) {
+		for (int i = 0; i < 16; i++) {
+			pixels[i] = (pixels[i] & ~alphaMask) | alphas[alphaIndex[i]];
+		}
+		WritePixels(pixels, dst, stride);
+	} else {
+		Isa::template WriteBlock<true>(palette, index, alphas, alphaIndex, dst, stride);
+	}
+}
+
+using DecodeRowFn = void (*)(const uint8_t *src, size_t blockSize, int width, int rows, uint8_t *dst,
+	size_t stride);
+
+template <typename Isa>
+size_t BlockSize(TextureFormat format, DecodeRowFn *row) {
+	switch (format) {
+	case TextureFormat::DXT1:
+		*row = Isa::template Row<DecodeBC1<Isa>>;
+		return 8;
+	case TextureFormat::DXT5:
+		*row = Isa::template Row<DecodeBC3<Isa>>;
+		return 16;
+	case TextureFormat::ETC_RGB4:
+		*row = Isa::template Row<DecodeEtc<Isa, false, false>>;
+		return 8;
+	case TextureFormat::ETC2_RGB:
+		*row = Isa::template Row<DecodeEtc<Isa, true, false>>;
+		return 8;
+	case TextureFormat::ETC2_RGBA1:
+		*row = Isa::template Row<DecodeEtc<Isa, true, true>>;
+		return 8;
+	case TextureFormat::ETC2_RGBA8:
+		*row = Isa::template Row<DecodeEtc2Alpha<Isa>>;
+		return 16;
+	}
+	return 0;
+}
+
+TextureIsa DetectIsa() {
+#ifdef UNITYPACK_TEXTURE_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return TextureIsa::AVX2;
+	}
+#endif
+	return TextureIsa::Scalar;
+}
+
+// BlockSize returns the block size of format and its row decoder for isa, or 0 if either
+// is not supported.
+size_t BlockSize(TextureFormat format, TextureIsa isa, DecodeRowFn *row) {
+	static const TextureIsa best = DetectIsa();
+	if (isa == TextureIsa::Best) {
+		isa = best;
+	}
+#ifdef UNITYPACK_TEXTURE_SIMD
+	if ((isa == TextureIsa::AVX2 && best != TextureIsa::AVX2) ||
+		(isa == TextureIsa::SSSE3 && !__builtin_cpu_supports("ssse3"))) {
+		return 0;
+	}
+#endif
+	switch (isa) {
+#ifdef UNITYPACK_TEXTURE_SIMD
+	case TextureIsa::AVX2:
+		return BlockSize<Avx2>(format, row);
+	case TextureIsa::SSSE3:
+		return BlockSize<Ssse3>(format, row);
+#endif
+	case TextureIsa::Scalar:
+		return BlockSize<Scalar>(format, row);
+	default:
+		return 0;
+	}
+}
+
+};
+
+bool TextureIsaSupported(TextureIsa isa) {
+	DecodeRowFn row;
+	return BlockSize(TextureFormat::DXT1, isa, &row) != 0;
+}
+
+size_t TextureSize(TextureFormat format, int width, int height) {
+	DecodeRowFn row;
+	size_t blockSize = BlockSize<Scalar>(format, &row);
+	if (width <= 0 || height <= 0) {
+		return 0;
+	}
+	return ((size_t)width + 3) / 4 * (((size_t)height + 3) / 4) * blockSize;
+}
+
+bool DecodeTexture(TextureFormat format, const char *data, size_t size, int width, int height, uint8_t *rgba,
+	size_t stride, ThreadPool *pool, TextureIsa isa) {
+	DecodeRowFn row = nullptr;
+	size_t blockSize = BlockSize(format, isa, &row);
+	size_t needed = TextureSize(format, width, height);
+	if (!blockSize || !needed || size < needed || stride < (size_t)width * 4) {
+		return false;
+	}
+	size_t rowSize = ((size_t)width + 3) / 4 * blockSize;
+	size_t blockRows = ((size_t)height + 3) / 4;
+	auto decode = [&](size_t by) {
+		int rows = std::min(4, height - (int)by * 4);
+		row((const uint8_t *)data + by * rowSize, blockSize, width, rows, rgba + by * 4 * stride, stride);
+	};
+	if (pool && blockRows > 1) {
+		pool->ParallelFor(blockRows, decode);
+	} else {
+		for (size_t by = 0; by < blockRows; by++) {
+			decode(by);
+		}
+	}
+	return true;
+}
+
+};
@@ -0,0 +1,48 @@
+// This header contains decoders for the block-compressed formats of Texture2D image data.
+#pragma once
+
+#include "default.h"
+#include "ThreadPool.h"
+
+namespace unitypack {
+
+// TextureFormat is the m_TextureFormat of a Texture2D, for the formats DecodeTexture reads.
+enum class TextureFormat : int {
+	DXT1 = 10,
+	DXT5 = 12,
+	ETC_RGB4 = 34,
+	ETC2_RGB = 45,
+	ETC2_RGBA1 = 46,
+	ETC2_RGBA8 = 47,
+};
+
+// TextureIsa is the instruction set DecodeTexture expands blocks with.  Best is AVX2 where
+// the CPU supports it, which is detected once, and Scalar elsewhere; the others are for
+// tests and benchmarks.
+enum class TextureIsa : int {
+	Best,
+	Scalar,
+	SSSE3,
+	AVX2,
+};
+
+// TextureIsaSupported returns whether this build can decode with isa on this CPU.
+bool TextureIsaSupported(TextureIsa isa);
+
+// TextureSize returns the bytes of the top mip level of a width by height texture, or 0 if
+// DecodeTexture does not read format.
+size_t TextureSize(TextureFormat format, int width, int height);
+
+// DecodeTexture decodes the top mip level in data to 8-bit RGBA, writing row y of the image
+// at rgba + y * stride.  Rows are in the order of the data, which Unity stores bottom row
+// first.  Nothing is allocated: blocks which straddle the right or bottom edge are decoded on
+// the stack and clipped.  Returns false if format is not supported or data is too short.
+//
+// DXT1 is BC1 and DXT5 is BC3.  The ETC2 formats include ETC1 blocks, and ETC2_RGBA1 is the
+// punch-through variant.  With pool, rows of blocks are decoded in parallel; a task of pool
+// must not pass it, as ParallelFor cannot be nested.  Returns false as well if isa is not
+// supported; every instruction set decodes to the same bytes.
+bool DecodeTexture(TextureFormat format, const char *data, size_t size, int width, int height, uint8_t *rgba,
+	size_t stride, ThreadPool *pool = nullptr, TextureIsa isa = TextureIsa::Best);
+
+};
@@ -0,0 +1,129 @@
+#include "ThreadPool.h"
+
+namespace unitypack {
+
+namespace {
+
+// The index of the pool worker running on this thread, or -1 for other threads.
+thread_local int workerIndex = -1;
+thread_local const void *workerPool = nullptr;
+
+};
+
+ThreadPool::ThreadPool(int threads) {
+	if (threads <= 0) {
+		threads = (int)std::thread::hardware_concurrency();
+		if (threads <= 0) {
+			threads = 1;
+		}
+	}
+	queueCount = threads;
+	queues.reset(new Queue[threads]);
+	workers.reserve(threads);
+	for (int i = 0; i < threads; i++) {
+		workers.emplace_back([this, i](){ Run(i); });
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto &worker : workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+	int target = workerPool == this ? workerIndex : (int)(nextQueue++ % queueCount);
+	unfinished++;
+	{
+		// Taking the lock orders this with a worker deciding to sleep.  queued counts the
+		// task before it can be taken, so that the worker's decrement never takes it below
+		// zero; a worker woken in between only finds nothing, and looks again.
+		std::lock_guard<std::mutex> lock(mutex);
+		queued++;
+	}
+	{
+		std::lock_guard<std::mutex> lock(queues[target].mutex);
+		queues[target].tasks.push_back(std::move(task));
+	}
+	wake.notify_one();
+}
+
+bool ThreadPool::Take(int self, std::function<void()> &task) {
+	int n = queueCount;
+	{
+		Queue &own = queues[self];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tasks.empty()) {
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			return true;
+		}
+	}
+	for (int i = 1; i < n; i++) {
+		Queue &victim = queues[(self + i) % n];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadPool::Run(int self) {
+	workerIndex = self;
+	workerPool = this;
+	std::function<void()> task;
+	while (true) {
+		if (Take(self, task)) {
+			queued--;
+			task();
+			task = nullptr;
+			if (--unfinished == 0) {
+				std::lock_guard<std::mutex> lock(mutex);
+				idle.notify_all();
+			}
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(mutex);
+		wake.wait(lock, [&](){ return stopping || queued > 0; });
+		if (stopping && queued == 0) {
+			return;
+		}
+	}
+}
+
+void ThreadPool::Wait() {
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [&](){ return unfinished == 0; });
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)> &fn, size_t grain) {
+	if (count == 0) {
+		return;
+	}
+	if (grain == 0) {
+		// Several chunks per worker leave room for stealing to even out the load.
+		grain = count / ((size_t)queueCount * 8);
+		if (grain == 0) {
+			grain = 1;
+		}
+	}
+	for (size_t begin = 0; begin < count; begin += grain) {
+		size_t end = begin + grain < count ? begin + grain : count;
+		Submit([&fn, begin, end](){
+			for (size_t i = begin; i < end; i++) {
+				fn(i);
+			}
+		});
+	}
+	Wait();
+}
+
+};
@@ -0,0 +1,61 @@
+// This header contains a work-stealing thread pool.
+#pragma once
+
+#include "default.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace unitypack {
+
+// ThreadPool runs tasks on a fixed set of worker threads.  Each worker owns a deque: it
+// takes its own work from the back and, when that runs dry, steals from the front of the
+// other workers' deques, so uneven tasks still keep every worker busy.
+struct ThreadPool {
+	// threads <= 0 uses one worker per hardware thread.
+	explicit ThreadPool(int threads = 0);
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+	~ThreadPool();
+
+	int Size() const {
+		return queueCount;
+	}
+
+	// Submit queues a task.  Tasks submitted from a worker go to that worker's own deque.
+	void Submit(std::function<void()> task);
+
+	// Wait blocks until every submitted task has finished.  It must not be called by a task.
+	void Wait();
+
+	// ParallelFor calls fn(i) for every i in [0, count) and waits for them to finish.
+	// Indices are handed out in chunks of grain; 0 picks a chunk size from count.
+	void ParallelFor(size_t count, const std::function<void(size_t)> &fn, size_t grain = 0);
+
+private:
+	struct Queue {
+		std::mutex mutex;
+		std::deque<std::function<void()>> tasks;
+	};
+
+	void Run(int self);
+	bool Take(int self, std::function<void()> &task);
+
+	std::vector<std::thread> workers;
+	// The number of workers, fixed before the first one starts: workers itself is still
+	// growing while the first workers look for tasks.
+	int queueCount = 0;
+	std::unique_ptr<Queue[]> queues;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable idle;
+	std::atomic<size_t> queued{0};
+	std::atomic<size_t> unfinished{0};
+	std::atomic<size_t> nextQueue{0};
+	bool stopping = false;
+};
+
+};
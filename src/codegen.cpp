@@ -0,0 +1,285 @@
+// unitypack-codegen writes a C++ header of SerializeFn structs matching the TypeTrees of a
+// reference SerializedFile, so that hot types can be read by compile-time specialized code
+// rather than through a DecodeProgram.
+//
+// Usage: unitypack-codegen [-o out.h] [-n namespace] [-c classID]... file
+#include "MmapReader.h"
+#include "ObjectDecoder.h"
+#include <map>
+#include <set>
+#include <string>
+
+using namespace unitypack;
+
+namespace {
+
+const int alignFlag = 0x4000;
+
+const char *cppKeywords[] = {
+	"auto", "bool", "break", "case", "catch", "char", "class", "const", "continue", "default",
+	"delete", "do", "double", "else", "enum", "explicit", "extern", "false", "float", "for",
+	"friend", "goto", "if", "inline", "int", "long", "namespace", "new", "operator", "private",
+	"protected", "public", "register", "return", "short", "signed", "sizeof", "static", "struct",
+	"switch", "template", "this", "throw", "true", "try", "typedef", "union", "unsigned", "using",
+	"virtual", "void", "volatile", "while", "s",
+};
+
+std::string Identifier(const char *name) {
+	std::string id;
+	for (const char *c = name; *c; c++) {
+		bool alnum = (*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9');
+		id.push_back(alnum ? *c : '_');
+	}
+	if (id.empty() || (id[0] >= '0' && id[0] <= '9')) {
+		id.insert(id.begin(), '_');
+	}
+	for (const char *keyword : cppKeywords) {
+		if (id == keyword) {
+			id.push_back('_');
+		}
+	}
+	return id;
+}
+
+const char *ScalarType(ScalarKind kind) {
+	switch (kind) {
+	case ScalarKind::Bool: return "bool";
+	case ScalarKind::Char: return "char";
+	case ScalarKind::Int8: return "int8_t";
+	case ScalarKind::UInt8: return "uint8_t";
+	case ScalarKind::Int16: return "int16_t";
+	case ScalarKind::UInt16: return "uint16_t";
+	case ScalarKind::Int32: return "int";
+	case ScalarKind::UInt32: return "uint32_t";
+	case ScalarKind::Int64: return "int64_t";
+	case ScalarKind::UInt64: return "uint64_t";
+	case ScalarKind::Float: return "float";
+	case ScalarKind::Double: return "double";
+	case ScalarKind::Raw: break;
+	}
+	return nullptr;
+}
+
+struct Generator {
+	// structs maps a struct's body to its name, so identical subtrees share one struct.
+	std::map<std::string, std::string> structs;
+	std::set<std::string> names;
+	std::string out;
+
+	const TypeTree *tree;
+
+	int End(int i) const {
+		int depth = tree->nodes[i].depth;
+		int j = i + 1;
+		while (j < (int)tree->nodes.size() && tree->nodes[j].depth > depth) {
+			j++;
+		}
+		return j;
+	}
+
+	const char *Type(int i) const {
+		return tree->GetString(tree->nodes[i].type);
+	}
+
+	bool Aligned(int i) const {
+		return (tree->nodes[i].metaFlag & alignFlag) != 0;
+	}
+
+	bool IsLeaf(int i) const {
+		return End(i) == i + 1 && !tree->nodes[i].isArray;
+	}
+
+	bool IsString(int i) const {
+		return End(i) == i + 4 && strcmp(Type(i), "string") == 0 && tree->nodes[i + 1].isArray;
+	}
+
+	// ArrayOf returns the Array node which makes i an array: i itself, or the only child of
+	// a vector-like struct.  Returns -1 otherwise.
+	int ArrayOf(int i) const {
+		if (tree->nodes[i].isArray) {
+			return i;
+		}
+		if (!IsString(i) && End(i) > i + 1 && End(i + 1) == End(i) && tree->nodes[i + 1].isArray) {
+			return i + 1;
+		}
+		return -1;
+	}
+
+	// Declare emits struct body under a name derived from typeName and returns that name.
+	std::string Declare(const std::string &typeName, const std::string &body, const std::string &comment) {
+		auto found = structs.find(typeName + "\n" + body);
+		if (found != structs.end()) {
+			return found->second;
+		}
+		std::string name = Identifier(typeName.c_str());
+		for (int suffix = 2; names.count(name); suffix++) {
+			name = Identifier(typeName.c_str()) + "_" + std::to_string(suffix);
+		}
+		names.insert(name);
+		structs[typeName + "\n" + body] = name;
+		out += comment;
+		out += "struct " + name + " {\n";
+		size_t split = body.find("\x01");
+		out += body.substr(0, split);
+		out += "\n\tSerializeFn(" + name + ") {\n\t\tusing unitypack::serialize::Flags;\n";
+		out += body.substr(split + 1);
+		out += "\t}\n};\n\n";
+		return name;
+	}
+
+	// Element returns the C++ type of array elements rooted at node e.
+	std::string Element(int e) {
+		int array = ArrayOf(e);
+		ScalarKind kind = ScalarKindOf(Type(e), tree->nodes[e].byteSize);
+		if (array < 0 && !Aligned(e)) {
+			if (IsString(e) && !Aligned(e + 1)) {
+				return "std::string";
+			}
+			if (IsLeaf(e) && kind != ScalarKind::Raw) {
+				return ScalarType(kind);
+			}
+			if (!IsLeaf(e) && !IsString(e)) {
+				return Struct(e);
+			}
+		}
+		// Nested arrays and elements that align themselves need a struct to hold them.
+		std::string fields, statements;
+		Field(e, "data", fields, statements);
+		return Declare(std::string(Type(e)) + "Element", fields + "\x01" + statements, "");
+	}
+
+	// Field appends the declaration and serialization statements of node i.
+	void Field(int i, const std::string &name, std::string &fields, std::string &statements) {
+		const char *flags = Aligned(i) ? "Flags::PostAlign" : nullptr;
+		int array = ArrayOf(i);
+		if (array >= 0) {
+			if (Aligned(array)) {
+				flags = "Flags::PostAlign";
+			}
+			std::string element = array + 2 < End(array) ? Element(array + 2) : "uint8_t";
+			fields += "\tstd::vector<" + element + "> " + name + ";\n";
+			statements += flags
+				? "\t\tSerializeStructV(vector, " + name + ", " + flags + ");\n"
+				: "\t\tSerializeStruct(vector, " + name + ");\n";
+		} else if (IsString(i)) {
+			if (Aligned(i + 1)) {
+				flags = "Flags::PostAlign";
+			}
+			fields += "\tstd::string " + name + ";\n";
+			statements += flags
+				? "\t\tSerializeStructV(string, " + name + ", " + flags + ");\n"
+				: "\t\tSerializeStruct(string, " + name + ");\n";
+		} else if (IsLeaf(i)) {
+			ScalarKind kind = ScalarKindOf(Type(i), tree->nodes[i].byteSize);
+			if (kind == ScalarKind::Raw) {
+				int size = tree->nodes[i].byteSize;
+				fields += "\tuint8_t " + name + "[" + std::to_string(size) + "];\n";
+				statements += "\t\tfor (int i = 0; i < " + std::to_string(size) + "; i++) {\n"
+					"\t\t\tSerializeScalar(uint8_t, " + name + "[i]);\n\t\t}\n";
+				if (flags) {
+					statements += "\t\ts.Align();\n";
+				}
+			} else {
+				const char *type = ScalarType(kind);
+				fields += std::string("\t") + type + " " + name + ";\n";
+				statements += flags
+					? "\t\tSerializeScalarV(" + std::string(type) + ", " + name + ", " + flags + ");\n"
+					: "\t\tSerializeScalar(" + std::string(type) + ", " + name + ");\n";
+			}
+		} else {
+			std::string type = Struct(i);
+			fields += "\t" + type + " " + name + ";\n";
+			statements += flags
+				? "\t\tSerializeStructV(" + type + ", " + name + ", " + flags + ");\n"
+				: "\t\tSerializeStruct(" + type + ", " + name + ");\n";
+		}
+	}
+
+	// Struct declares a struct for the children of node i and returns its name.
+	std::string Struct(int i, const std::string &comment = "") {
+		std::string fields, statements;
+		std::set<std::string> fieldNames;
+		for (int j = i + 1; j < End(i); j = End(j)) {
+			std::string name = Identifier(tree->GetString(tree->nodes[j].name));
+			while (fieldNames.count(name)) {
+				name += "_";
+			}
+			fieldNames.insert(name);
+			Field(j, name, fields, statements);
+		}
+		return Declare(Type(i), fields + "\x01" + statements, comment);
+	}
+};
+
+void Usage() {
+	fprintf(stderr, "usage: unitypack-codegen [-o out.h] [-n namespace] [-c classID]... file\n");
+}
+
+};
+
+int main(int argc, char **argv) {
+	const char *outPath = nullptr;
+	const char *ns = "unitypack::generated";
+	const char *inPath = nullptr;
+	std::set<int> classIDs;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			outPath = argv[++i];
+		} else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			ns = argv[++i];
+		} else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+			classIDs.insert(atoi(argv[++i]));
+		} else if (argv[i][0] != '-' && !inPath) {
+			inPath = argv[i];
+		} else {
+			Usage();
+			return 2;
+		}
+	}
+	if (!inPath) {
+		Usage();
+		return 2;
+	}
+
+	MappedFile mapped;
+	if (!mapped.Open(inPath)) {
+		fprintf(stderr, "unitypack-codegen: cannot open %s\n", inPath);
+		return 1;
+	}
+	SerializedFile file{};
+	serialize::MmapReaderT<serialize::Endian::Big> rd{};
+	rd.SetRange(mapped);
+	if (!file.Read(rd)) {
+		fprintf(stderr, "unitypack-codegen: cannot parse %s\n", inPath);
+		return 1;
+	}
+
+	Generator gen;
+	for (auto &type : file.metadata.types) {
+		int classID = file.header.version >= 17 ? type.classID : type.oldClassID;
+		if (type.Tree().nodes.empty() || (!classIDs.empty() && !classIDs.count(classID))) {
+			continue;
+		}
+		gen.tree = &type.Tree();
+		char comment[128];
+		snprintf(comment, sizeof(comment), "// classID %d, typeHash %08x%08x%08x%08x\n", classID,
+			type.typeHash.hash[0], type.typeHash.hash[1], type.typeHash.hash[2], type.typeHash.hash[3]);
+		gen.Struct(0, comment);
+	}
+
+	FILE *out = outPath ? fopen(outPath, "w") : stdout;
+	if (!out) {
+		fprintf(stderr, "unitypack-codegen: cannot write %s\n", outPath);
+		return 1;
+	}
+	fprintf(out, "// Generated by unitypack-codegen from %s (format version %d, %s).\n", inPath,
+		file.header.version, file.metadata.generatorVersion.c_str());
+	fprintf(out, "// The layouts only hold for files built by the same Unity version.\n");
+	fprintf(out, "#pragma once\n\n#include \"Serialize.h\"\n\nnamespace %s {\n\n", ns);
+	fputs(gen.out.c_str(), out);
+	fprintf(out, "}\n");
+	if (out != stdout) {
+		fclose(out);
+	}
+	return 0;
+}
@@ -1,12 +1,1044 @@
 #include <stdio.h>
-#include "SerializedFile.h"
-
-int main() {
-	FILE *stream = fopen("globalgamemanagers", "rb");
-	unitypack::SerializedFile f{};
-	unitypack::serialize::BinaryReader rd{};
-	rd.stream = stream;
-	f.Serialize(rd);
-	printf("num types: %d\n", f.metadata.types.size());
-	return 0;
+#include <stdlib.h>
+#include <chrono>
+#include "AssetFile.h"
+#include "BundleFile.h"
+#include "CorpusScanner.h"
+#include "DependencyGraph.h"
+#include "JsonWriter.h"
+#include "MetadataIndex.h"
+#include "ObjectQuery.h"
+#include "ResourceFile.h"
+#include "StreamParser.h"
+#include "TextureDecoder.h"
+#include "ThreadPool.h"
+
+using namespace unitypack;
+
+namespace {
+
+// NameVisitor picks out an object's top-level m_Name, if it has one.
+struct NameVisitor : DecodeVisitor {
+	const char *name = nullptr;
+	int length = 0;
+	int depth = 0;
+
+	void String(const Instruction &insn, const char *data, int size) {
+		if (depth == 1 && !name && strcmp(insn.name, "m_Name") == 0) {
+			name = data;
+			length = size;
+		}
+	}
+	void BeginStruct(const Instruction &insn) {
+		depth++;
+	}
+	void EndStruct(const Instruction &insn) {
+		depth--;
+	}
+};
+
+// TextureVisitor picks out the fields of a Texture2D which DecodeTexture needs.  Streamed
+// textures have no image data, and their m_StreamData says where it is instead.
+struct TextureVisitor : DecodeVisitor {
+	int width = 0;
+	int height = 0;
+	int format = 0;
+	const char *data = nullptr;
+	size_t size = 0;
+	NameVisitor name;
+	StreamingVisitor streaming;
+
+	void Scalar(const Instruction &insn, const void *value) {
+		streaming.Scalar(insn, value);
+		if (name.depth != 1) {
+			return;
+		}
+		if (strcmp(insn.name, "m_Width") == 0) {
+			width = (int)ScalarAsInt(insn.kind, value);
+		} else if (strcmp(insn.name, "m_Height") == 0) {
+			height = (int)ScalarAsInt(insn.kind, value);
+		} else if (strcmp(insn.name, "m_TextureFormat") == 0) {
+			format = (int)ScalarAsInt(insn.kind, value);
+		}
+	}
+	void ScalarArray(const Instruction &insn, const void *block, int count) {
+		if (name.depth == 1 && strcmp(insn.name, "image data") == 0) {
+			data = (const char *)block;
+			size = (size_t)count * insn.size;
+		}
+	}
+	void String(const Instruction &insn, const char *value, int length) {
+		name.String(insn, value, length);
+		streaming.String(insn, value, length);
+	}
+	void BeginStruct(const Instruction &insn) {
+		name.BeginStruct(insn);
+		streaming.BeginStruct(insn);
+	}
+	void EndStruct(const Instruction &insn) {
+		name.EndStruct(insn);
+		streaming.EndStruct(insn);
+	}
+};
+
+void Usage() {
+	fprintf(stderr, "usage: unityextract [-j threads] (file | -)...\n");
+	fprintf(stderr, "       unityextract --json [-j threads] (file | -)...\n");
+	fprintf(stderr, "       unityextract --scan [-j threads] [--in-flight reads] [--index file] (dir | file | @list)...\n");
+	fprintf(stderr, "       unityextract --find pathID [--cache-mb megabytes] file...\n");
+	fprintf(stderr, "       unityextract --filter [--class id]... [--type-index i]... [--script-hash hex] [--name name[*]]\n");
+	fprintf(stderr, "                    [--cache-mb megabytes] file...\n");
+	fprintf(stderr, "       unityextract --textures [--out dir] [-j threads] file...\n");
+	fprintf(stderr, "       unityextract --streams [--chunk-kb kilobytes] [--cache-mb megabytes] file...\n");
+	fprintf(stderr, "       unityextract --reach file[:pathID] [-j threads] (dir | file | @list)...\n");
+#ifdef UNITYPACK_PROFILE
+	fprintf(stderr, "       unityextract --scan --profile prefix [-j threads] (dir | file | @list)...\n");
+#endif
+}
+
+// FormatObject formats the line Extract prints for an object.
+std::string FormatObject(const SerializedFile &file, const SerializedFile::ObjectInfo &object, bool ok,
+	const NameVisitor &visitor) {
+	char line[96];
+	int n = snprintf(line, sizeof(line), "%llu\t%d\t%d\t%s\t", (unsigned long long)object.objectID,
+		file.ClassID(object), object.dataSize, ok ? "ok" : "error");
+	std::string formatted(line, n);
+	formatted.append(visitor.name ? visitor.name : "", visitor.length);
+	formatted.push_back('\n');
+	return formatted;
+}
+
+// ExtractAsset decodes every object of asset on the pool and prints one line per object, in
+// the order of the object table.
+bool ExtractAsset(const char *path, AssetFile &asset, ThreadPool &pool) {
+	auto &objects = asset.file.metadata.objects;
+	printf("%s: version %d, %d types, %d objects\n", path, asset.file.header.version,
+		(int)asset.file.metadata.types.size(), (int)objects.size());
+
+	// Each object formats into its own slot so that output order does not depend on scheduling.
+	std::vector<std::string> lines(objects.size());
+	std::atomic<int> failed{0};
+	pool.ParallelFor(objects.size(), [&](size_t i) {
+		auto &object = objects[i];
+		NameVisitor visitor;
+		const char *data = asset.ObjectData(object);
+		bool ok = data && asset.decoder->Decode(object, data, visitor);
+		if (!ok) {
+			failed++;
+		}
+		lines[i] = FormatObject(asset.file, object, ok, visitor);
+	});
+	for (auto &line : lines) {
+		fwrite(line.data(), 1, line.size(), stdout);
+	}
+	if (failed) {
+		fprintf(stderr, "unityextract: %s: %d objects could not be decoded\n", path, (int)failed);
+	}
+	return failed == 0;
+}
+
+// ExtractBundle extracts every SerializedFile in a UnityFS bundle, naming each path:node.
+bool ExtractBundle(const char *path, ThreadPool &pool) {
+	BundleFile bundle;
+	if (!bundle.Open(path, &pool)) {
+		fprintf(stderr, "unityextract: cannot read bundle %s\n", path);
+		return false;
+	}
+	bool ok = true;
+	for (auto &node : bundle.info.nodes) {
+		if (!(node.flags & BundleFile::NodeIsSerializedFile)) {
+			continue;
+		}
+		std::string name = std::string(path) + ":" + node.path;
+		const char *data = bundle.NodeData(node);
+		AssetFile asset;
+		if (!data || !asset.OpenMemory(data, (size_t)node.size, &TypeTreeCache::Shared())) {
+			fprintf(stderr, "unityextract: cannot read %s\n", name.c_str());
+			ok = false;
+			continue;
+		}
+		ok = ExtractAsset(name.c_str(), asset, pool) && ok;
+	}
+	return ok;
+}
+
+// Extract extracts a SerializedFile, or each one in a bundle.
+bool Extract(const char *path, ThreadPool &pool) {
+	MappedFile probe;
+	if (probe.Open(path) && BundleFile::IsBundle(probe.data, probe.size)) {
+		return ExtractBundle(path, pool);
+	}
+	AssetFile asset;
+	if (!asset.Open(path, &TypeTreeCache::Shared())) {
+		fprintf(stderr, "unityextract: cannot read %s\n", path);
+		return false;
+	}
+	return ExtractAsset(path, asset, pool);
+}
+
+// ExtractStream is Extract for a file read from stdin, such as a pipe.  Each object is
+// decoded as soon as it has arrived, so lines are printed in the order of the payloads.
+bool ExtractStream() {
+	StreamParser parser;
+	parser.typeTrees = &TypeTreeCache::Shared();
+	std::unique_ptr<ObjectDecoder> decoder;
+	int failed = 0;
+	parser.onMetadata = [&](const SerializedFile &file) {
+		printf("-: version %d, %d types, %d objects\n", file.header.version,
+			(int)file.metadata.types.size(), (int)file.metadata.objects.size());
+		decoder.reset(new ObjectDecoder(file));
+	};
+	parser.onObject = [&](const SerializedFile::ObjectInfo &object, const char *data) {
+		NameVisitor visitor;
+		bool ok = data && decoder->Decode(object, data, visitor);
+		if (!ok) {
+			failed++;
+		}
+		std::string line = FormatObject(parser.file, object, ok, visitor);
+		fwrite(line.data(), 1, line.size(), stdout);
+	};
+	std::vector<char> chunk(1 << 16);
+	size_t n;
+	while ((n = fread(chunk.data(), 1, chunk.size(), stdin)) > 0) {
+		if (!parser.Feed(chunk.data(), n)) {
+			break;
+		}
+	}
+	if (!parser.Finish()) {
+		fprintf(stderr, "unityextract: cannot read -\n");
+		return false;
+	}
+	if (failed) {
+		fprintf(stderr, "unityextract: -: %d objects could not be decoded\n", failed);
+	}
+	return failed == 0;
+}
+
+// JsonLine writes object as one line of NDJSON: which file and object it is, its class and
+// type, and its fields under "data".  An object which fails to decode has what was read of
+// it closed off and is marked with "error".
+bool JsonLine(JsonWriter &out, JsonVisitor &visitor, const char *path, const SerializedFile &file,
+	ObjectDecoder &decoder, const SerializedFile::ObjectInfo &object, const char *data) {
+	const DecodeProgram *program = decoder.Program(file.TypeIndex(object));
+	out.Raw("{\"file\":");
+	out.String(path);
+	out.Raw(",\"pathID\":");
+	out.UInt(object.objectID);
+	out.Raw(",\"classID\":");
+	out.Int(file.ClassID(object));
+	if (program && !program->code.empty()) {
+		out.Raw(",\"type\":");
+		out.String(program->code[0].type);
+	}
+	out.Raw(",\"data\":");
+	bool ok = data && program && RunProgram(*program, data, (size_t)object.dataSize, file.header.bigEndian, visitor);
+	visitor.Finish();
+	if (!ok) {
+		out.Raw(",\"error\":true");
+	}
+	out.Raw("}\n");
+	return ok;
+}
+
+// JsonAsset writes every object of asset as NDJSON, in the order of the object table.
+// Batches of objects are formatted on the pool, each into its own buffer, and a window of
+// them is written out before the next is started.  A batch ends after Batch objects or
+// BatchBytes of object data, so that memory stays bounded however large the objects are:
+// an object with more data than that is a batch of its own, formatted straight into out,
+// which flushes as it goes, once the batches before it are written.
+bool JsonAsset(const char *path, AssetFile &asset, ThreadPool &pool, JsonWriter &out, size_t &objectCount) {
+	const size_t Batch = 256;
+	const size_t BatchBytes = 1 << 16;
+	auto &objects = asset.file.metadata.objects;
+	auto dataSize = [&](size_t i) { return objects[i].dataSize > 0 ? (size_t)objects[i].dataSize : 0; };
+	struct Range {
+		size_t begin;
+		size_t end;
+		bool direct;
+	};
+	std::vector<Range> batches;
+	for (size_t i = 0; i < objects.size();) {
+		if (dataSize(i) > BatchBytes) {
+			batches.push_back(Range{ i, i + 1, true });
+			i++;
+			continue;
+		}
+		size_t begin = i;
+		size_t bytes = 0;
+		for (; i < objects.size() && i - begin < Batch && bytes + dataSize(i) <= BatchBytes; i++) {
+			bytes += dataSize(i);
+		}
+		batches.push_back(Range{ begin, i, false });
+	}
+
+	size_t window = (size_t)pool.Size() * 4;
+	std::vector<std::unique_ptr<JsonWriter>> buffers;
+	for (size_t b = 0; b < std::min(window, batches.size()); b++) {
+		buffers.emplace_back(new JsonWriter(nullptr, 1 << 16));
+	}
+	std::atomic<int> failed{0};
+	auto format = [&](JsonWriter &writer, const Range &range) {
+		JsonVisitor visitor(writer);
+		for (size_t i = range.begin; i < range.end; i++) {
+			if (!JsonLine(writer, visitor, path, asset.file, *asset.decoder, objects[i], asset.ObjectData(objects[i]))) {
+				failed++;
+			}
+		}
+	};
+	for (size_t first = 0; first < batches.size(); first += window) {
+		size_t count = std::min(window, batches.size() - first);
+		pool.ParallelFor(count, [&](size_t b) {
+			buffers[b]->Clear();
+			if (!batches[first + b].direct) {
+				format(*buffers[b], batches[first + b]);
+			}
+		}, 1);
+		for (size_t b = 0; b < count; b++) {
+			if (batches[first + b].direct) {
+				format(out, batches[first + b]);
+			} else {
+				out.Raw(buffers[b]->data(), buffers[b]->size());
+			}
+		}
+	}
+	objectCount += objects.size();
+	if (failed) {
+		fprintf(stderr, "unityextract: %s: %d objects could not be decoded\n", path, (int)failed);
+	}
+	return failed == 0;
+}
+
+// Json writes the objects of a SerializedFile, or of each one in a bundle, as NDJSON.
+bool Json(const char *path, ThreadPool &pool, JsonWriter &out, size_t &objectCount) {
+	MappedFile probe;
+	if (probe.Open(path) && BundleFile::IsBundle(probe.data, probe.size)) {
+		BundleFile bundle;
+		if (!bundle.Open(path, &pool)) {
+			fprintf(stderr, "unityextract: cannot read bundle %s\n", path);
+			return false;
+		}
+		bool ok = true;
+		for (auto &node : bundle.info.nodes) {
+			if (!(node.flags & BundleFile::NodeIsSerializedFile)) {
+				continue;
+			}
+			std::string name = std::string(path) + ":" + node.path;
+			const char *data = bundle.NodeData(node);
+			AssetFile asset;
+			if (!data || !asset.OpenMemory(data, (size_t)node.size, &TypeTreeCache::Shared())) {
+				fprintf(stderr, "unityextract: cannot read %s\n", name.c_str());
+				ok = false;
+				continue;
+			}
+			ok = JsonAsset(name.c_str(), asset, pool, out, objectCount) && ok;
+		}
+		return ok;
+	}
+	AssetFile asset;
+	if (!asset.Open(path, &TypeTreeCache::Shared())) {
+		fprintf(stderr, "unityextract: cannot read %s\n", path);
+		return false;
+	}
+	return JsonAsset(path, asset, pool, out, objectCount);
+}
+
+// JsonStream is Json for a file read from stdin.  Each object is written as soon as it has
+// arrived, while the rest of the file is still being read.
+bool JsonStream(JsonWriter &out, size_t &objectCount) {
+	StreamParser parser;
+	parser.typeTrees = &TypeTreeCache::Shared();
+	std::unique_ptr<ObjectDecoder> decoder;
+	JsonVisitor visitor(out);
+	int failed = 0;
+	parser.onMetadata = [&](const SerializedFile &file) {
+		decoder.reset(new ObjectDecoder(file));
+	};
+	parser.onObject = [&](const SerializedFile::ObjectInfo &object, const char *data) {
+		if (!JsonLine(out, visitor, "-", parser.file, *decoder, object, data)) {
+			failed++;
+		}
+		objectCount++;
+	};
+	std::vector<char> chunk(1 << 16);
+	size_t n;
+	while ((n = fread(chunk.data(), 1, chunk.size(), stdin)) > 0) {
+		if (!parser.Feed(chunk.data(), n)) {
+			break;
+		}
+	}
+	if (!parser.Finish()) {
+		fprintf(stderr, "unityextract: cannot read -\n");
+		return false;
+	}
+	if (failed) {
+		fprintf(stderr, "unityextract: -: %d objects could not be decoded\n", failed);
+	}
+	return failed == 0;
+}
+
+// Find prints the object with pathID in each file.  Bundles are opened without
+// decompressing them, and only the blocks holding the metadata and the object are read,
+// through cache.
+bool Find(const char *path, uint64_t pathID, BlockCache &cache) {
+	bool found = false;
+	auto print = [&](const char *name, const SerializedFile &file, const SerializedFile::ObjectInfo &object,
+		bool ok, const NameVisitor &visitor) {
+		std::string line = FormatObject(file, object, ok, visitor);
+		printf("%s\t%s", name, line.c_str());
+		found = true;
+	};
+	MappedFile probe;
+	if (probe.Open(path) && BundleFile::IsBundle(probe.data, probe.size)) {
+		BundleFile bundle;
+		if (!bundle.OpenTables(path)) {
+			fprintf(stderr, "unityextract: cannot read bundle %s\n", path);
+			return false;
+		}
+		for (auto &node : bundle.info.nodes) {
+			BundleAsset asset;
+			if (!(node.flags & BundleFile::NodeIsSerializedFile) ||
+				!asset.Open(bundle, node, cache, &TypeTreeCache::Shared())) {
+				continue;
+			}
+			if (const SerializedFile::ObjectInfo *object = asset.Find(pathID)) {
+				NameVisitor visitor;
+				std::vector<char> data;
+				bool ok = asset.Decode(pathID, visitor, data);
+				std::string name = std::string(path) + ":" + node.path;
+				print(name.c_str(), asset.file, *object, ok, visitor);
+			}
+		}
+	} else {
+		AssetFile asset;
+		if (!asset.Open(path, &TypeTreeCache::Shared())) {
+			fprintf(stderr, "unityextract: cannot read %s\n", path);
+			return false;
+		}
+		if (const SerializedFile::ObjectInfo *object = asset.Find(pathID)) {
+			NameVisitor visitor;
+			bool ok = asset.Decode(pathID, visitor);
+			print(path, asset.file, *object, ok, visitor);
+		}
+	}
+	return found;
+}
+
+// Filter prints the objects of each file which query selects.  Only those objects are
+// decoded; bundles are opened as by Find, so only the blocks holding the metadata, the names
+// the query reads and the selected objects are decompressed.
+bool Filter(const char *path, const ObjectQuery &query, BlockCache &cache, ObjectQuery::Stats &stats) {
+	bool found = false;
+	auto print = [&](const char *name, const SerializedFile &file, const SerializedFile::ObjectInfo &object,
+		bool ok, const NameVisitor &visitor) {
+		std::string line = FormatObject(file, object, ok, visitor);
+		printf("%s\t%s", name, line.c_str());
+		found = true;
+	};
+	MappedFile probe;
+	if (probe.Open(path) && BundleFile::IsBundle(probe.data, probe.size)) {
+		BundleFile bundle;
+		if (!bundle.OpenTables(path)) {
+			fprintf(stderr, "unityextract: cannot read bundle %s\n", path);
+			return false;
+		}
+		std::vector<char> data;
+		for (auto &node : bundle.info.nodes) {
+			BundleAsset asset;
+			if (!(node.flags & BundleFile::NodeIsSerializedFile) ||
+				!asset.Open(bundle, node, cache, &TypeTreeCache::Shared())) {
+				continue;
+			}
+			std::string name = std::string(path) + ":" + node.path;
+			for (uint32_t i : query.Select(asset, &stats)) {
+				auto &object = asset.file.metadata.objects[i];
+				NameVisitor visitor;
+				bool ok = asset.ObjectData(object, data) && asset.decoder->Decode(object, data.data(), visitor);
+				print(name.c_str(), asset.file, object, ok, visitor);
+			}
+		}
+	} else {
+		AssetFile asset;
+		if (!asset.Open(path, &TypeTreeCache::Shared())) {
+			fprintf(stderr, "unityextract: cannot read %s\n", path);
+			return false;
+		}
+		for (uint32_t i : query.Select(asset, &stats)) {
+			auto &object = asset.file.metadata.objects[i];
+			NameVisitor visitor;
+			const char *data = asset.ObjectData(object);
+			bool ok = data && asset.decoder->Decode(object, data, visitor);
+			print(path, asset.file, object, ok, visitor);
+		}
+	}
+	return found;
+}
+
+struct TextureStats {
+	size_t decoded = 0;
+	size_t skipped = 0;
+	// Textures whose image data was in a resource file.
+	size_t streamed = 0;
+	uint64_t pixels = 0;
+	double seconds = 0;
+};
+
+// Directory returns the directory part of path, or "" if it has none.
+std::string Directory(const char *path) {
+	const char *slash = strrchr(path, '/');
+	return slash ? std::string(path, slash) : std::string();
+}
+
+// WritePam writes an RGBA image to path as a PAM, top row first.
+bool WritePam(const std::string &path, const std::vector<uint8_t> &rgba, int width, int height) {
+	FILE *fp = fopen(path.c_str(), "wb");
+	if (!fp) {
+		return false;
+	}
+	fprintf(fp, "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n", width, height);
+	for (int y = height - 1; y >= 0; y--) {
+		fwrite(rgba.data() + (size_t)y * width * 4, 1, (size_t)width * 4, fp);
+	}
+	return fclose(fp) == 0;
+}
+
+// DecodeTextures decodes the top mip level of every Texture2D in asset whose format
+// DecodeTexture reads, spreading each over pool, and writes it to outDir when given.
+// Streamed image data is decoded in place in its resource file.
+bool DecodeTextures(const char *path, AssetFile &asset, ResourceResolver &resources, ThreadPool &pool,
+	const char *outDir, TextureStats &stats) {
+	const int texture2D = 28;
+	std::vector<uint8_t> rgba;
+	bool ok = true;
+	for (auto &object : asset.file.metadata.objects) {
+		if (asset.file.ClassID(object) != texture2D) {
+			continue;
+		}
+		TextureVisitor visitor;
+		const char *data = asset.ObjectData(object);
+		if (!data || !asset.decoder->Decode(object, data, visitor)) {
+			stats.skipped++;
+			continue;
+		}
+		if (visitor.size == 0 && !visitor.streaming.streams.empty()) {
+			const StreamingInfo &stream = visitor.streaming.streams[0];
+			const ResourceFile *resource = resources.Find(stream.path);
+			visitor.data = resource ? resource->View(stream) : nullptr;
+			visitor.size = visitor.data ? (size_t)stream.size : 0;
+			stats.streamed += visitor.data != nullptr;
+		}
+		TextureFormat format = (TextureFormat)visitor.format;
+		if (!visitor.data || !TextureSize(format, visitor.width, visitor.height)) {
+			stats.skipped++;
+			continue;
+		}
+		rgba.resize((size_t)visitor.width * visitor.height * 4);
+		auto start = std::chrono::steady_clock::now();
+		bool decoded = DecodeTexture(format, visitor.data, visitor.size, visitor.width, visitor.height, rgba.data(),
+			(size_t)visitor.width * 4, &pool);
+		stats.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (!decoded) {
+			stats.skipped++;
+			continue;
+		}
+		stats.decoded++;
+		stats.pixels += (uint64_t)visitor.width * visitor.height;
+		printf("%s\t%llu\t%d\t%dx%d\t%.*s\n", path, (unsigned long long)object.objectID, visitor.format,
+			visitor.width, visitor.height, visitor.name.length, visitor.name.name ? visitor.name.name : "");
+		if (outDir) {
+			std::string out = std::string(outDir) + "/" + std::to_string(object.objectID) + ".pam";
+			if (!WritePam(out, rgba, visitor.width, visitor.height)) {
+				fprintf(stderr, "unityextract: cannot write %s\n", out.c_str());
+				ok = false;
+			}
+		}
+	}
+	return ok;
+}
+
+// Textures decodes the textures of a SerializedFile, or of each one in a bundle.
+bool Textures(const char *path, ThreadPool &pool, const char *outDir, TextureStats &stats) {
+	MappedFile probe;
+	if (probe.Open(path) && BundleFile::IsBundle(probe.data, probe.size)) {
+		BundleFile bundle;
+		if (!bundle.Open(path, &pool)) {
+			fprintf(stderr, "unityextract: cannot read bundle %s\n", path);
+			return false;
+		}
+		ResourceResolver resources(bundle);
+		bool ok = true;
+		for (auto &node : bundle.info.nodes) {
+			if (!(node.flags & BundleFile::NodeIsSerializedFile)) {
+				continue;
+			}
+			std::string name = std::string(path) + ":" + node.path;
+			const char *data = bundle.NodeData(node);
+			AssetFile asset;
+			if (!data || !asset.OpenMemory(data, (size_t)node.size, &TypeTreeCache::Shared())) {
+				fprintf(stderr, "unityextract: cannot read %s\n", name.c_str());
+				ok = false;
+				continue;
+			}
+			ok = DecodeTextures(name.c_str(), asset, resources, pool, outDir, stats) && ok;
+		}
+		return ok;
+	}
+	AssetFile asset;
+	if (!asset.Open(path, &TypeTreeCache::Shared())) {
+		fprintf(stderr, "unityextract: cannot read %s\n", path);
+		return false;
+	}
+	ResourceResolver resources(Directory(path));
+	return DecodeTextures(path, asset, resources, pool, outDir, stats);
+}
+
+struct StreamStats {
+	size_t streams = 0;
+	size_t missing = 0;
+	uint64_t bytes = 0;
+	double seconds = 0;
+};
+
+// HashStream prints where stream lies and the 64-bit FNV-1a hash of its bytes, read in
+// chunks of chunkSize.
+bool HashStream(const char *name, const SerializedFile::ObjectInfo &object, const StreamingInfo &stream,
+	ResourceResolver &resources, size_t chunkSize, StreamStats &stats) {
+	stats.streams++;
+	const ResourceFile *resource = resources.Find(stream.path);
+	uint64_t hash = 14695981039346656037ull;
+	auto start = std::chrono::steady_clock::now();
+	bool read = resource && resource->Read(stream, chunkSize, [&](const char *chunk, size_t size) {
+		for (size_t i = 0; i < size; i++) {
+			hash = (hash ^ (uint8_t)chunk[i]) * 1099511628211ull;
+		}
+		return true;
+	});
+	stats.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (!read) {
+		stats.missing++;
+		fprintf(stderr, "unityextract: %s: object %llu: cannot read %llu bytes at %llu of %s\n", name,
+			(unsigned long long)object.objectID, (unsigned long long)stream.size, (unsigned long long)stream.offset,
+			stream.path.c_str());
+		return false;
+	}
+	stats.bytes += stream.size;
+	printf("%s\t%llu\t%s\t%llu\t%llu\t%016llx\n", name, (unsigned long long)object.objectID, stream.path.c_str(),
+		(unsigned long long)stream.offset, (unsigned long long)stream.size, (unsigned long long)hash);
+	return true;
+}
+
+// Streams hashes the streamed data of every object in a SerializedFile, or in each one in a
+// bundle.  Bundles are read through cache, objects and resource files alike, so memory
+// stays within its budget however large the resource files are.
+bool Streams(const char *path, BlockCache &cache, size_t chunkSize, StreamStats &stats) {
+	bool ok = true;
+	MappedFile probe;
+	if (probe.Open(path) && BundleFile::IsBundle(probe.data, probe.size)) {
+		BundleFile bundle;
+		if (!bundle.OpenTables(path)) {
+			fprintf(stderr, "unityextract: cannot read bundle %s\n", path);
+			return false;
+		}
+		ResourceResolver resources(bundle, &cache);
+		std::vector<char> data;
+		for (auto &node : bundle.info.nodes) {
+			BundleAsset asset;
+			if (!(node.flags & BundleFile::NodeIsSerializedFile) ||
+				!asset.Open(bundle, node, cache, &TypeTreeCache::Shared())) {
+				continue;
+			}
+			std::string name = std::string(path) + ":" + node.path;
+			for (auto &object : asset.file.metadata.objects) {
+				StreamingVisitor visitor;
+				if (!asset.decoder->Program(asset.file.TypeIndex(object)) || !asset.ObjectData(object, data)) {
+					continue;
+				}
+				asset.decoder->Decode(object, data.data(), visitor);
+				for (auto &stream : visitor.streams) {
+					ok = HashStream(name.c_str(), object, stream, resources, chunkSize, stats) && ok;
+				}
+			}
+		}
+		return ok;
+	}
+	AssetFile asset;
+	if (!asset.Open(path, &TypeTreeCache::Shared())) {
+		fprintf(stderr, "unityextract: cannot read %s\n", path);
+		return false;
+	}
+	ResourceResolver resources(Directory(path));
+	for (auto &object : asset.file.metadata.objects) {
+		StreamingVisitor visitor;
+		const char *data = asset.ObjectData(object);
+		if (!data || !asset.decoder->Program(asset.file.TypeIndex(object))) {
+			continue;
+		}
+		asset.decoder->Decode(object, data, visitor);
+		for (auto &stream : visitor.streams) {
+			ok = HashStream(path, object, stream, resources, chunkSize, stats) && ok;
+		}
+	}
+	return ok;
+}
+
+// ReadList appends the paths listed one per line in listPath.
+bool ReadList(const char *listPath, std::vector<std::string> &paths) {
+	FILE *fp = fopen(listPath, "r");
+	if (!fp) {
+		return false;
+	}
+	char line[4096];
+	while (fgets(line, sizeof(line), fp)) {
+		size_t n = strcspn(line, "\r\n");
+		if (n > 0) {
+			paths.emplace_back(line, n);
+		}
+	}
+	fclose(fp);
+	return true;
+}
+
+// ScanIndexed summarizes paths from the index at indexPath, first bringing it up to date:
+// only files which changed since the index was written are read.
+bool ScanIndexed(const char *indexPath, const std::vector<std::string> &paths, ThreadPool &pool,
+	CorpusSummary &summary) {
+	MetadataIndex index;
+	index.Open(indexPath);
+	std::vector<char> image;
+	MetadataIndex::BuildStats stats = MetadataIndex::Build(paths, &index, pool, image);
+	if (!image.empty()) {
+		index.Close();
+		if (!MetadataIndex::Save(indexPath, image) || !index.Open(indexPath)) {
+			fprintf(stderr, "unityextract: cannot write %s\n", indexPath);
+			return false;
+		}
+	}
+	fprintf(stderr, "index: %zu reused, %zu rehashed, %zu read, %zu removed in %.3f s\n",
+		stats.reused, stats.rehashed, stats.parsed, stats.removed, stats.seconds);
+	for (size_t i = 0; i < index.FileCount(); i++) {
+		summary.Add(index, i);
+	}
+	summary.seconds = stats.seconds;
+	return true;
+}
+
+#ifdef UNITYPACK_PROFILE
+// WriteProfile writes profile as folded stacks, one file per metric.
+bool WriteProfile(const serialize::Profile &profile, const char *prefix) {
+	using Metric = serialize::Profile::Metric;
+	const std::pair<Metric, const char *> metrics[] = {
+		{ Metric::Time, "time" },
+		{ Metric::Bytes, "bytes" },
+		{ Metric::Calls, "calls" },
+	};
+	for (auto &metric : metrics) {
+		std::string path = std::string(prefix) + "." + metric.second + ".folded";
+		FILE *fp = fopen(path.c_str(), "w");
+		if (!fp) {
+			fprintf(stderr, "unityextract: cannot write %s\n", path.c_str());
+			return false;
+		}
+		profile.WriteFolded(fp, metric.first);
+		fclose(fp);
+	}
+	return true;
+}
+#endif
+
+// CollectPaths expands args, each a directory, a file or an @list, into paths.
+bool CollectPaths(const std::vector<const char *> &args, std::vector<std::string> &paths) {
+	for (const char *arg : args) {
+		bool found = arg[0] == '@' ? ReadList(arg + 1, paths) : CorpusScanner::CollectFiles(arg, paths);
+		if (!found) {
+			fprintf(stderr, "unityextract: cannot read %s\n", arg);
+			return false;
+		}
+	}
+	return true;
+}
+
+// Scan summarizes the metadata of every file below paths.
+bool Scan(const std::vector<const char *> &args, ThreadPool &pool, int inFlight, const char *indexPath,
+	const char *profilePath) {
+	std::vector<std::string> paths;
+	if (!CollectPaths(args, paths)) {
+		return false;
+	}
+	CorpusSummary summary;
+	if (indexPath) {
+		if (!ScanIndexed(indexPath, paths, pool, summary)) {
+			return false;
+		}
+	} else {
+		CorpusScanner scanner(pool, inFlight);
+		summary = scanner.Scan(paths);
+#ifdef UNITYPACK_PROFILE
+		if (profilePath && !WriteProfile(scanner.profile, profilePath)) {
+			return false;
+		}
+#endif
+	}
+
+	double seconds = summary.seconds > 0 ? summary.seconds : 1e-9;
+	double megabytes = summary.fileBytes / 1e6;
+	printf("scanned %zu files (%zu failed, %zu skipped), %.1f MB, %.1f MB of metadata in %.3f s\n",
+		summary.files, summary.failed, summary.skipped, megabytes, summary.readBytes / 1e6, summary.seconds);
+	printf("%.1f files/s, %.1f MB/s\n", (summary.files + summary.failed + summary.skipped) / seconds,
+		megabytes / seconds);
+	printf("classID\tobjects\tbytes\n");
+	for (auto &entry : summary.classes) {
+		printf("%d\t%zu\t%llu\n", entry.first, entry.second.objects, (unsigned long long)entry.second.bytes);
+	}
+	printf("files\texternal\n");
+	for (auto &entry : summary.externalFiles) {
+		printf("%zu\t%s\n", entry.second, entry.first.c_str());
+	}
+	for (auto &path : summary.failedPaths) {
+		fprintf(stderr, "unityextract: cannot parse %s\n", path.c_str());
+	}
+	return summary.failed == 0;
+}
+
+// Reach lists the objects which root, "file" or "file:pathID", references directly or
+// through other objects, across every file below args.  A root without a pathID starts from
+// every object of the file.
+bool Reach(const char *root, const std::vector<const char *> &args, ThreadPool &pool) {
+	std::vector<std::string> paths;
+	if (!CollectPaths(args, paths)) {
+		return false;
+	}
+	DependencyGraph graph;
+	if (!graph.Load(paths, pool)) {
+		fprintf(stderr, "unityextract: no file could be read\n");
+		return false;
+	}
+	const DependencyGraph::Stats &stats = graph.stats;
+	fprintf(stderr, "graph: %zu files (%zu failed), %zu objects (%zu undecoded), "
+		"%zu references, %zu resolved, %zu edges, loaded in %.3f s, built in %.3f s\n",
+		stats.files, stats.failed, stats.objects, stats.undecoded, stats.references, stats.resolved,
+		stats.edges, stats.loadSeconds, stats.buildSeconds);
+
+	// A name may itself contain ':', so only a numeric suffix is taken as a pathID.
+	std::string name = root;
+	const char *pathID = nullptr;
+	size_t colon = name.rfind(':');
+	if (colon != std::string::npos && colon + 1 < name.size() &&
+		name.find_first_not_of("0123456789", colon + 1) == std::string::npos) {
+		pathID = root + colon + 1;
+		name.resize(colon);
+	}
+	int file = -1;
+	for (size_t f = 0; f < graph.files.size() && file < 0; f++) {
+		if (graph.files[f].name == name) {
+			file = (int)f;
+		}
+	}
+	if (file < 0) {
+		file = graph.FindFile(name);
+	}
+	if (file < 0) {
+		fprintf(stderr, "unityextract: %s is not in the corpus\n", name.c_str());
+		return false;
+	}
+	std::vector<uint32_t> roots;
+	if (pathID) {
+		int64_t object = graph.FindObject(file, strtoull(pathID, nullptr, 10));
+		if (object < 0) {
+			fprintf(stderr, "unityextract: %s has no object %s\n", graph.files[file].name.c_str(), pathID);
+			return false;
+		}
+		roots.push_back((uint32_t)object);
+	} else {
+		for (uint32_t object = graph.objectBase[file]; object < graph.objectBase[file + 1]; object++) {
+			roots.push_back(object);
+		}
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<uint32_t> reached = Reachable(graph.objects, roots, pool);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::vector<size_t> perFile(graph.files.size());
+	for (uint32_t object : reached) {
+		perFile[graph.FileOf(object)]++;
+	}
+	size_t files = 0;
+	printf("objects\tfile\n");
+	for (size_t f = 0; f < perFile.size(); f++) {
+		if (perFile[f]) {
+			printf("%zu\t%s\n", perFile[f], graph.files[f].name.c_str());
+			files++;
+		}
+	}
+	printf("reached %zu objects in %zu files in %.3f s\n", reached.size(), files, seconds);
+	return true;
+}
+
+};
+
+int main(int argc, char **argv) {
+	int threads = 0;
+	int inFlight = 0;
+	bool scan = false;
+	const char *find = nullptr;
+	const char *reach = nullptr;
+	bool filter = false;
+	bool textures = false;
+	const char *outDir = nullptr;
+	bool streams = false;
+	bool json = false;
+	size_t chunkKB = 1024;
+	ObjectQuery query;
+	const char *indexPath = nullptr;
+	const char *profilePath = nullptr;
+	size_t cacheMB = 64;
+	std::vector<const char *> paths;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--scan") == 0) {
+			scan = true;
+		} else if (strcmp(argv[i], "--find") == 0 && i + 1 < argc) {
+			find = argv[++i];
+		} else if (strcmp(argv[i], "--textures") == 0) {
+			textures = true;
+		} else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+			outDir = argv[++i];
+		} else if (strcmp(argv[i], "--json") == 0) {
+			json = true;
+		} else if (strcmp(argv[i], "--streams") == 0) {
+			streams = true;
+		} else if (strcmp(argv[i], "--chunk-kb") == 0 && i + 1 < argc) {
+			chunkKB = (size_t)atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--filter") == 0) {
+			filter = true;
+		} else if (strcmp(argv[i], "--class") == 0 && i + 1 < argc) {
+			query.classIDs.push_back(atoi(argv[++i]));
+		} else if (strcmp(argv[i], "--type-index") == 0 && i + 1 < argc) {
+			query.typeIndices.push_back(atoi(argv[++i]));
+		} else if (strcmp(argv[i], "--script-hash") == 0 && i + 1 < argc) {
+			if (!ObjectQuery::ParseHash(argv[++i], query.scriptHash)) {
+				Usage();
+				return 2;
+			}
+			query.matchScriptHash = true;
+		} else if (strcmp(argv[i], "--name") == 0 && i + 1 < argc) {
+			// A trailing '*' matches names starting with the rest.
+			query.name = argv[++i];
+			query.matchName = true;
+			query.namePrefix = !query.name.empty() && query.name.back() == '*';
+			if (query.namePrefix) {
+				query.name.pop_back();
+			}
+		} else if (strcmp(argv[i], "--reach") == 0 && i + 1 < argc) {
+			reach = argv[++i];
+		} else if (strcmp(argv[i], "--cache-mb") == 0 && i + 1 < argc) {
+			cacheMB = (size_t)atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--index") == 0 && i + 1 < argc) {
+			indexPath = argv[++i];
+#ifdef UNITYPACK_PROFILE
+		} else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+			profilePath = argv[++i];
+#endif
+		} else if (strcmp(argv[i], "--in-flight") == 0 && i + 1 < argc) {
+			inFlight = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+			threads = atoi(argv[++i]);
+		} else if (strncmp(argv[i], "-j", 2) == 0 && argv[i][2]) {
+			threads = atoi(argv[i] + 2);
+		} else if (argv[i][0] == '-' && argv[i][1]) {
+			Usage();
+			return 2;
+		} else {
+			paths.push_back(argv[i]);
+		}
+	}
+	if (paths.empty()) {
+		Usage();
+		return 2;
+	}
+	if (indexPath && profilePath) {
+		// An indexed scan reads files through MetadataIndex::Build, which is not profiled.
+		fprintf(stderr, "unityextract: --profile cannot be combined with --index\n");
+		return 2;
+	}
+
+	if (find) {
+		uint64_t pathID = strtoull(find, nullptr, 10);
+		BlockCache cache(cacheMB << 20);
+		bool ok = false;
+		for (const char *path : paths) {
+			ok = Find(path, pathID, cache) || ok;
+		}
+		BlockCache::Stats stats = cache.GetStats();
+		fprintf(stderr, "block cache: %zu hits, %zu misses, %zu evictions, %zu/%zu bytes\n",
+			stats.hits, stats.misses, stats.evictions, stats.bytes, stats.budget);
+		return ok ? 0 : 1;
+	}
+
+	if (filter) {
+		BlockCache cache(cacheMB << 20);
+		ObjectQuery::Stats stats;
+		bool ok = false;
+		for (const char *path : paths) {
+			ok = Filter(path, query, cache, stats) || ok;
+		}
+		fprintf(stderr, "filter: %zu objects, %zu of a matching type, %zu names at a fixed offset, "
+			"%zu after a prefix, %zu name bytes read, %zu matched\n", stats.objects, stats.typeMatches,
+			stats.fixedReads, stats.prefixDecodes, stats.nameBytes, stats.matches);
+		return ok ? 0 : 1;
+	}
+
+	if (streams) {
+		BlockCache cache(cacheMB << 20);
+		StreamStats stats;
+		bool ok = true;
+		for (const char *path : paths) {
+			ok = Streams(path, cache, std::max<size_t>(chunkKB, 1) << 10, stats) && ok;
+		}
+		double megabytes = stats.bytes / 1048576.0;
+		fprintf(stderr, "streams: %zu read, %zu unreadable, %.1f MB in %.3f s, %.1f MB/s\n",
+			stats.streams - stats.missing, stats.missing, megabytes, stats.seconds,
+			stats.seconds > 0 ? megabytes / stats.seconds : 0.0);
+		return ok ? 0 : 1;
+	}
+
+	ThreadPool pool(threads);
+	if (json) {
+		JsonWriter out(stdout);
+		size_t objectCount = 0;
+		auto start = std::chrono::steady_clock::now();
+		bool ok = true;
+		for (const char *path : paths) {
+			ok = (strcmp(path, "-") == 0 ? JsonStream(out, objectCount) : Json(path, pool, out, objectCount)) && ok;
+		}
+		if (!out.Flush() || fflush(stdout) != 0) {
+			fprintf(stderr, "unityextract: cannot write output\n");
+			return 1;
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		double megabytes = out.written / 1048576.0;
+		fprintf(stderr, "json: %zu objects, %.1f MB in %.3f s, %.1f MB/s\n", objectCount, megabytes, seconds,
+			seconds > 0 ? megabytes / seconds : 0.0);
+		return ok ? 0 : 1;
+	}
+	if (textures) {
+		TextureStats stats;
+		bool ok = true;
+		for (const char *path : paths) {
+			ok = Textures(path, pool, outDir, stats) && ok;
+		}
+		double megapixels = stats.pixels / 1e6;
+		fprintf(stderr, "textures: %zu decoded (%zu streamed), %zu skipped, %.1f megapixels in %.3f s, "
+			"%.1f megapixels/s\n", stats.decoded, stats.streamed, stats.skipped, megapixels, stats.seconds,
+			stats.seconds > 0 ? megapixels / stats.seconds : 0.0);
+		return ok ? 0 : 1;
+	}
+	if (reach) {
+		return Reach(reach, paths, pool) ? 0 : 1;
+	}
+	if (scan) {
+		return Scan(paths, pool, inFlight, indexPath, profilePath) ? 0 : 1;
+	}
+	bool ok = true;
+	for (const char *path : paths) {
+		ok = (strcmp(path, "-") == 0 ? ExtractStream() : Extract(path, pool)) && ok;
+	}
+	return ok ? 0 : 1;
 }
@@ -0,0 +1,99 @@
+// AllocationTest checks that parsing metadata makes no heap allocations in the serializer
+// itself.  Global operator new is replaced with one which counts, and the file is parsed
+// into an arena which has no upstream: the containers allocate from the arena, so every
+// allocation counted is the serializer's.
+#include "MmapReader.h"
+#include "SerializedFile.h"
+#include "Synthetic.h"
+#include "Test.h"
+#include <new>
+
+using namespace unitypack;
+
+namespace {
+
+size_t allocations = 0;
+
+};
+
+void *operator new(size_t size) {
+	allocations++;
+	if (void *p = malloc(size ? size : 1)) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) {
+	return operator new(size);
+}
+
+// std::pmr::new_delete_resource allocates through the aligned forms.
+void *operator new(size_t size, std::align_val_t alignment) {
+	allocations++;
+	size_t align = (size_t)alignment;
+	if (void *p = aligned_alloc(align, (size + align - 1) / align * align)) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+	free(p);
+}
+
+void operator delete[](void *p) noexcept {
+	free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+	free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+	free(p);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept {
+	free(p);
+}
+
+void operator delete(void *p, size_t, std::align_val_t) noexcept {
+	free(p);
+}
+
+namespace {
+
+void CheckParse(int version, bool bigEndian) {
+	synthetic::Options options;
+	options.version = version;
+	options.bigEndian = bigEndian;
+	std::vector<char> bytes = synthetic::Build(options);
+
+	// The arena's buffer is allocated before counting starts.
+	std::unique_ptr<char[]> buffer(new char[bytes.size() * 4]);
+	std::pmr::monotonic_buffer_resource arena(buffer.get(), bytes.size() * 4, std::pmr::null_memory_resource());
+	size_t before = allocations;
+	{
+		SerializedFile file(&arena);
+		serialize::MmapReaderT<serialize::Endian::Big> s{};
+		s.SetRange(bytes.data(), bytes.size());
+		CHECK(file.Read(s));
+		CHECK(file.metadata.objects.size() == (size_t)options.objects);
+	}
+	size_t counted = allocations - before;
+	if (counted != 0) {
+		fprintf(stderr, "version %d %s: %zu allocations\n", version, bigEndian ? "big-endian" : "little-endian", counted);
+	}
+	CHECK(counted == 0);
+}
+
+};
+
+int main() {
+	for (int version : { 9, 11, 14, 15, 17, 21 }) {
+		CheckParse(version, false);
+		CheckParse(version, true);
+	}
+	return test::Result();
+}
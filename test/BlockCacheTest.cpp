@@ -0,0 +1,202 @@
+// BlockCacheTest checks that BlockCache stays within its budget, evicts the least recently
+// used block first, passes blocks larger than a shard through uncached and counts all of
+// it; then that BundleFile::Read through a cache returns what Open decompressed whole.
+#include "BlockCache.h"
+#include "BundleFile.h"
+#include "Synthetic.h"
+#include "Test.h"
+
+using namespace unitypack;
+
+namespace {
+
+const char *const Path = "unitypack-test-cache.unity3d";
+
+// Loader fills blocks of size bytes with their index, counting the loads.
+struct Loader {
+	size_t size;
+	int loads = 0;
+
+	BlockCache::Block Get(BlockCache &cache, uint64_t index) {
+		return cache.Get(BlockCache::Key{ 1, index }, [&](std::vector<char> &block) {
+			loads++;
+			block.assign(size, (char)index);
+			return true;
+		});
+	}
+};
+
+bool Cached(BlockCache &cache, uint64_t index) {
+	bool loaded = false;
+	cache.Get(BlockCache::Key{ 1, index }, [&](std::vector<char> &block) {
+		loaded = true;
+		return false;
+	});
+	return !loaded;
+}
+
+void CheckEviction() {
+	BlockCache cache(1000, 1);
+	Loader loader{ 300 };
+	std::vector<BlockCache::Block> held;
+	for (uint64_t i = 0; i < 3; i++) {
+		held.push_back(loader.Get(cache, i));
+		CHECK(held[i] && held[i]->size() == 300 && (*held[i])[0] == (char)i);
+	}
+	BlockCache::Stats stats = cache.GetStats();
+	CHECK(stats.budget == 1000 && stats.bytes == 900);
+	CHECK(stats.misses == 3 && stats.hits == 0 && stats.evictions == 0);
+
+	// Touching block 0 leaves block 1 the least recently used, so block 3 evicts it.
+	CHECK(loader.Get(cache, 0) == held[0]);
+	loader.Get(cache, 3);
+	stats = cache.GetStats();
+	CHECK(loader.loads == 4 && stats.bytes == 900 && stats.evictions == 1);
+	CHECK(stats.hits == 1 && stats.misses == 4);
+	// An evicted block stays valid for whoever holds it.
+	CHECK(held[1]->size() == 300 && (*held[1])[299] == 1);
+
+	// Reloading block 1 evicts block 2, now the oldest.
+	loader.Get(cache, 1);
+	CHECK(loader.loads == 5 && cache.GetStats().evictions == 2);
+	CHECK(Cached(cache, 0) && Cached(cache, 1) && !Cached(cache, 2) && Cached(cache, 3));
+	CHECK(cache.GetStats().bytes == 900);
+
+	// A failed load caches nothing.
+	CHECK(!cache.Get(BlockCache::Key{ 2, 0 }, [](std::vector<char> &) { return false; }));
+	CHECK(cache.GetStats().bytes == 900);
+
+	cache.Clear();
+	stats = cache.GetStats();
+	CHECK(stats.bytes == 0 && stats.evictions == 2);
+	CHECK(!Cached(cache, 0) && !Cached(cache, 1) && !Cached(cache, 3));
+}
+
+void CheckOversized() {
+	BlockCache cache(1000, 1);
+	Loader loader{ 1001 };
+	BlockCache::Block block = loader.Get(cache, 7);
+	CHECK(block && block->size() == 1001);
+	loader.Get(cache, 7);
+	BlockCache::Stats stats = cache.GetStats();
+	CHECK(loader.loads == 2 && stats.misses == 2 && stats.hits == 0);
+	CHECK(stats.bytes == 0 && stats.evictions == 0);
+
+	// A block of exactly the budget is cached, and evicts everything else.
+	Loader small{ 100 };
+	small.Get(cache, 1);
+	small.Get(cache, 2);
+	Loader whole{ 1000 };
+	whole.Get(cache, 3);
+	stats = cache.GetStats();
+	CHECK(stats.bytes == 1000 && stats.evictions == 2);
+	CHECK(Cached(cache, 3));
+}
+
+// CheckShards keeps the budget across shards under a stream of reads.
+void CheckShards() {
+	BlockCache cache(4000, 4);
+	CHECK(cache.GetStats().budget == 4000);
+	uint32_t seed = 7;
+	for (int i = 0; i < 2000; i++) {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		Loader loader{ 50 + seed % 400 };
+		BlockCache::Block block = loader.Get(cache, seed % 64);
+		CHECK(block && (*block)[0] == (char)(seed % 64));
+		CHECK(cache.GetStats().bytes <= 4000);
+	}
+	BlockCache::Stats stats = cache.GetStats();
+	CHECK(stats.hits + stats.misses == 2000);
+	CHECK(stats.hits > 0 && stats.evictions > 0);
+}
+
+std::vector<synthetic::BundleNode> Nodes() {
+	synthetic::Options options;
+	options.objects = 300;
+	return {
+		synthetic::BundleNode{ "CAB-cache", synthetic::Build(options), true },
+		synthetic::BundleNode{ "CAB-cache.resS", std::vector<char>(20000, 'r'), false },
+	};
+}
+
+// CheckBundleReads reads ranges of a bundle opened with OpenTables through caches of
+// several budgets, and compares them with the stream Open decompressed whole.
+void CheckBundleReads(ThreadPool &pool) {
+	synthetic::BundleOptions options;
+	options.blockSize = 4096;
+	options.alternateBlocks = true;
+	CHECK(synthetic::WriteBytes(Path, synthetic::BuildBundle(Nodes(), options)));
+	BundleFile whole;
+	BundleFile tables;
+	CHECK(whole.Open(Path));
+	CHECK(tables.OpenTables(Path));
+	CHECK(whole.dataSize == tables.dataSize && tables.info.blocks.size() > 8);
+	CHECK(whole.id != tables.id);
+	const size_t size = whole.dataSize;
+	const char *expected = whole.data.get();
+
+	// Ranges within a block, across blocks, empty, at the end and the whole stream.
+	std::vector<std::pair<uint64_t, size_t>> ranges = {
+		{ 0, 1 }, { 100, 200 }, { 4000, 200 }, { 4096, 4096 }, { 1000, 20000 }, { 5000, 0 },
+		{ size - 1, 1 }, { size, 0 }, { 0, size },
+	};
+	uint32_t seed = 3;
+	for (int i = 0; i < 200; i++) {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		uint64_t offset = seed % size;
+		ranges.push_back({ offset, (seed >> 8) % std::min<size_t>(size - offset, 10000) });
+	}
+
+	for (size_t budget : { (size_t)1000, (size_t)10000, (size_t)1 << 20 }) {
+		BlockCache cache(budget, 1);
+		for (auto &range : ranges) {
+			std::vector<char> out(range.second + 1);
+			CHECK(tables.Read(range.first, range.second, out.data(), cache));
+			CHECK(memcmp(out.data(), expected + range.first, range.second) == 0);
+			// A bundle decompressed whole reads from its stream.
+			CHECK(whole.Read(range.first, range.second, out.data(), cache));
+			CHECK(memcmp(out.data(), expected + range.first, range.second) == 0);
+		}
+		BlockCache::Stats stats = cache.GetStats();
+		CHECK(stats.bytes <= budget);
+		if (budget < 4096) {
+			CHECK(stats.hits == 0 && stats.bytes == 0);
+		} else {
+			CHECK(stats.hits > 0);
+		}
+
+		char byte;
+		CHECK(!tables.Read(size, 1, &byte, cache));
+		CHECK(!tables.Read(size - 1, 2, &byte, cache));
+		CHECK(!tables.Read((uint64_t)-1, 1, &byte, cache));
+	}
+
+	// Threads reading through one cache at once.
+	BlockCache shared(16384, 2);
+	std::vector<int> good(ranges.size());
+	pool.ParallelFor(ranges.size(), [&](size_t i) {
+		std::vector<char> out(ranges[i].second + 1);
+		good[i] = tables.Read(ranges[i].first, ranges[i].second, out.data(), shared) &&
+			memcmp(out.data(), expected + ranges[i].first, ranges[i].second) == 0;
+	}, 1);
+	for (int ok : good) {
+		CHECK(ok);
+	}
+	CHECK(shared.GetStats().bytes <= 16384);
+}
+
+};
+
+int main() {
+	CheckEviction();
+	CheckOversized();
+	CheckShards();
+	ThreadPool pool(4);
+	CheckBundleReads(pool);
+	remove(Path);
+	return test::Result();
+}
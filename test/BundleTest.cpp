@@ -0,0 +1,253 @@
+// BundleTest checks the LZ4 decoder against blocks the lz4 tool wrote, and that it rejects
+// truncated, mis-offset and overlong blocks; then that BundleFile reads synthetic bundles of
+// each layout, and rejects malformed ones.
+#include "BundleFile.h"
+#include "Lz4.h"
+#include "Synthetic.h"
+#include "Test.h"
+
+using namespace unitypack;
+
+namespace {
+
+const char *const Path = "unitypack-test-bundle.unity3d";
+
+template <size_t N>
+std::string Bytes(const char (&text)[N]) {
+	return std::string(text, N - 1);
+}
+
+std::string Noise(size_t size) {
+	std::string bytes;
+	uint32_t seed = 1;
+	for (size_t i = 0; i < size; i++) {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		bytes.push_back((char)(seed >> 24));
+	}
+	return bytes;
+}
+
+// Input is what the known blocks decode to: literals, a match two bytes back repeating
+// "ab", a long match 16 or more bytes back, 280 literals and a last literal run.
+std::string Input() {
+	std::string head = "UnityFS bundle blocks: ";
+	std::string text = head;
+	for (int i = 0; i < 40; i++) {
+		text += "ab";
+	}
+	return text + head + head + head + Noise(280) + head + "zzzzzzzz";
+}
+
+// The blocks `lz4 -1` and `lz4 -9` (LZ4HC) write for Input, which differ in the offset
+// of the match after the 280 literals.
+std::string Lz4Block() {
+	return Bytes("\xff\x0aUnityFS bundle blocks: ab\x02\x00;\x0fg\x00\x04\x0f\x17\x00\x1b\xff\xff\x0a") +
+		Noise(280) + Bytes("\xc4\x01\x04\x80zzzzzzzz");
+}
+
+std::string Lz4HCBlock() {
+	return Bytes("\xff\x0aUnityFS bundle blocks: ab\x02\x00;\x0fg\x00\x04\x0f\x17\x00\x1b\xff\xff\x0a") +
+		Noise(280) + Bytes("/\x01\x04\x80zzzzzzzz");
+}
+
+int Decompress(const std::string &block, std::string &out, size_t capacity) {
+	out.assign(capacity, '\0');
+	int n = Lz4Decompress(block.data(), block.size(), &out[0], capacity);
+	out.resize(n < 0 ? 0 : (size_t)n);
+	return n;
+}
+
+void CheckKnownBlocks() {
+	std::string input = Input();
+	for (const std::string &block : { Lz4Block(), Lz4HCBlock() }) {
+		std::string out;
+		CHECK(Decompress(block, out, input.size()) == (int)input.size());
+		CHECK(out == input);
+		// Room to spare does not change what is decoded.
+		CHECK(Decompress(block, out, input.size() + 100) == (int)input.size());
+		CHECK(out == input);
+	}
+}
+
+void CheckMalformedBlocks() {
+	std::string input = Input();
+	std::string block = Lz4Block();
+	std::string out;
+
+	// A block cut anywhere decodes to less, when its cut falls after a run of literals, and
+	// is rejected otherwise: here in the offset, the match length and the literal length.
+	for (size_t size = 0; size < block.size(); size++) {
+		CHECK(Decompress(block.substr(0, size), out, input.size()) < (int)input.size());
+	}
+	CHECK(Decompress(block.substr(0, 28), out, input.size()) == -1);
+	CHECK(Decompress(block.substr(0, 30), out, input.size()) == -1);
+	CHECK(Decompress(block.substr(0, 38), out, input.size()) == -1);
+	CHECK(Decompress(std::string(), out, input.size()) == -1);
+
+	// The first match follows 25 literals, at offsets 27 and 28.
+	std::string bad = block;
+	bad[27] = 0;
+	bad[28] = 0;
+	CHECK(Decompress(bad, out, input.size()) == -1);
+	bad[27] = 26;
+	CHECK(Decompress(bad, out, input.size()) == -1);
+	bad[27] = 25;
+	CHECK(Decompress(bad, out, input.size()) == (int)input.size());
+
+	// An output one byte short rejects the last literals, a shorter one a match or literals.
+	for (size_t capacity : { input.size() - 1, input.size() - 8, (size_t)100, (size_t)24, (size_t)0 }) {
+		CHECK(Decompress(block, out, capacity) == -1);
+	}
+	// Literals running past the input.
+	CHECK(Decompress(Bytes("\x50" "abc"), out, 16) == -1);
+	CHECK(Decompress(Bytes("\x30" "abc"), out, 16) == 3);
+}
+
+void CheckRoundTrip() {
+	std::string text;
+	for (int i = 0; i < 2000; i++) {
+		text += "m_Name m_GameObject m_Component " + std::to_string(i % 37) + "\n";
+	}
+	std::string inputs[] = { std::string(), "short", std::string(100000, 'x'), Noise(70000), text, Input() };
+	for (auto &input : inputs) {
+		std::vector<char> block = synthetic::Lz4Compress(input.data(), input.size());
+		std::string out;
+		CHECK(Decompress(std::string(block.begin(), block.end()), out, input.size()) == (int)input.size());
+		CHECK(out == input);
+	}
+}
+
+std::vector<synthetic::BundleNode> Nodes() {
+	synthetic::Options options;
+	options.objects = 200;
+	std::string noise = Noise(50000);
+	return {
+		synthetic::BundleNode{ "CAB-0123", synthetic::Build(options), true },
+		synthetic::BundleNode{ "CAB-0123.resS", std::vector<char>(noise.begin(), noise.end()), false },
+		synthetic::BundleNode{ "CAB-0123.resource", std::vector<char>(), false },
+		synthetic::BundleNode{ "notes.txt", std::vector<char>(3000, 'n'), false },
+	};
+}
+
+// CheckLayout writes a bundle with options and checks that reading it gives back nodes,
+// decompressed whole with and without a pool, and block by block.
+void CheckLayout(const std::vector<synthetic::BundleNode> &nodes, const synthetic::BundleOptions &options,
+	ThreadPool &pool) {
+	CHECK(synthetic::WriteBytes(Path, synthetic::BuildBundle(nodes, options)));
+	for (ThreadPool *with : { (ThreadPool *)nullptr, &pool }) {
+		BundleFile bundle;
+		CHECK(bundle.Open(Path, with));
+		CHECK(bundle.header.version == options.version);
+		CHECK(bundle.info.nodes.size() == nodes.size());
+		for (size_t i = 0; i < nodes.size() && i < bundle.info.nodes.size(); i++) {
+			auto &node = bundle.info.nodes[i];
+			const char *data = bundle.NodeData(node);
+			CHECK(node.path == nodes[i].path);
+			CHECK(((node.flags & BundleFile::NodeIsSerializedFile) != 0) == nodes[i].serializedFile);
+			CHECK(data && (size_t)node.size == nodes[i].data.size());
+			CHECK(data && memcmp(data, nodes[i].data.data(), nodes[i].data.size()) == 0);
+		}
+	}
+
+	BundleFile tables;
+	CHECK(tables.OpenTables(Path));
+	CHECK(!tables.data && tables.info.blocks.size() == tables.blockOffsets.size());
+	std::vector<char> stream;
+	for (size_t i = 0; i < tables.info.blocks.size(); i++) {
+		CHECK(tables.blockOffsets[i] == stream.size());
+		std::vector<char> block(tables.info.blocks[i].uncompressedSize);
+		CHECK(tables.ReadBlock(i, block.data()));
+		stream.insert(stream.end(), block.begin(), block.end());
+	}
+	CHECK(stream.size() == tables.dataSize);
+	for (size_t i = 0; i < nodes.size() && i < tables.info.nodes.size(); i++) {
+		auto &node = tables.info.nodes[i];
+		CHECK(node.offset + node.size <= (int64_t)stream.size());
+		CHECK(memcmp(stream.data() + node.offset, nodes[i].data.data(), nodes[i].data.size()) == 0);
+	}
+}
+
+void CheckLayouts(ThreadPool &pool) {
+	std::vector<synthetic::BundleNode> nodes = Nodes();
+	for (int version : { 6, 7 }) {
+		for (int layout = 0; layout < 16; layout++) {
+			synthetic::BundleOptions options;
+			options.version = version;
+			options.infoAtEnd = layout & 1;
+			options.padBlocks = layout & 2;
+			options.infoCompression = layout & 4 ? BundleFile::Lz4HC : BundleFile::None;
+			options.blockCompression = layout & 8 ? BundleFile::Lz4 : BundleFile::None;
+			options.alternateBlocks = layout == 8;
+			options.blockSize = 16384;
+			CheckLayout(nodes, options, pool);
+		}
+	}
+	// One block holding everything, and no blocks at all.
+	synthetic::BundleOptions one;
+	one.blockSize = 1 << 20;
+	CheckLayout(nodes, one, pool);
+	CheckLayout({}, synthetic::BundleOptions(), pool);
+}
+
+bool Opens(const std::vector<char> &bytes) {
+	BundleFile bundle;
+	return synthetic::WriteBytes(Path, bytes) && bundle.Open(Path);
+}
+
+void CheckMalformedBundles() {
+	std::vector<synthetic::BundleNode> nodes = Nodes();
+	synthetic::BundleOptions options;
+	options.blockSize = 16384;
+	std::vector<char> bytes = synthetic::BuildBundle(nodes, options);
+	CHECK(Opens(bytes));
+
+	// Cut in the header, the blocks info and the blocks.
+	for (size_t size : { (size_t)0, (size_t)7, (size_t)30, (size_t)60, (size_t)100, bytes.size() / 2, bytes.size() - 1 }) {
+		CHECK(!Opens(std::vector<char>(bytes.begin(), bytes.begin() + size)));
+	}
+
+	// The blocks info sizes and the flags end the 49 byte header.
+	const size_t flagsAt = 45;
+	auto patched = [&](size_t at, uint32_t value) {
+		std::vector<char> copy = bytes;
+		for (int i = 0; i < 4; i++) {
+			copy[at + i] = (char)(value >> (24 - 8 * i));
+		}
+		return copy;
+	};
+	CHECK(Opens(patched(flagsAt, BundleFile::Lz4HC)));
+	CHECK(!Opens(patched(flagsAt, BundleFile::Lzma)));
+	CHECK(!Opens(patched(flagsAt, BundleFile::Lz4HC | BundleFile::BlocksInfoAtTheEnd)));
+	CHECK(!Opens(patched(flagsAt - 8, 0xffffff00)));
+	CHECK(!Opens(patched(flagsAt - 4, 0x7fffffff)));
+
+	// A stored block whose sizes differ.
+	synthetic::BundleOptions stored;
+	stored.infoCompression = BundleFile::None;
+	stored.blockCompression = BundleFile::None;
+	std::vector<char> plain = synthetic::BuildBundle(nodes, stored);
+	CHECK(Opens(plain));
+	// The first block follows the header, padded to 64 bytes, the hash and the count.
+	size_t blockAt = 64 + 16 + 4;
+	plain[blockAt + 7]++;
+	CHECK(!Opens(plain));
+
+	BundleFile missing;
+	CHECK(!missing.Open("unitypack-test-bundle.missing"));
+	CHECK(!Opens(std::vector<char>(64, 'U')));
+}
+
+};
+
+int main() {
+	CheckKnownBlocks();
+	CheckMalformedBlocks();
+	CheckRoundTrip();
+	ThreadPool pool(2);
+	CheckLayouts(pool);
+	CheckMalformedBundles();
+	remove(Path);
+	return test::Result();
+}
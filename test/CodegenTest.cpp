@@ -0,0 +1,154 @@
+// CodegenTest checks the structs unitypack-codegen generates against the generic decoder.
+// The build generates Reference.h from a synthetic reference file; this test builds files
+// with the same types in both byte orders, decodes every object through RunProgram and
+// through the generated struct for its class, and compares the values they produce.
+#include "AssetFile.h"
+#include "Reference.h"
+#include "Synthetic.h"
+#include "Test.h"
+
+using namespace unitypack;
+
+namespace {
+
+// Values flattens decoded objects: every scalar, and the count of every array and string,
+// in the order they are read.  Floats are stored as the bits of their value as a double.
+struct Values {
+	std::vector<int64_t> values;
+
+	void Int(int64_t value) {
+		values.push_back(value);
+	}
+	void Float(double value) {
+		int64_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		values.push_back(bits);
+	}
+};
+
+// ProgramValues collects the values RunProgram reports.
+struct ProgramValues : DecodeVisitor, Values {
+	void Scalar(const Instruction &insn, const void *value) {
+		Value(insn, (const char *)value);
+	}
+	void ScalarArray(const Instruction &insn, const void *data, int count) {
+		Int(count);
+		for (int i = 0; i < count; i++) {
+			Value(insn, (const char *)data + (size_t)i * insn.size);
+		}
+	}
+	void String(const Instruction &insn, const char *data, int length) {
+		Int(length);
+		for (int i = 0; i < length; i++) {
+			Int(data[i]);
+		}
+	}
+	void BeginArray(const Instruction &insn, int count) {
+		Int(count);
+	}
+
+	void Value(const Instruction &insn, const char *value) {
+		switch (insn.kind) {
+		case ScalarKind::Raw:
+			// Generated structs hold unknown leaves as arrays of bytes.
+			for (int i = 0; i < insn.size; i++) {
+				Int((uint8_t)value[i]);
+			}
+			break;
+		case ScalarKind::Float:
+		case ScalarKind::Double:
+			Float(ScalarAsDouble(insn.kind, value));
+			break;
+		default:
+			Int(ScalarAsInt(insn.kind, value));
+			break;
+		}
+	}
+};
+
+// StructValues is a serializer which collects the values of a generated struct.  Array
+// sizes are scalars of their own, and it has no block path, so strings and arrays are
+// visited element by element.
+struct StructValues : serialize::SerializerBase, Values {
+	template <typename T>
+	void Scalar(T &value) {
+		if constexpr (std::is_floating_point<T>::value) {
+			Float(value);
+		} else {
+			Int((int64_t)value);
+		}
+	}
+	void Align() {}
+};
+
+// CheckStruct reads T from an object's payload with the generated code, and compares its
+// values with those the program produced.
+template <typename T, serialize::Endian E>
+void CheckStruct(const char *data, size_t size, const ProgramValues &expected) {
+	T value{};
+	serialize::MmapReaderT<E> reader{};
+	reader.SetRange(data, size);
+	serialize::struct_val(reader, value, T::type_string, "Base");
+	CHECK(!reader.IsErrored());
+	CHECK(reader.Tell() == size);
+
+	StructValues actual{};
+	serialize::struct_val(actual, value, T::type_string, "Base");
+	CHECK(actual.values == expected.values);
+}
+
+template <serialize::Endian E>
+int CheckObject(int classID, const char *data, size_t size, const ProgramValues &expected) {
+	switch (classID) {
+	case synthetic::GameObject:
+		CheckStruct<reference::GameObject, E>(data, size, expected);
+		break;
+	case synthetic::Transform:
+		CheckStruct<reference::Transform, E>(data, size, expected);
+		break;
+	case synthetic::Texture2D:
+		CheckStruct<reference::Texture2D, E>(data, size, expected);
+		break;
+	case synthetic::Mesh:
+		CheckStruct<reference::Mesh, E>(data, size, expected);
+		break;
+	case synthetic::MonoBehaviour:
+		CheckStruct<reference::MonoBehaviour, E>(data, size, expected);
+		break;
+	default:
+		return 0;
+	}
+	return 1;
+}
+
+void CheckFile(bool bigEndian) {
+	synthetic::Options options;
+	options.bigEndian = bigEndian;
+	options.seed = bigEndian ? 7 : 3;
+	std::vector<char> bytes = synthetic::Build(options);
+	AssetFile asset;
+	CHECK(asset.OpenMemory(bytes.data(), bytes.size()));
+
+	int checked = 0;
+	for (auto &object : asset.file.metadata.objects) {
+		const char *data = asset.ObjectData(object);
+		ProgramValues expected;
+		CHECK(data && asset.decoder->Decode(object, data, expected));
+		if (!data) {
+			continue;
+		}
+		int classID = asset.file.ClassID(object);
+		checked += bigEndian
+			? CheckObject<serialize::Endian::Big>(classID, data, (size_t)object.dataSize, expected)
+			: CheckObject<serialize::Endian::Little>(classID, data, (size_t)object.dataSize, expected);
+	}
+	CHECK(checked == options.objects);
+}
+
+};
+
+int main() {
+	CheckFile(false);
+	CheckFile(true);
+	return test::Result();
+}
@@ -0,0 +1,118 @@
+// DecoderTest checks that RunProgram bounds array counts by the bytes left, so that a
+// corrupt count cannot make it loop, and that big-endian scalar arrays reach the visitor
+// swapped, call after call.
+#include "ObjectDecoder.h"
+#include "Test.h"
+
+using namespace unitypack;
+
+namespace {
+
+void AddNode(TypeTree &tree, int depth, const char *type, const char *name, int byteSize, bool isArray = false) {
+	TypeTreeNode node{};
+	node.depth = (uint8_t)depth;
+	node.isArray = isArray;
+	node.type = tree.GetIndex(type);
+	node.name = tree.GetIndex(name);
+	node.byteSize = byteSize;
+	node.index = (int)tree.nodes.size();
+	tree.nodes.push_back(node);
+}
+
+// ArrayTree is a Base holding one array of element, whose fields are ints.
+TypeTree ArrayTree(const char *element, int fields) {
+	TypeTree tree;
+	AddNode(tree, 0, "Base", "Base", -1);
+	AddNode(tree, 1, "Array", "items", -1, true);
+	AddNode(tree, 2, "int", "size", 4);
+	AddNode(tree, 2, element, "data", -1);
+	for (int i = 0; i < fields; i++) {
+		AddNode(tree, 3, "int", i ? "b" : "a", 4);
+	}
+	return tree;
+}
+
+std::vector<char> Ints(std::initializer_list<int> values, bool bigEndian = false) {
+	std::vector<char> bytes;
+	for (int value : values) {
+		if (bigEndian) {
+			serialize::ByteSwap<int>(&value);
+		}
+		const char *p = (const char *)&value;
+		bytes.insert(bytes.end(), p, p + 4);
+	}
+	return bytes;
+}
+
+struct CountVisitor : DecodeVisitor {
+	int64_t structs = 0;
+	int count = -1;
+	std::vector<int> values;
+
+	void BeginStruct(const Instruction &insn) {
+		structs++;
+	}
+	void BeginArray(const Instruction &insn, int n) {
+		count = n;
+	}
+	void ScalarArray(const Instruction &insn, const void *data, int n) {
+		count = n;
+		for (int i = 0; i < n; i++) {
+			int value;
+			memcpy(&value, (const char *)data + (size_t)i * 4, 4);
+			values.push_back(value);
+		}
+	}
+};
+
+bool Run(const DecodeProgram &program, const std::vector<char> &bytes, CountVisitor &visitor,
+	bool bigEndian = false) {
+	return RunProgram(program, bytes.data(), bytes.size(), bigEndian, visitor);
+}
+
+void CheckEmptyElements() {
+	TypeTree tree = ArrayTree("Empty", 0);
+	DecodeProgram program = CompileTypeTree(tree);
+	CountVisitor small;
+	CHECK(Run(program, Ints({ 10 }), small));
+	CHECK(small.count == 10 && small.structs == 11);
+	CountVisitor huge;
+	CHECK(!Run(program, Ints({ 0x7fffffff }), huge));
+	CHECK(huge.structs == 1);
+}
+
+void CheckSizedElements() {
+	TypeTree tree = ArrayTree("Pair", 2);
+	DecodeProgram program = CompileTypeTree(tree);
+	CountVisitor fits;
+	CHECK(Run(program, Ints({ 2, 1, 2, 3, 4 }), fits));
+	CHECK(fits.count == 2 && fits.structs == 3);
+	CountVisitor corrupt;
+	CHECK(!Run(program, Ints({ 1000, 1, 2, 3, 4 }), corrupt));
+	CHECK(corrupt.count == -1);
+	CountVisitor truncated;
+	CHECK(!Run(program, Ints({ 3, 1, 2, 3, 4 }), truncated));
+}
+
+void CheckBigEndianArrays() {
+	TypeTree tree;
+	AddNode(tree, 0, "Base", "Base", -1);
+	AddNode(tree, 1, "Array", "values", -1, true);
+	AddNode(tree, 2, "int", "size", 4);
+	AddNode(tree, 2, "int", "data", 4);
+	DecodeProgram program = CompileTypeTree(tree);
+	for (int run = 0; run < 2; run++) {
+		CountVisitor visitor;
+		CHECK(Run(program, Ints({ 3, 7, -1, 0x12345678 + run }, true), visitor, true));
+		CHECK(visitor.values == std::vector<int>({ 7, -1, 0x12345678 + run }));
+	}
+}
+
+};
+
+int main() {
+	CheckEmptyElements();
+	CheckSizedElements();
+	CheckBigEndianArrays();
+	return test::Result();
+}
@@ -0,0 +1,277 @@
+// DependencyGraphTest loads a small corpus of synthetic files, one inside a bundle, whose
+// PPtrs link them together, and checks every resolved edge and the reachable set against
+// the links the files were written with.  Reachable runs with its frontier expanded on the
+// calling thread and on the pool, on the corpus and on a larger random graph.
+#include "DependencyGraph.h"
+#include "Synthetic.h"
+#include "Test.h"
+#include <filesystem>
+#include <set>
+
+using namespace unitypack;
+namespace fs = std::filesystem;
+
+namespace {
+
+const char *const Dir = "unitypack-test-graph.d";
+
+struct Random {
+	uint32_t state;
+
+	uint32_t Below(uint32_t n) {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state % n;
+	}
+};
+
+using Adjacency = std::vector<std::set<uint32_t>>;
+
+// Levels returns the breadth-first distance of every node from roots, or -1.
+std::vector<int> Levels(const Adjacency &graph, const std::vector<uint32_t> &roots) {
+	std::vector<int> level(graph.size(), -1);
+	std::vector<uint32_t> frontier;
+	for (uint32_t root : roots) {
+		if (root < graph.size() && level[root] < 0) {
+			level[root] = 0;
+			frontier.push_back(root);
+		}
+	}
+	for (int depth = 1; !frontier.empty(); depth++) {
+		std::vector<uint32_t> next;
+		for (uint32_t node : frontier) {
+			for (uint32_t target : graph[node]) {
+				if (level[target] < 0) {
+					level[target] = depth;
+					next.push_back(target);
+				}
+			}
+		}
+		frontier.swap(next);
+	}
+	return level;
+}
+
+Csr ToCsr(const Adjacency &graph) {
+	Csr csr;
+	csr.offsets.push_back(0);
+	for (auto &edges : graph) {
+		csr.targets.insert(csr.targets.end(), edges.begin(), edges.end());
+		csr.offsets.push_back(csr.targets.size());
+	}
+	return csr;
+}
+
+// CheckReachable runs Reachable with frontiers expanded serially, always on the pool and
+// from the default size, and checks that each returns the reachable nodes exactly once,
+// level by level.
+void CheckReachable(const Csr &csr, const Adjacency &graph, const std::vector<uint32_t> &roots, ThreadPool &pool) {
+	std::vector<int> level = Levels(graph, roots);
+	size_t expected = 0;
+	for (int l : level) {
+		expected += l >= 0;
+	}
+	for (size_t parallelFrontier : { (size_t)SIZE_MAX, (size_t)1, DefaultParallelFrontier }) {
+		std::vector<uint32_t> reached = Reachable(csr, roots, pool, parallelFrontier);
+		CHECK(reached.size() == expected);
+		std::vector<bool> seen(graph.size());
+		int last = 0;
+		bool ordered = true;
+		for (uint32_t node : reached) {
+			CHECK(node < graph.size() && !seen[node] && level[node] >= 0);
+			if (node < graph.size()) {
+				seen[node] = true;
+				ordered = ordered && level[node] >= last;
+				last = level[node];
+			}
+		}
+		CHECK(ordered);
+	}
+}
+
+void CheckRandomGraph(ThreadPool &pool) {
+	// Enough nodes for frontiers of many chunks, with hubs so that levels grow quickly.
+	const uint32_t count = 60000;
+	Random random{ 5 };
+	Adjacency graph(count);
+	for (uint32_t node = 0; node < count; node++) {
+		int degree = node % 97 == 0 ? 200 : (int)random.Below(4);
+		for (int i = 0; i < degree; i++) {
+			graph[node].insert(random.Below(count));
+		}
+	}
+	Csr csr = ToCsr(graph);
+	CheckReachable(csr, graph, { 0 }, pool);
+	CheckReachable(csr, graph, { 97, 3, 3, count + 10 }, pool);
+	CheckReachable(csr, graph, {}, pool);
+	CHECK(Reachable(Csr(), { 0 }, pool).empty());
+}
+
+// Written is one file of the corpus as the test wrote it: where its externals lead and the
+// PPtrs of each of its objects.
+struct Written {
+	const char *name;
+	int objects;
+	// The Written file each fileID refers to, or -1; fileID 0 is the file itself.
+	std::vector<int> targets;
+	std::vector<std::vector<std::pair<int, int64_t>>> refs;
+};
+
+// Links returns a link function for file, which picks mostly resolvable PPtrs among the
+// corpus and records them, with some null, dangling and out of range ones.
+std::function<void(int, int &, int64_t &)> Links(std::vector<Written> &corpus, int file, uint32_t seed) {
+	return [&corpus, file, random = Random{ seed }](int object, int &fileID, int64_t &pathID) mutable {
+		Written &written = corpus[file];
+		int kind = (int)random.Below(10);
+		if (kind == 0) {
+			fileID = 0;
+			pathID = 0;
+		} else if (kind == 1) {
+			fileID = 0;
+			pathID = written.objects + 100;
+		} else if (kind == 2) {
+			fileID = (int)written.targets.size() + 1;
+			pathID = 1;
+		} else {
+			fileID = (int)random.Below((uint32_t)written.targets.size());
+			int target = written.targets[fileID];
+			pathID = 1 + random.Below(target < 0 ? 10 : corpus[target].objects);
+		}
+		written.refs[object].push_back({ fileID, pathID });
+	};
+}
+
+void CheckCorpus(ThreadPool &pool) {
+	// level0 and CAB-0123 refer to the default resources and CAB-0123, the default
+	// resources to themselves and CAB-0123, and orphan to a file outside the corpus.
+	std::vector<Written> corpus = {
+		{ "level0", 60, { 0, 1, 2 }, {} },
+		{ "unity default resources", 40, { 1, 1, 2 }, {} },
+		{ "CAB-0123", 50, { 2, 1, 2 }, {} },
+		{ "orphan.assets", 30, { 3, -1 }, {} },
+	};
+	const int versions[] = { 17, 15, 21, 9 };
+	std::vector<std::vector<char>> bytes;
+	for (int f = 0; f < (int)corpus.size(); f++) {
+		corpus[f].refs.resize(corpus[f].objects);
+		synthetic::Options options;
+		options.version = versions[f];
+		options.objects = corpus[f].objects;
+		options.seed = 10 + f;
+		options.densePathIDs = true;
+		options.link = Links(corpus, f, 100 + f);
+		if (f == 3) {
+			options.externals = { "Assets/Missing.assets" };
+		}
+		bytes.push_back(synthetic::Build(options));
+	}
+	std::string resource(5000, 'r');
+	std::vector<synthetic::BundleNode> nodes = {
+		synthetic::BundleNode{ "CAB-0123", bytes[2], true },
+		synthetic::BundleNode{ "CAB-0123.resS", std::vector<char>(resource.begin(), resource.end()), false },
+	};
+	std::string dir = std::string(Dir) + "/";
+	CHECK(synthetic::WriteBytes((dir + "level0").c_str(), bytes[0]));
+	CHECK(synthetic::WriteBytes((dir + "unity default resources").c_str(), bytes[1]));
+	CHECK(synthetic::WriteBytes((dir + "scene.bundle").c_str(), synthetic::BuildBundle(nodes, synthetic::BundleOptions())));
+	CHECK(synthetic::WriteBytes((dir + "orphan.assets").c_str(), bytes[3]));
+
+	DependencyGraph graph;
+	CHECK(graph.Load({ dir + "orphan.assets", dir + "scene.bundle", dir + "absent.assets", dir + "level0",
+		dir + "unity default resources" }, pool));
+	CHECK(graph.stats.files == 4 && graph.stats.failed == 1);
+	CHECK(graph.stats.objects == 180 && graph.stats.undecoded == 0);
+	CHECK(graph.files[graph.FindFile("archive:/CAB-0123/CAB-0123")].name == dir + "scene.bundle:CAB-0123");
+
+	// The edges each object should have, numbered as the graph numbers objects.
+	std::vector<int> fileOf(corpus.size());
+	for (size_t f = 0; f < corpus.size(); f++) {
+		fileOf[f] = graph.FindFile(corpus[f].name);
+		CHECK(fileOf[f] >= 0);
+	}
+	if (test::Failures()) {
+		return;
+	}
+	Adjacency expected(graph.stats.objects);
+	size_t references = 0;
+	size_t resolved = 0;
+	for (size_t f = 0; f < corpus.size(); f++) {
+		for (int o = 0; o < corpus[f].objects; o++) {
+			int64_t node = graph.FindObject(fileOf[f], (uint64_t)o + 1);
+			CHECK(node >= 0 && graph.FileOf((uint32_t)node) == fileOf[f]);
+			if (node < 0) {
+				continue;
+			}
+			for (auto &ref : corpus[f].refs[o]) {
+				if (ref.second == 0) {
+					continue;
+				}
+				references++;
+				if (ref.first >= (int)corpus[f].targets.size() || corpus[f].targets[ref.first] < 0) {
+					continue;
+				}
+				const Written &target = corpus[corpus[f].targets[ref.first]];
+				if (ref.second > target.objects) {
+					continue;
+				}
+				resolved++;
+				int64_t to = graph.FindObject(fileOf[corpus[f].targets[ref.first]], (uint64_t)ref.second);
+				CHECK(to >= 0);
+				if (to >= 0) {
+					expected[node].insert((uint32_t)to);
+				}
+			}
+		}
+	}
+	CHECK(graph.stats.references == references && graph.stats.resolved == resolved);
+	CHECK(references > resolved && resolved > 100);
+	size_t edges = 0;
+	for (uint32_t node = 0; node < expected.size(); node++) {
+		std::vector<uint32_t> got(graph.objects.begin(node), graph.objects.end(node));
+		CHECK(got == std::vector<uint32_t>(expected[node].begin(), expected[node].end()));
+		edges += expected[node].size();
+	}
+	CHECK(graph.stats.edges == edges);
+
+	// The file graph leaves out self references and files outside the corpus.
+	auto fileEdges = [&](int f) {
+		std::vector<uint32_t> edges(graph.fileGraph.begin(fileOf[f]), graph.fileGraph.end(fileOf[f]));
+		std::sort(edges.begin(), edges.end());
+		return edges;
+	};
+	std::vector<uint32_t> both = { (uint32_t)fileOf[1], (uint32_t)fileOf[2] };
+	std::sort(both.begin(), both.end());
+	CHECK(fileEdges(0) == both);
+	CHECK(fileEdges(1) == std::vector<uint32_t>({ (uint32_t)fileOf[2] }));
+	CHECK(fileEdges(2) == std::vector<uint32_t>({ (uint32_t)fileOf[1] }));
+	CHECK(fileEdges(3).empty());
+
+	// Nothing leads into level0 or orphan, so their objects are reached only as roots.
+	for (int root : { 0, 3 }) {
+		std::vector<uint32_t> roots;
+		for (uint32_t o = graph.objectBase[fileOf[root]]; o < graph.objectBase[fileOf[root] + 1]; o++) {
+			roots.push_back(o);
+		}
+		CheckReachable(graph.objects, expected, roots, pool);
+		std::vector<uint32_t> reached = Reachable(graph.objects, roots, pool);
+		for (uint32_t node : reached) {
+			int f = graph.FileOf(node);
+			CHECK(f == fileOf[root] || (f != fileOf[0] && f != fileOf[3]));
+		}
+	}
+	CheckReachable(graph.objects, expected, { (uint32_t)graph.FindObject(fileOf[2], 1) }, pool);
+}
+
+};
+
+int main() {
+	std::error_code error;
+	fs::remove_all(Dir, error);
+	fs::create_directories(Dir);
+	ThreadPool pool(4);
+	CheckRandomGraph(pool);
+	CheckCorpus(pool);
+	fs::remove_all(Dir, error);
+	return test::Result();
+}
@@ -0,0 +1,53 @@
+// JsonTest checks how JsonWriter quotes strings: escapes, well-formed UTF-8, which is
+// copied, and bytes outside it, which are written as \u00XX so that the output stays JSON.
+#include "JsonWriter.h"
+#include "Test.h"
+
+using namespace unitypack;
+
+namespace {
+
+std::string Quote(const std::string &text) {
+	JsonWriter out;
+	out.String(text.data(), text.size());
+	return std::string(out.data(), out.size());
+}
+
+void CheckEscapes() {
+	CHECK(Quote("plain") == "\"plain\"");
+	CHECK(Quote("a\"b\\c") == "\"a\\\"b\\\\c\"");
+	CHECK(Quote("\n\t\x01") == "\"\\n\\t\\u0001\"");
+	CHECK(Quote(std::string("a\0b", 3)) == "\"a\\u0000b\"");
+}
+
+void CheckUtf8() {
+	// Two, three and four byte sequences, at the bounds of their ranges.
+	const char *valid[] = {
+		"\xc2\x80", "\xdf\xbf", "\xe0\xa0\x80", "\xe2\x82\xac", "\xed\x9f\xbf", "\xee\x80\x80",
+		"\xef\xbf\xbf", "\xf0\x90\x80\x80", "\xf4\x8f\xbf\xbf", "caf\xc3\xa9",
+	};
+	for (const char *text : valid) {
+		CHECK(Quote(text) == "\"" + std::string(text) + "\"");
+	}
+
+	// A lone continuation byte, overlong forms, a surrogate, a code point past U+10FFFF, a
+	// byte which is never UTF-8, and sequences cut short by another byte or by the end.
+	CHECK(Quote("\x80") == "\"\\u0080\"");
+	CHECK(Quote("\xc0\xaf") == "\"\\u00c0\\u00af\"");
+	CHECK(Quote("\xe0\x9f\xbf") == "\"\\u00e0\\u009f\\u00bf\"");
+	CHECK(Quote("\xed\xa0\x80") == "\"\\u00ed\\u00a0\\u0080\"");
+	CHECK(Quote("\xf4\x90\x80\x80") == "\"\\u00f4\\u0090\\u0080\\u0080\"");
+	CHECK(Quote("\xff") == "\"\\u00ff\"");
+	CHECK(Quote("\xc3x") == "\"\\u00c3x\"");
+	CHECK(Quote("ok\xe2\x82") == "\"ok\\u00e2\\u0082\"");
+	// A bad byte does not swallow the valid sequence after it.
+	CHECK(Quote("\xe2\xc3\xa9") == "\"\\u00e2\xc3\xa9\"");
+}
+
+};
+
+int main() {
+	CheckEscapes();
+	CheckUtf8();
+	return test::Result();
+}
@@ -0,0 +1,290 @@
+// MetadataIndexTest builds an index of synthetic files, changes some of them and checks that
+// an incremental rebuild reuses, rehashes, reparses and removes the right entries, and ends
+// up holding what a fresh build does; then that truncated or corrupt indexes do not open.
+#include "MetadataIndex.h"
+#include "Synthetic.h"
+#include "Test.h"
+#include <filesystem>
+
+using namespace unitypack;
+namespace fs = std::filesystem;
+
+namespace {
+
+const char *const Dir = "unitypack-test-index.d";
+
+std::string PathOf(const char *name) {
+	return std::string(Dir) + "/" + name;
+}
+
+bool Write(const char *name, int version, uint32_t seed, bool bigEndian = false) {
+	synthetic::Options options;
+	options.version = version;
+	options.objects = 100 + (int)seed;
+	options.seed = seed;
+	options.bigEndian = bigEndian;
+	return synthetic::WriteFile(PathOf(name).c_str(), options);
+}
+
+// SetTime gives name an mtime of seconds past a fixed point, so that changes are seen
+// however coarse the filesystem's clock is.
+void SetTime(const char *name, int seconds) {
+	std::error_code error;
+	fs::last_write_time(PathOf(name), fs::file_time_type(std::chrono::seconds(1700000000 + seconds)), error);
+	CHECK(!error);
+}
+
+std::vector<char> ReadAll(const std::string &path) {
+	std::vector<char> bytes;
+	FILE *fp = fopen(path.c_str(), "rb");
+	if (!fp) {
+		return bytes;
+	}
+	char buffer[4096];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+		bytes.insert(bytes.end(), buffer, buffer + n);
+	}
+	fclose(fp);
+	return bytes;
+}
+
+// CheckEntries compares the rows of every readable file in index with the file parsed
+// directly.
+void CheckEntries(const MetadataIndex &index) {
+	for (size_t i = 0; i < index.FileCount(); i++) {
+		const MetadataIndex::File &entry = index.files[i];
+		std::string path = index.GetString(entry.path);
+		CHECK(index.Find(path) == &entry);
+		std::vector<char> bytes = ReadAll(path);
+		CHECK(entry.size == bytes.size());
+		SerializedFile file{};
+		serialize::MmapReaderT<serialize::Endian::Big> rd{};
+		rd.SetRange(bytes.data(), bytes.size());
+		bool ok = file.Read(rd);
+		CHECK(ok == (entry.result == (int32_t)CorpusScanner::Result::Ok));
+		if (!ok) {
+			CHECK(entry.objectCount == 0 && entry.typeCount == 0 && entry.externalCount == 0);
+			continue;
+		}
+		auto &objects = file.metadata.objects;
+		CHECK(entry.version == file.header.version && entry.bigEndian == file.header.bigEndian);
+		CHECK(index.GetString(entry.generatorVersion) == std::string(file.metadata.generatorVersion));
+		CHECK(entry.objectCount == objects.size());
+		for (size_t j = 0; j < objects.size() && j < entry.objectCount; j++) {
+			uint64_t row = entry.firstObject + j;
+			CHECK(index.objects.objectID[row] == objects[j].objectID);
+			CHECK(index.objects.dataOffset[row] == objects[j].dataOffset);
+			CHECK(index.objects.dataSize[row] == objects[j].dataSize);
+			CHECK(index.objects.classID[row] == file.ClassID(objects[j]));
+			CHECK(index.objects.typeIndex[row] == file.TypeIndex(objects[j]));
+		}
+		CHECK(entry.typeCount == file.metadata.types.size());
+		CHECK(entry.externalCount == file.metadata.externalFiles.size());
+		for (size_t j = 0; j < file.metadata.externalFiles.size() && j < entry.externalCount; j++) {
+			const MetadataIndex::External &external = index.externals[entry.firstExternal + j];
+			CHECK(index.GetString(external.fileName) == std::string(file.metadata.externalFiles[j].fileName));
+		}
+	}
+}
+
+bool SameString(const MetadataIndex &a, const MetadataIndex::String &sa, const MetadataIndex &b,
+	const MetadataIndex::String &sb) {
+	return a.GetString(sa) == b.GetString(sb);
+}
+
+// Same reports whether a and b index the same files identically, wherever their rows and
+// strings happen to lie.
+bool Same(const MetadataIndex &a, const MetadataIndex &b) {
+	if (a.FileCount() != b.FileCount()) {
+		return false;
+	}
+	for (size_t i = 0; i < a.FileCount(); i++) {
+		const MetadataIndex::File &fa = a.files[i];
+		const MetadataIndex::File &fb = b.files[i];
+		if (!SameString(a, fa.path, b, fb.path) || !SameString(a, fa.generatorVersion, b, fb.generatorVersion) ||
+			fa.size != fb.size || fa.mtime != fb.mtime || fa.contentHash != fb.contentHash ||
+			fa.result != fb.result || fa.platform != fb.platform || fa.metadataSize != fb.metadataSize ||
+			fa.fileSize != fb.fileSize || fa.version != fb.version || fa.objectDataOffset != fb.objectDataOffset ||
+			fa.bigEndian != fb.bigEndian || fa.objectCount != fb.objectCount || fa.typeCount != fb.typeCount ||
+			fa.externalCount != fb.externalCount) {
+			return false;
+		}
+		for (uint32_t j = 0; j < fa.objectCount; j++) {
+			uint64_t ra = fa.firstObject + j;
+			uint64_t rb = fb.firstObject + j;
+			if (a.objects.objectID[ra] != b.objects.objectID[rb] || a.objects.dataOffset[ra] != b.objects.dataOffset[rb] ||
+				a.objects.dataSize[ra] != b.objects.dataSize[rb] || a.objects.classID[ra] != b.objects.classID[rb] ||
+				a.objects.typeIndex[ra] != b.objects.typeIndex[rb]) {
+				return false;
+			}
+		}
+		if (fa.typeCount && memcmp(a.types + fa.firstType, b.types + fb.firstType,
+				fa.typeCount * sizeof(MetadataIndex::Type)) != 0) {
+			return false;
+		}
+		for (uint32_t j = 0; j < fa.externalCount; j++) {
+			const MetadataIndex::External &ea = a.externals[fa.firstExternal + j];
+			const MetadataIndex::External &eb = b.externals[fb.firstExternal + j];
+			if (memcmp(&ea.guid, &eb.guid, sizeof(Hash)) != 0 || ea.type != eb.type ||
+				!SameString(a, ea.assetName, b, eb.assetName) || !SameString(a, ea.fileName, b, eb.fileName)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool BuildAndSave(const std::vector<std::string> &paths, const MetadataIndex *previous, ThreadPool &pool,
+	const std::string &path, MetadataIndex::BuildStats &stats) {
+	std::vector<char> image;
+	stats = MetadataIndex::Build(paths, previous, pool, image);
+	return !image.empty() && MetadataIndex::Save(path.c_str(), image);
+}
+
+void CheckIncremental(ThreadPool &pool) {
+	CHECK(Write("a.assets", 17, 1));
+	CHECK(Write("b.assets", 9, 2));
+	CHECK(Write("c.assets", 21, 3, true));
+	CHECK(Write("d.assets", 15, 4));
+	// A file without a plausible header, which is Skipped, and one whose metadata is
+	// corrupt, which Failed.
+	CHECK(synthetic::WriteBytes(PathOf("junk.txt").c_str(), std::vector<char>(100, 'j')));
+	synthetic::Options options;
+	std::vector<char> broken = synthetic::Build(options);
+	memset(broken.data() + 40, 0xff, 200);
+	CHECK(synthetic::WriteBytes(PathOf("broken.assets").c_str(), broken));
+	const char *names[] = { "a.assets", "b.assets", "c.assets", "d.assets", "junk.txt", "broken.assets" };
+	for (int i = 0; i < 6; i++) {
+		SetTime(names[i], i);
+	}
+	std::vector<std::string> paths;
+	for (const char *name : { "c.assets", "a.assets", "missing.assets", "junk.txt", "b.assets", "d.assets",
+			"broken.assets", "a.assets" }) {
+		paths.push_back(PathOf(name));
+	}
+
+	// A first build reads every file which exists, once.
+	const std::string indexPath = PathOf("corpus.index");
+	MetadataIndex::BuildStats stats;
+	CHECK(BuildAndSave(paths, nullptr, pool, indexPath, stats));
+	CHECK(stats.parsed == 6 && stats.reused == 0 && stats.rehashed == 0 && stats.removed == 0);
+	MetadataIndex index;
+	CHECK(index.Open(indexPath.c_str()));
+	CHECK(index.FileCount() == 6 && !index.Find(PathOf("missing.assets")));
+	CheckEntries(index);
+	CHECK(index.Find(PathOf("junk.txt"))->result == (int32_t)CorpusScanner::Result::Skipped);
+	CHECK(index.Find(PathOf("broken.assets"))->result == (int32_t)CorpusScanner::Result::Failed);
+
+	// Nothing changed, so no image is built.
+	std::vector<char> image;
+	stats = MetadataIndex::Build(paths, &index, pool, image);
+	CHECK(image.empty() && stats.reused == 6 && stats.parsed == 0);
+
+	// a is touched, b rewritten, d deleted and e added.
+	SetTime("a.assets", 100);
+	CHECK(Write("b.assets", 9, 20));
+	SetTime("b.assets", 101);
+	fs::remove(PathOf("d.assets"));
+	CHECK(Write("e.assets", 19, 5));
+	SetTime("e.assets", 102);
+	paths.push_back(PathOf("e.assets"));
+	const std::string rebuiltPath = PathOf("rebuilt.index");
+	CHECK(BuildAndSave(paths, &index, pool, rebuiltPath, stats));
+	CHECK(stats.reused == 3 && stats.rehashed == 1 && stats.parsed == 2 && stats.removed == 1);
+	MetadataIndex rebuilt;
+	CHECK(rebuilt.Open(rebuiltPath.c_str()));
+	CHECK(rebuilt.FileCount() == 6 && !rebuilt.Find(PathOf("d.assets")));
+	CHECK(rebuilt.Find(PathOf("a.assets"))->mtime != index.Find(PathOf("a.assets"))->mtime);
+	CheckEntries(rebuilt);
+
+	const std::string freshPath = PathOf("fresh.index");
+	CHECK(BuildAndSave(paths, nullptr, pool, freshPath, stats));
+	CHECK(stats.parsed == 6);
+	MetadataIndex fresh;
+	CHECK(fresh.Open(freshPath.c_str()));
+	CHECK(Same(rebuilt, fresh));
+	CHECK(!Same(index, fresh));
+
+	// The rebuilt index is current in turn.
+	stats = MetadataIndex::Build(paths, &rebuilt, pool, image);
+	CHECK(image.empty() && stats.reused == 6);
+}
+
+bool Opens(const std::vector<char> &image) {
+	std::string path = PathOf("bad.index");
+	MetadataIndex index;
+	return synthetic::WriteBytes(path.c_str(), image) && index.Open(path.c_str());
+}
+
+void CheckCorrupt(ThreadPool &pool) {
+	std::vector<std::string> paths = { PathOf("a.assets"), PathOf("c.assets"), PathOf("e.assets") };
+	std::vector<char> image;
+	MetadataIndex::Build(paths, nullptr, pool, image);
+	CHECK(Opens(image));
+	MetadataIndex good;
+	CHECK(good.Open(PathOf("bad.index").c_str()));
+	const char *base = (const char *)good.header;
+	size_t filesAt = (const char *)good.files - base;
+	size_t externalsAt = (const char *)good.externals - base;
+	CHECK(good.header->externalCount > 0);
+
+	for (size_t size : { (size_t)0, (size_t)4, sizeof(MetadataIndex::Header) - 1, sizeof(MetadataIndex::Header),
+			filesAt + 10, image.size() / 2, image.size() - 1 }) {
+		CHECK(!Opens(std::vector<char>(image.begin(), image.begin() + size)));
+	}
+	std::vector<char> longer = image;
+	longer.push_back(0);
+	CHECK(!Opens(longer));
+
+	// Each patch writes value over the field at offset.
+	auto patched = [&](size_t offset, auto value) {
+		std::vector<char> copy = image;
+		memcpy(copy.data() + offset, &value, sizeof(value));
+		return copy;
+	};
+	using Header = MetadataIndex::Header;
+	using File = MetadataIndex::File;
+	using External = MetadataIndex::External;
+	CHECK(!Opens(patched(offsetof(Header, magic), 'X')));
+	CHECK(!Opens(patched(offsetof(Header, formatVersion), MetadataIndex::FormatVersion + 1)));
+	CHECK(!Opens(patched(offsetof(Header, byteOrder), (uint32_t)0x04030201)));
+	CHECK(!Opens(patched(offsetof(Header, fileCount), good.header->fileCount + 1)));
+	CHECK(!Opens(patched(offsetof(Header, objectCount), (uint64_t)1 << 60)));
+	CHECK(!Opens(patched(offsetof(Header, stringsSize), good.header->stringsSize - 1)));
+	CHECK(!Opens(patched(offsetof(Header, imageSize), (uint64_t)image.size() + 8)));
+	CHECK(!Opens(patched(filesAt + offsetof(File, firstObject), good.header->objectCount)));
+	CHECK(!Opens(patched(filesAt + offsetof(File, objectCount), (uint32_t)good.header->objectCount + 1)));
+	CHECK(!Opens(patched(filesAt + offsetof(File, firstExternal), (uint64_t)-1)));
+	CHECK(!Opens(patched(filesAt + offsetof(File, path) + offsetof(MetadataIndex::String, offset),
+		(uint32_t)good.header->stringsSize)));
+	CHECK(!Opens(patched(externalsAt + offsetof(External, fileName) + offsetof(MetadataIndex::String, length),
+		(uint32_t)-1)));
+
+	// Garbage, and garbage behind a valid header.
+	std::vector<char> garbage(image.size());
+	uint32_t seed = 9;
+	for (char &byte : garbage) {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		byte = (char)(seed >> 24);
+	}
+	CHECK(!Opens(garbage));
+	memcpy(garbage.data(), image.data(), sizeof(Header));
+	CHECK(!Opens(garbage));
+	CHECK(!MetadataIndex().Open(PathOf("missing.index").c_str()));
+}
+
+};
+
+int main() {
+	std::error_code error;
+	fs::remove_all(Dir, error);
+	fs::create_directories(Dir);
+	ThreadPool pool(2);
+	CheckIncremental(pool);
+	CheckCorrupt(pool);
+	fs::remove_all(Dir, error);
+	return test::Result();
+}
@@ -0,0 +1,206 @@
+// ObjectQueryTest checks PlanName on the synthetic types, GameObject having a vector before
+// its m_Name and MonoBehaviour only fixed-size fields, and then that class, name and prefix
+// queries select what decoding every object whole does, from files and from bundles.
+#include "ObjectQuery.h"
+#include "Synthetic.h"
+#include "Test.h"
+#include <algorithm>
+
+using namespace unitypack;
+
+namespace {
+
+const char *const Path = "unitypack-test-query.assets";
+const char *const BundlePath = "unitypack-test-query.unity3d";
+
+// NameVisitor keeps the top-level m_Name of an object.
+struct NameVisitor : DecodeVisitor {
+	int depth = 0;
+	bool found = false;
+	std::string name;
+
+	void BeginStruct(const Instruction &insn) {
+		depth++;
+	}
+	void EndStruct(const Instruction &insn) {
+		depth--;
+	}
+	void String(const Instruction &insn, const char *data, int size) {
+		if (depth == 1 && strcmp(insn.name, "m_Name") == 0) {
+			found = true;
+			name.assign(data, (size_t)size);
+		}
+	}
+};
+
+// Decoded is what decoding each object whole gives: its class and, if it has one, m_Name.
+struct Decoded {
+	int classID;
+	bool hasName;
+	std::string name;
+};
+
+std::vector<Decoded> DecodeAll(AssetFile &asset) {
+	std::vector<Decoded> decoded;
+	for (auto &object : asset.file.metadata.objects) {
+		NameVisitor visitor;
+		const char *data = asset.ObjectData(object);
+		CHECK(data && asset.decoder->Decode(object, data, visitor));
+		decoded.push_back(Decoded{ asset.file.ClassID(object), visitor.found, visitor.name });
+	}
+	return decoded;
+}
+
+// Expected selects from decoded as query should.
+std::vector<uint32_t> Expected(const std::vector<Decoded> &decoded, const ObjectQuery &query) {
+	std::vector<uint32_t> selected;
+	for (uint32_t i = 0; i < decoded.size(); i++) {
+		const Decoded &d = decoded[i];
+		if (!query.classIDs.empty() &&
+			std::find(query.classIDs.begin(), query.classIDs.end(), d.classID) == query.classIDs.end()) {
+			continue;
+		}
+		if (query.matchName) {
+			std::string compared = query.namePrefix ? d.name.substr(0, query.name.size()) : d.name;
+			if (!d.hasName || compared != query.name) {
+				continue;
+			}
+		}
+		selected.push_back(i);
+	}
+	return selected;
+}
+
+void CheckPlans(AssetFile &asset) {
+	int checked = 0;
+	for (size_t t = 0; t < asset.file.metadata.types.size(); t++) {
+		const DecodeProgram *program = asset.decoder->Program((int)t);
+		CHECK(program);
+		if (!program) {
+			continue;
+		}
+		NamePlan plan = PlanName(*program);
+		// Older versions name script types by a negative class, so types go by their root.
+		std::string type = program->code[0].type;
+		if (type == "GameObject") {
+			// m_Component is a vector, so the name is found by running the program up to it.
+			CHECK(plan.HasName() && plan.offset == -1 && !plan.prefix.code.empty());
+			CHECK(plan.prefix.code.size() < program->code.size());
+			CHECK(plan.prefix.code.back().op == Instruction::String);
+			CHECK(strcmp(plan.prefix.code.back().name, "m_Name") == 0);
+		} else if (type == "MonoBehaviour") {
+			// Two 12-byte PPtrs around a byte aligned to 4.
+			CHECK(plan.offset == 28 && plan.prefix.code.empty());
+		} else if (type == "Texture2D" || type == "Mesh") {
+			CHECK(plan.offset == 0 && plan.prefix.code.empty());
+		} else {
+			CHECK(type == "Transform" && !plan.HasName());
+		}
+		checked++;
+	}
+	CHECK(checked == 5);
+}
+
+// Queries returns class, name and prefix queries, some of whose names are taken from
+// decoded so that they match.
+std::vector<ObjectQuery> Queries(const std::vector<Decoded> &decoded) {
+	std::string gameObjectName;
+	std::string behaviourName;
+	for (auto &d : decoded) {
+		if (d.classID == synthetic::GameObject && d.name.size() > 2 && gameObjectName.empty()) {
+			gameObjectName = d.name;
+		}
+		if (d.classID == synthetic::MonoBehaviour && d.name.size() > 2 && behaviourName.empty()) {
+			behaviourName = d.name;
+		}
+	}
+	CHECK(!gameObjectName.empty() && !behaviourName.empty());
+
+	std::vector<ObjectQuery> queries;
+	auto add = [&](std::vector<int> classIDs, bool matchName, bool namePrefix, std::string name) {
+		ObjectQuery query;
+		query.classIDs = std::move(classIDs);
+		query.matchName = matchName;
+		query.namePrefix = namePrefix;
+		query.name = std::move(name);
+		queries.push_back(std::move(query));
+	};
+	add({}, false, false, "");
+	add({ synthetic::GameObject }, false, false, "");
+	add({ synthetic::Texture2D, synthetic::Mesh }, false, false, "");
+	add({}, true, false, gameObjectName);
+	add({}, true, false, behaviourName);
+	add({ synthetic::GameObject }, true, false, gameObjectName);
+	add({ synthetic::MonoBehaviour }, true, false, gameObjectName);
+	add({}, true, true, gameObjectName.substr(0, 1));
+	add({}, true, true, behaviourName.substr(0, 2));
+	add({ synthetic::GameObject, synthetic::MonoBehaviour }, true, true, "b");
+	add({}, true, true, "");
+	add({}, true, false, "");
+	add({}, true, false, "no such name at all");
+	add({ synthetic::Transform }, true, true, "");
+	return queries;
+}
+
+void CheckQueries(const synthetic::Options &options) {
+	CHECK(synthetic::WriteFile(Path, options));
+	AssetFile asset;
+	CHECK(asset.Open(Path));
+	CheckPlans(asset);
+	std::vector<Decoded> decoded = DecodeAll(asset);
+
+	synthetic::BundleOptions bundleOptions;
+	bundleOptions.blockSize = 8192;
+	std::vector<char> bytes = synthetic::Build(options);
+	CHECK(synthetic::WriteBytes(BundlePath, synthetic::BuildBundle({ synthetic::BundleNode{ "CAB-query", bytes, true } },
+		bundleOptions)));
+	BundleFile bundle;
+	BlockCache cache(1 << 20);
+	BundleAsset bundleAsset;
+	CHECK(bundle.OpenTables(BundlePath));
+	CHECK(bundle.info.nodes.size() == 1 && bundleAsset.Open(bundle, bundle.info.nodes[0], cache));
+
+	size_t named[2] = {};
+	for (auto &d : decoded) {
+		if (d.hasName) {
+			named[d.classID == synthetic::GameObject]++;
+		}
+	}
+	for (const ObjectQuery &query : Queries(decoded)) {
+		std::vector<uint32_t> expected = Expected(decoded, query);
+		ObjectQuery::Stats stats;
+		CHECK(query.Select(asset, &stats) == expected);
+		CHECK(stats.objects == decoded.size() && stats.matches == expected.size());
+		ObjectQuery::Stats bundleStats;
+		CHECK(query.Select(bundleAsset, &bundleStats) == expected);
+		CHECK(bundleStats.matches == expected.size());
+		CHECK(bundleStats.fixedReads == stats.fixedReads && bundleStats.prefixDecodes == stats.prefixDecodes);
+		if (query.matchName && query.classIDs.empty()) {
+			// Every name is read, at its fixed offset except for GameObjects'.
+			CHECK(stats.typeMatches == decoded.size());
+			CHECK(stats.fixedReads == named[0] && stats.prefixDecodes == named[1]);
+		}
+		if (!query.matchName) {
+			CHECK(stats.fixedReads == 0 && stats.prefixDecodes == 0 && stats.nameBytes == 0);
+		}
+	}
+}
+
+};
+
+int main() {
+	synthetic::Options options;
+	options.objects = 400;
+	CheckQueries(options);
+	options.bigEndian = true;
+	CheckQueries(options);
+	options.bigEndian = false;
+	options.version = 15;
+	CheckQueries(options);
+	options.version = 21;
+	options.seed = 4;
+	CheckQueries(options);
+	remove(Path);
+	remove(BundlePath);
+	return test::Result();
+}
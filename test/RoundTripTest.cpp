@@ -0,0 +1,106 @@
+// RoundTripTest reads synthetic files of every supported layout and writes their metadata
+// back with SerializedFile::Write, which must reproduce the header and metadata byte for
+// byte.  Writing must also leave TypeTrees shared through a cache as they were.
+#include "MmapReader.h"
+#include "SerializedFile.h"
+#include "Synthetic.h"
+#include "Test.h"
+
+using namespace unitypack;
+
+namespace {
+
+bool Read(const std::vector<char> &bytes, SerializedFile &file, TypeTreeCache *cache = nullptr) {
+	serialize::MmapReaderT<serialize::Endian::Big> s{};
+	s.typeTrees = cache;
+	s.SetRange(bytes.data(), bytes.size());
+	return file.Read(s);
+}
+
+// Metadata returns the header and metadata of a file, which is what Write produces.
+std::vector<char> Metadata(const std::vector<char> &bytes, const SerializedFile &file) {
+	return std::vector<char>(bytes.begin(), bytes.begin() + 20 + file.header.metadataSize);
+}
+
+void CheckRoundTrip(int version, bool bigEndian) {
+	synthetic::Options options;
+	options.version = version;
+	options.bigEndian = bigEndian;
+	options.objects = 200;
+	std::vector<char> bytes = synthetic::Build(options);
+
+	SerializedFile file{};
+	CHECK(Read(bytes, file));
+	std::vector<char> expected = Metadata(bytes, file);
+	std::vector<char> out;
+	CHECK(file.Write(out));
+	CHECK(out == expected);
+
+	// Writing again gives the same bytes, so the first write changed nothing it reads.
+	std::vector<char> again;
+	CHECK(file.Write(again));
+	CHECK(again == out);
+}
+
+void CheckSharedTrees(bool bigEndian) {
+	synthetic::Options options;
+	options.bigEndian = bigEndian;
+	std::vector<char> bytes = synthetic::Build(options);
+	TypeTreeCache cache;
+	SerializedFile first{}, second{};
+	CHECK(Read(bytes, first, &cache));
+	CHECK(Read(bytes, second, &cache));
+
+	std::vector<std::shared_ptr<const TypeTree>> trees;
+	for (auto &type : second.metadata.types) {
+		CHECK(type.sharedTree);
+		trees.push_back(type.sharedTree);
+	}
+	std::vector<char> expected = Metadata(bytes, second);
+	std::vector<char> out;
+	CHECK(second.Write(out));
+	CHECK(out == expected);
+	for (size_t i = 0; i < second.metadata.types.size(); i++) {
+		auto &type = second.metadata.types[i];
+		CHECK(type.sharedTree == trees[i]);
+		CHECK(type.tree.nodes.empty() && type.tree.buffer.empty());
+		CHECK(first.metadata.types[i].sharedTree == trees[i]);
+	}
+}
+
+// CheckPatch changes a string in the metadata, which moves everything after it, and checks
+// that the written file reads back with the change.
+void CheckPatch(int version) {
+	synthetic::Options options;
+	options.version = version;
+	std::vector<char> bytes = synthetic::Build(options);
+	SerializedFile file{};
+	CHECK(Read(bytes, file));
+	size_t size = Metadata(bytes, file).size();
+	size_t grown = strlen("library/a much longer name") - file.metadata.externalFiles[0].fileName.size();
+	file.metadata.externalFiles[0].fileName = "library/a much longer name";
+	std::vector<char> out;
+	CHECK(file.Write(out));
+	CHECK(out.size() == size + grown);
+
+	SerializedFile patched{};
+	CHECK(Read(out, patched));
+	CHECK(patched.header.metadataSize == file.header.metadataSize);
+	CHECK(patched.metadata.externalFiles[0].fileName == file.metadata.externalFiles[0].fileName);
+	CHECK(patched.metadata.objects.size() == file.metadata.objects.size());
+	CHECK(patched.metadata.objects.back().objectID == file.metadata.objects.back().objectID);
+}
+
+};
+
+int main() {
+	for (int version : { 9, 10, 11, 12, 13, 14, 15, 16, 17, 21 }) {
+		CheckRoundTrip(version, false);
+		CheckRoundTrip(version, true);
+	}
+	CheckSharedTrees(false);
+	CheckSharedTrees(true);
+	CheckPatch(15);
+	CheckPatch(17);
+	return test::Result();
+}
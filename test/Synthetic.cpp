@@ -0,0 +1,574 @@
+#include "Synthetic.h"
+#include "BundleFile.h"
+#include "SerializedFile.h"
+#include <algorithm>
+
+namespace unitypack {
+namespace synthetic {
+
+namespace {
+
+const uint32_t alignFlag = 0x4000;
+
+struct TreeDef {
+	const char *type;
+	const char *name;
+	int byteSize;
+	bool isArray;
+	uint32_t metaFlag;
+	std::vector<TreeDef> children;
+};
+
+TreeDef Leaf(const char *type, const char *name, int byteSize, uint32_t metaFlag = 0) {
+	return TreeDef{ type, name, byteSize, false, metaFlag, {} };
+}
+
+TreeDef Struct(const char *type, const char *name, std::vector<TreeDef> children, uint32_t metaFlag = 0) {
+	int byteSize = 0;
+	for (auto &child : children) {
+		byteSize = child.byteSize < 0 || byteSize < 0 ? -1 : byteSize + child.byteSize;
+	}
+	return TreeDef{ type, name, byteSize, false, metaFlag, std::move(children) };
+}
+
+TreeDef Named(TreeDef def, const char *name) {
+	def.name = name;
+	return def;
+}
+
+TreeDef Array(const char *type, const char *name, TreeDef element, uint32_t metaFlag) {
+	return TreeDef{ type, name, -1, true, metaFlag, { Leaf("int", "size", 4), Named(std::move(element), "data") } };
+}
+
+TreeDef Vector(const char *name, TreeDef element, uint32_t metaFlag = 0) {
+	return Struct("vector", name, { Array("Array", "Array", std::move(element), metaFlag) });
+}
+
+TreeDef String(const char *name) {
+	return Struct("string", name, { Array("Array", "Array", Leaf("char", "data", 1), alignFlag) });
+}
+
+TreeDef PPtr(const char *type, const char *name) {
+	return Struct(type, name, { Leaf("int", "m_FileID", 4), Leaf("SInt64", "m_PathID", 8) });
+}
+
+TreeDef Vector3(const char *name) {
+	return Struct("Vector3f", name, { Leaf("float", "x", 4), Leaf("float", "y", 4), Leaf("float", "z", 4) });
+}
+
+struct TypeDef {
+	int classID;
+	TreeDef tree;
+};
+
+// Types returns trees shaped like those of the hot Unity types, between them using every
+// scalar kind, strings, nested arrays, maps, aligned fields and a leaf of unknown type.
+std::vector<TypeDef> Types() {
+	std::vector<TypeDef> types;
+	types.push_back(TypeDef{ GameObject, Struct("GameObject", "Base", {
+		Vector("m_Component", Struct("ComponentPair", "data", { PPtr("PPtr<Component>", "component") })),
+		Leaf("unsigned int", "m_Layer", 4),
+		String("m_Name"),
+		Leaf("UInt16", "m_Tag", 2),
+		Leaf("bool", "m_IsActive", 1, alignFlag),
+	}) });
+	types.push_back(TypeDef{ Transform, Struct("Transform", "Base", {
+		PPtr("PPtr<GameObject>", "m_GameObject"),
+		Struct("Quaternionf", "m_LocalRotation", {
+			Leaf("float", "x", 4), Leaf("float", "y", 4), Leaf("float", "z", 4), Leaf("float", "w", 4) }),
+		Vector3("m_LocalPosition"),
+		Vector3("m_LocalScale"),
+		Vector("m_Children", PPtr("PPtr<Transform>", "data")),
+		PPtr("PPtr<Transform>", "m_Father"),
+	}) });
+	types.push_back(TypeDef{ Texture2D, Struct("Texture2D", "Base", {
+		String("m_Name"),
+		Leaf("int", "m_Width", 4),
+		Leaf("int", "m_Height", 4),
+		Leaf("int", "m_TextureFormat", 4),
+		Leaf("bool", "m_IsReadable", 1, alignFlag),
+		Array("TypelessData", "image data", Leaf("UInt8", "data", 1), alignFlag),
+		Struct("StreamingInfo", "m_StreamData", {
+			Leaf("UInt64", "offset", 8), Leaf("unsigned int", "size", 4), String("path") }),
+	}) });
+	types.push_back(TypeDef{ Mesh, Struct("Mesh", "Base", {
+		String("m_Name"),
+		Vector("m_SubMeshes", Struct("SubMesh", "data", {
+			Leaf("unsigned int", "firstByte", 4), Leaf("unsigned int", "indexCount", 4), Leaf("int", "topology", 4) })),
+		Vector("m_IndexBuffer", Leaf("UInt8", "data", 1), alignFlag),
+		Vector("m_Vertices", Vector3("data")),
+		Vector("m_Weights", Leaf("float", "data", 4)),
+		Vector("m_Groups", Vector("data", Leaf("SInt16", "data", 2))),
+		Struct("map", "m_Lookup", { Array("Array", "Array", Struct("pair", "data", {
+			Leaf("int", "first", 4), String("second") }), 0) }),
+		Leaf("Hash128", "m_Hash", 16),
+		Leaf("SInt8", "m_Flags", 1, alignFlag),
+		Leaf("SInt64", "m_Big", 8),
+		Leaf("UInt64", "m_Unsigned", 8),
+		Leaf("double", "m_Precise", 8),
+	}) });
+	types.push_back(TypeDef{ MonoBehaviour, Struct("MonoBehaviour", "Base", {
+		PPtr("PPtr<GameObject>", "m_GameObject"),
+		Leaf("UInt8", "m_Enabled", 1, alignFlag),
+		PPtr("PPtr<MonoScript>", "m_Script"),
+		String("m_Name"),
+		Vector("m_Tags", String("data")),
+	}) });
+	return types;
+}
+
+struct Random {
+	uint32_t state;
+
+	uint32_t Next() {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+	uint32_t Below(uint32_t n) {
+		return Next() % n;
+	}
+};
+
+// Writer appends values in one byte order.
+struct Writer {
+	std::vector<char> bytes;
+	bool bigEndian = false;
+
+	template <typename T>
+	void Put(T value) {
+		uint8_t raw[sizeof(T)];
+		memcpy(raw, &value, sizeof(T));
+		if (bigEndian) {
+			for (size_t i = 0; i < sizeof(T) / 2; i++) {
+				std::swap(raw[i], raw[sizeof(T) - 1 - i]);
+			}
+		}
+		bytes.insert(bytes.end(), raw, raw + sizeof(T));
+	}
+	void Raw(const void *data, size_t size) {
+		bytes.insert(bytes.end(), (const char *)data, (const char *)data + size);
+	}
+	void CString(const char *text) {
+		Raw(text, strlen(text) + 1);
+	}
+	// Align pads to a multiple of 4 bytes from base.
+	void Align(size_t base = 0) {
+		while ((bytes.size() - base) % 4) {
+			bytes.push_back(0);
+		}
+	}
+	void Hash(const unitypack::Hash &hash) {
+		for (uint32_t word : hash.hash) {
+			Put<uint32_t>(word);
+		}
+	}
+};
+
+struct FlatNode {
+	const TreeDef *def;
+	int depth;
+};
+
+void Flatten(const TreeDef &def, int depth, std::vector<FlatNode> &nodes) {
+	nodes.push_back(FlatNode{ &def, depth });
+	for (auto &child : def.children) {
+		Flatten(child, depth + 1, nodes);
+	}
+}
+
+// StringIndex returns where text lies in the global string table with the top bit set, or
+// adds it to local.
+uint32_t StringIndex(const char *text, std::vector<char> &local) {
+	for (size_t offset = 0; offset < TypeTree::globalBufferSize;) {
+		const char *global = TypeTree::globalBuffer + offset;
+		if (strcmp(global, text) == 0) {
+			return 0x80000000u | (uint32_t)offset;
+		}
+		offset += strlen(global) + 1;
+	}
+	for (size_t offset = 0; offset < local.size();) {
+		if (strcmp(local.data() + offset, text) == 0) {
+			return (uint32_t)offset;
+		}
+		offset += strlen(local.data() + offset) + 1;
+	}
+	uint32_t offset = (uint32_t)local.size();
+	local.insert(local.end(), text, text + strlen(text) + 1);
+	return offset;
+}
+
+void WriteTree(Writer &out, const TreeDef &root, int version) {
+	std::vector<FlatNode> nodes;
+	Flatten(root, 0, nodes);
+	if (version == 10 || version >= 12) {
+		std::vector<char> local;
+		Writer body;
+		body.bigEndian = out.bigEndian;
+		for (size_t i = 0; i < nodes.size(); i++) {
+			const TreeDef &def = *nodes[i].def;
+			body.Put<uint16_t>(1);
+			body.Put<uint8_t>((uint8_t)nodes[i].depth);
+			body.Put<uint8_t>(def.isArray);
+			body.Put<uint32_t>(StringIndex(def.type, local));
+			body.Put<uint32_t>(StringIndex(def.name, local));
+			body.Put<int>(def.byteSize);
+			body.Put<int>((int)i);
+			body.Put<uint32_t>(def.metaFlag);
+		}
+		out.Put<int>((int)nodes.size());
+		out.Put<int>((int)local.size());
+		out.Raw(body.bytes.data(), body.bytes.size());
+		out.Raw(local.data(), local.size());
+		return;
+	}
+	// Legacy trees are written node by node, each followed by its children.
+	int index = 0;
+	struct Legacy {
+		Writer &out;
+		int &index;
+		void Node(const TreeDef &def) {
+			out.CString(def.type);
+			out.CString(def.name);
+			out.Put<int>(def.byteSize);
+			out.Put<int>(index++);
+			out.Put<int>(def.isArray);
+			out.Put<int>(1);
+			out.Put<int>((int)def.metaFlag);
+			out.Put<int>((int)def.children.size());
+			for (auto &child : def.children) {
+				Node(child);
+			}
+		}
+	};
+	Legacy{ out, index }.Node(root);
+}
+
+// WriteValue writes a pseudo-random value of the shape def describes, or the PPtrs
+// options.link picks for object.  base is where the object starts, which alignment counts
+// from.
+void WriteValue(Writer &out, const TreeDef &def, Random &random, size_t base, const Options &options, int object) {
+	if (options.link && strncmp(def.type, "PPtr<", 5) == 0) {
+		int fileID = 0;
+		int64_t pathID = 0;
+		options.link(object, fileID, pathID);
+		out.Put<int>(fileID);
+		out.Put<int64_t>(pathID);
+	} else if (def.isArray) {
+		const TreeDef &element = def.children[1];
+		bool bytes = element.children.empty() && element.byteSize == 1;
+		int count = (int)random.Below(bytes ? 24 : 4);
+		out.Put<int>(count);
+		for (int i = 0; i < count; i++) {
+			WriteValue(out, element, random, base, options, object);
+		}
+	} else if (!def.children.empty()) {
+		for (auto &child : def.children) {
+			WriteValue(out, child, random, base, options, object);
+		}
+	} else if (strcmp(def.type, "bool") == 0) {
+		out.Put<uint8_t>(random.Below(2));
+	} else if (strcmp(def.type, "char") == 0) {
+		out.Put<char>((char)('a' + random.Below(26)));
+	} else if (strcmp(def.type, "float") == 0) {
+		out.Put<float>((float)(int)random.Below(20001) / 100 - 100);
+	} else if (strcmp(def.type, "double") == 0) {
+		out.Put<double>((double)random.Next() / 7);
+	} else {
+		for (int i = 0; i < def.byteSize; i++) {
+			out.Put<uint8_t>((uint8_t)random.Next());
+		}
+	}
+	if (def.metaFlag & alignFlag) {
+		out.Align(base);
+	}
+}
+
+};
+
+std::vector<char> Build(const Options &options) {
+	const int version = options.version;
+	std::vector<TypeDef> types = Types();
+	Random random{ options.seed ? options.seed : 1 };
+
+	// Payloads come first, so that the object table knows their offsets and sizes.
+	Writer data;
+	data.bigEndian = options.bigEndian;
+	std::vector<SerializedFile::ObjectInfo> objects((size_t)options.objects);
+	uint64_t pathID = 0;
+	for (size_t i = 0; i < objects.size(); i++) {
+		auto &object = objects[i];
+		int typeIndex = (int)random.Below((uint32_t)types.size());
+		if (options.densePathIDs) {
+			object.objectID = ++pathID;
+		} else {
+			// Path IDs are sorted but not dense, and need 64 bits from version 14.
+			pathID += 1 + random.Below(3);
+			object.objectID = version >= 14 && (pathID & 15) == 0 ? pathID | (uint64_t)1 << 40 : pathID;
+		}
+		object.typeIndex = typeIndex;
+		object.classID = (int16_t)types[typeIndex].classID;
+		object.typeID = types[typeIndex].classID == MonoBehaviour ? -1 : types[typeIndex].classID;
+		if (options.payloads) {
+			data.bytes.resize((data.bytes.size() + 7) & ~(size_t)7);
+			size_t start = data.bytes.size();
+			WriteValue(data, types[typeIndex].tree, random, start, options, (int)i);
+			object.dataOffset = (int)start;
+			object.dataSize = (int)(data.bytes.size() - start);
+		} else {
+			object.dataOffset = 0;
+			object.dataSize = 0;
+		}
+	}
+	// 64-bit path IDs must stay sorted.
+	for (size_t i = 1; i < objects.size(); i++) {
+		if (objects[i].objectID < objects[i - 1].objectID) {
+			objects[i].objectID = objects[i - 1].objectID + 1;
+		}
+	}
+
+	const size_t headerSize = 20;
+	Writer meta;
+	meta.bigEndian = options.bigEndian;
+	meta.CString(version >= 17 ? "2017.4.1f1" : "5.2.0f3");
+	meta.Put<int>(5);
+	if (version >= 13) {
+		meta.Put<uint8_t>(1);
+	}
+	meta.Put<int>((int)types.size());
+	for (auto &type : types) {
+		bool script = type.classID == MonoBehaviour;
+		if (version >= 17) {
+			meta.Put<int>(type.classID);
+			meta.Put<uint8_t>(0);
+			meta.Put<int16_t>(script ? 0 : -1);
+		} else {
+			meta.Put<int>(script ? -1 : type.classID);
+		}
+		if (version >= 13) {
+			if (script) {
+				meta.Hash(Hash{ { 0x5c817, (uint32_t)type.classID, 1, 2 } });
+			}
+			meta.Hash(Hash{ { (uint32_t)type.classID, 0xdeadbeef, 0, (uint32_t)version } });
+		}
+		WriteTree(meta, type.tree, version);
+	}
+	if (7 <= version && version <= 13) {
+		meta.Put<int>(0);
+	}
+	meta.Put<int>((int)objects.size());
+	for (size_t i = 0; i < objects.size(); i++) {
+		auto &object = objects[i];
+		if (version >= 14) {
+			// The alignment counts from the start of the file, and the header is 20 bytes.
+			meta.Align();
+			meta.Put<uint64_t>(object.objectID);
+		} else {
+			meta.Put<uint32_t>((uint32_t)object.objectID);
+		}
+		meta.Put<int>(object.dataOffset);
+		meta.Put<int>(object.dataSize);
+		if (version >= 17) {
+			meta.Put<int>(object.typeIndex);
+		} else {
+			meta.Put<int>(object.typeID);
+			meta.Put<int16_t>(object.classID);
+		}
+		if (version <= 16) {
+			meta.Put<int16_t>(object.classID == MonoBehaviour ? 0 : -1);
+		}
+		if (15 <= version && version <= 16) {
+			meta.Put<uint8_t>(0);
+		}
+	}
+	if (version >= 11) {
+		meta.Put<int>(2);
+		for (int i = 1; i <= 2; i++) {
+			meta.Put<int>(i);
+			if (version >= 14) {
+				meta.Align();
+				meta.Put<uint64_t>((uint64_t)i << 33);
+			} else {
+				meta.Put<uint32_t>((uint32_t)i);
+			}
+		}
+	}
+	meta.Put<int>((int)options.externals.size());
+	for (auto &external : options.externals) {
+		const char *fileName = external.c_str();
+		if (version >= 6) {
+			meta.CString("");
+		}
+		if (version >= 5) {
+			meta.Hash(Hash{ { 1, 2, 3, (uint32_t)strlen(fileName) } });
+			meta.Put<int>(0);
+		}
+		meta.CString(fileName);
+	}
+	if (version >= 5) {
+		meta.CString("");
+	}
+
+	size_t objectDataOffset = (headerSize + meta.bytes.size() + 15) & ~(size_t)15;
+	Writer file;
+	file.bigEndian = true;
+	file.Put<int>((int)meta.bytes.size());
+	file.Put<int>((int)(objectDataOffset + data.bytes.size()));
+	file.Put<int>(version);
+	file.Put<int>((int)objectDataOffset);
+	file.Put<uint8_t>(options.bigEndian);
+	file.Align();
+	file.Raw(meta.bytes.data(), meta.bytes.size());
+	file.bytes.resize(objectDataOffset);
+	file.Raw(data.bytes.data(), data.bytes.size());
+	return std::move(file.bytes);
+}
+
+bool WriteFile(const char *path, const Options &options) {
+	return WriteBytes(path, Build(options));
+}
+
+bool WriteBytes(const char *path, const std::vector<char> &bytes) {
+	FILE *fp = fopen(path, "wb");
+	if (!fp) {
+		return false;
+	}
+	bool ok = fwrite(bytes.data(), 1, bytes.size(), fp) == bytes.size();
+	return fclose(fp) == 0 && ok;
+}
+
+std::vector<char> Lz4Compress(const char *src, size_t size) {
+	std::vector<char> out;
+	auto putLength = [&](size_t length) {
+		for (; length >= 255; length -= 255) {
+			out.push_back((char)255);
+		}
+		out.push_back((char)length);
+	};
+	// sequence writes literals [anchor, start) and then, unless this is the last sequence, a
+	// match of length bytes at offset.
+	auto sequence = [&](size_t anchor, size_t start, size_t offset, size_t length) {
+		size_t literals = start - anchor;
+		size_t extra = length ? length - 4 : 0;
+		out.push_back((char)(std::min<size_t>(literals, 15) << 4 | std::min<size_t>(extra, 15)));
+		if (literals >= 15) {
+			putLength(literals - 15);
+		}
+		out.insert(out.end(), src + anchor, src + start);
+		if (length) {
+			out.push_back((char)(offset & 0xff));
+			out.push_back((char)(offset >> 8));
+			if (extra >= 15) {
+				putLength(extra - 15);
+			}
+		}
+	};
+
+	// The format wants the last match to start 12 bytes before the end at the latest, and
+	// the last 5 bytes to be literals.
+	const uint32_t empty = 0xffffffff;
+	std::vector<uint32_t> table(4096, empty);
+	size_t anchor = 0;
+	for (size_t i = 0; i + 12 <= size;) {
+		uint32_t value;
+		memcpy(&value, src + i, 4);
+		uint32_t &slot = table[(value * 2654435761u) >> 20];
+		size_t candidate = slot;
+		slot = (uint32_t)i;
+		if (candidate == empty || i - candidate > 0xffff || memcmp(src + candidate, src + i, 4) != 0) {
+			i++;
+			continue;
+		}
+		size_t length = 4;
+		while (i + length < size - 5 && src[candidate + length] == src[i + length]) {
+			length++;
+		}
+		sequence(anchor, i, i - candidate, length);
+		i += length;
+		anchor = i;
+	}
+	sequence(anchor, size, 0, 0);
+	return out;
+}
+
+std::vector<char> BuildBundle(const std::vector<BundleNode> &nodes, const BundleOptions &options) {
+	auto compress = [](uint32_t compression, const char *src, size_t size) {
+		return compression == BundleFile::None ? std::vector<char>(src, src + size) : Lz4Compress(src, size);
+	};
+
+	Writer stream;
+	Writer info;
+	info.bigEndian = true;
+	info.Hash(Hash{});
+	std::vector<char> blocks;
+	std::vector<BundleFile::Node> entries;
+	for (auto &node : nodes) {
+		uint32_t flags = node.serializedFile ? BundleFile::NodeIsSerializedFile : 0;
+		entries.push_back(BundleFile::Node{ (int64_t)stream.bytes.size(), (int64_t)node.data.size(), flags, node.path });
+		stream.Raw(node.data.data(), node.data.size());
+	}
+	size_t count = (stream.bytes.size() + options.blockSize - 1) / options.blockSize;
+	info.Put<int>((int)count);
+	for (size_t i = 0; i < count; i++) {
+		size_t start = i * options.blockSize;
+		size_t size = std::min(options.blockSize, stream.bytes.size() - start);
+		uint32_t compression = options.alternateBlocks && i % 2 ? BundleFile::None : options.blockCompression;
+		std::vector<char> block = compress(compression, stream.bytes.data() + start, size);
+		info.Put<uint32_t>((uint32_t)size);
+		info.Put<uint32_t>((uint32_t)block.size());
+		info.Put<uint16_t>((uint16_t)compression);
+		blocks.insert(blocks.end(), block.begin(), block.end());
+	}
+	info.Put<int>((int)entries.size());
+	for (auto &entry : entries) {
+		info.Put<int64_t>(entry.offset);
+		info.Put<int64_t>(entry.size);
+		info.Put<uint32_t>(entry.flags);
+		info.CString(entry.path.c_str());
+	}
+	std::vector<char> packedInfo = compress(options.infoCompression, info.bytes.data(), info.bytes.size());
+
+	uint32_t flags = options.infoCompression;
+	if (options.infoAtEnd) {
+		flags |= BundleFile::BlocksInfoAtTheEnd;
+	}
+	if (options.padBlocks) {
+		flags |= BundleFile::BlockInfoNeedPaddingAtStart;
+	}
+	Writer file;
+	file.bigEndian = true;
+	file.CString("UnityFS");
+	file.Put<int>(options.version);
+	file.CString("5.x.x");
+	file.CString("2018.4.2f1");
+	size_t sizeAt = file.bytes.size();
+	file.Put<int64_t>(0);
+	file.Put<uint32_t>((uint32_t)packedInfo.size());
+	file.Put<uint32_t>((uint32_t)info.bytes.size());
+	file.Put<uint32_t>(flags);
+	auto align16 = [&]() {
+		file.bytes.resize((file.bytes.size() + 15) & ~(size_t)15);
+	};
+	if (options.version >= 7) {
+		align16();
+	}
+	if (!options.infoAtEnd) {
+		file.Raw(packedInfo.data(), packedInfo.size());
+	}
+	if (options.padBlocks) {
+		align16();
+	}
+	file.Raw(blocks.data(), blocks.size());
+	if (options.infoAtEnd) {
+		file.Raw(packedInfo.data(), packedInfo.size());
+	}
+	Writer size;
+	size.bigEndian = true;
+	size.Put<int64_t>((int64_t)file.bytes.size());
+	memcpy(file.bytes.data() + sizeAt, size.bytes.data(), 8);
+	return std::move(file.bytes);
+}
+
+};
+};
@@ -0,0 +1,79 @@
+// This header builds synthetic SerializedFiles, and UnityFS bundles holding them, in memory
+// for the tests and benchmarks.
+//
+// The bytes are written field by field following the file format, not through the
+// serializers, so that what the serializers read can be checked against them.
+#pragma once
+
+#include "default.h"
+#include <functional>
+#include <stdint.h>
+
+namespace unitypack {
+namespace synthetic {
+
+// ClassIDs of the types every synthetic file describes.
+enum ClassID {
+	GameObject = 1,
+	Transform = 4,
+	Texture2D = 28,
+	Mesh = 43,
+	MonoBehaviour = 114,
+};
+
+struct Options {
+	// Format versions from 9 to 21 are supported.
+	int version = 17;
+	bool bigEndian = false;
+	int objects = 1000;
+	// Without payloads every object has a dataSize of 0, for benchmarks of the metadata alone.
+	bool payloads = true;
+	uint32_t seed = 1;
+	// Path IDs run 1, 2, 3... instead of skipping some and reaching past 32 bits.
+	bool densePathIDs = false;
+	// When set, every PPtr of object i (its index in the object table) is written as
+	// link(i, fileID, pathID) sets it, instead of random.
+	std::function<void(int object, int &fileID, int64_t &pathID)> link;
+	// The fileNames of the external files, which fileIDs 1 and up refer to.
+	std::vector<std::string> externals = { "library/unity default resources", "archive:/CAB-0123/CAB-0123" };
+};
+
+// Build returns a whole file: header, metadata and the payloads of its objects.  Payloads
+// hold pseudo-random values, laid out as their type's TypeTree describes.
+std::vector<char> Build(const Options &options);
+
+// WriteFile writes Build(options) to path.
+bool WriteFile(const char *path, const Options &options);
+// WriteBytes writes bytes to path.
+bool WriteBytes(const char *path, const std::vector<char> &bytes);
+
+// Lz4Compress returns src as one raw LZ4 block, found by a greedy single-probe search: a
+// valid block, though a larger one than the lz4 library writes.
+std::vector<char> Lz4Compress(const char *src, size_t size);
+
+struct BundleNode {
+	std::string path;
+	std::vector<char> data;
+	bool serializedFile = true;
+};
+
+struct BundleOptions {
+	// Versions 6 and 7 are supported; 7 pads the header to 16 bytes.
+	int version = 7;
+	bool infoAtEnd = false;
+	// Sets BlockInfoNeedPaddingAtStart, aligning the first block to 16 bytes.
+	bool padBlocks = false;
+	// The BundleFile::Compression of the blocks info and of the blocks.  With
+	// alternateBlocks, every other block is stored instead.
+	uint32_t infoCompression = 3;
+	uint32_t blockCompression = 2;
+	bool alternateBlocks = false;
+	// The stream the nodes concatenate into is cut into blocks of this many bytes.
+	size_t blockSize = 1 << 16;
+};
+
+// BuildBundle returns a UnityFS bundle holding nodes, in order.
+std::vector<char> BuildBundle(const std::vector<BundleNode> &nodes, const BundleOptions &options);
+
+};
+};
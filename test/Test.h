@@ -0,0 +1,33 @@
+// This header contains the checks the tests share.
+//
+// Each test is its own executable, registered with CTest.  A failed CHECK prints where it
+// failed and the test carries on; main returns test::Result() so that CTest sees the failure.
+#pragma once
+
+#include "default.h"
+
+namespace unitypack {
+namespace test {
+
+inline int &Failures() {
+	static int failures = 0;
+	return failures;
+}
+
+inline int Result() {
+	if (Failures()) {
+		fprintf(stderr, "%d checks failed\n", Failures());
+		return 1;
+	}
+	return 0;
+}
+
+};
+};
+
+#define CHECK(condition) do { \
+	if (!(condition)) { \
+		fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+		unitypack::test::Failures()++; \
+	} \
+} while (0)
@@ -0,0 +1,196 @@
+// TextureTest checks the SIMD block decoders against the scalar one, which is the
+// reference: every format is decoded from pseudo-random blocks, which reach every block
+// mode, at sizes with and without partial edge blocks, and every instruction set the CPU
+// supports must produce the same bytes.  Known-answer blocks, one or more for each block
+// mode, check the scalar decoder itself.
+#include "TextureDecoder.h"
+#include "Test.h"
+
+using namespace unitypack;
+
+namespace {
+
+const TextureFormat formats[] = {
+	TextureFormat::DXT1,
+	TextureFormat::DXT5,
+	TextureFormat::ETC_RGB4,
+	TextureFormat::ETC2_RGB,
+	TextureFormat::ETC2_RGBA1,
+	TextureFormat::ETC2_RGBA8,
+};
+
+const TextureIsa isas[] = { TextureIsa::Best, TextureIsa::SSSE3, TextureIsa::AVX2 };
+
+std::vector<char> RandomBytes(size_t size, uint32_t seed) {
+	std::vector<char> bytes(size);
+	for (char &byte : bytes) {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		byte = (char)(seed >> 24);
+	}
+	return bytes;
+}
+
+// Decode decodes data into an image with a stride wider than its rows, whose padding
+// must be left alone.
+std::vector<uint8_t> Decode(TextureFormat format, const std::vector<char> &data, int width, int height,
+	TextureIsa isa, ThreadPool *pool) {
+	size_t stride = (size_t)width * 4 + 12;
+	std::vector<uint8_t> rgba(stride * height, 0xcd);
+	CHECK(DecodeTexture(format, data.data(), data.size(), width, height, rgba.data(), stride, pool, isa));
+	for (int y = 0; y < height; y++) {
+		for (size_t x = (size_t)width * 4; x < stride; x++) {
+			CHECK(rgba[y * stride + x] == 0xcd);
+		}
+	}
+	return rgba;
+}
+
+void CheckConformance(ThreadPool &pool) {
+	const int sizes[][2] = { { 1, 1 }, { 4, 4 }, { 37, 21 }, { 130, 7 }, { 64, 64 } };
+	uint32_t seed = 1;
+	for (TextureFormat format : formats) {
+		for (auto &size : sizes) {
+			int width = size[0], height = size[1];
+			std::vector<char> data = RandomBytes(TextureSize(format, width, height), seed++);
+			std::vector<uint8_t> reference = Decode(format, data, width, height, TextureIsa::Scalar, nullptr);
+			CHECK(Decode(format, data, width, height, TextureIsa::Scalar, &pool) == reference);
+			for (TextureIsa isa : isas) {
+				if (!TextureIsaSupported(isa)) {
+					continue;
+				}
+				CHECK(Decode(format, data, width, height, isa, nullptr) == reference);
+				CHECK(Decode(format, data, width, height, isa, &pool) == reference);
+			}
+		}
+	}
+}
+
+uint32_t Pixel(const std::vector<uint8_t> &rgba, int i) {
+	return (uint32_t)rgba[i * 4] << 24 | rgba[i * 4 + 1] << 16 | rgba[i * 4 + 2] << 8 | rgba[i * 4 + 3];
+}
+
+// DecodeBlock decodes one 4x4 block with the scalar decoder and returns its pixels in
+// row order.
+std::vector<uint32_t> DecodeBlock(TextureFormat format, const std::vector<uint8_t> &block) {
+	std::vector<uint8_t> rgba(64);
+	CHECK(DecodeTexture(format, (const char *)block.data(), block.size(), 4, 4, rgba.data(), 16, nullptr,
+		TextureIsa::Scalar));
+	std::vector<uint32_t> pixels(16);
+	for (int i = 0; i < 16; i++) {
+		pixels[i] = Pixel(rgba, i);
+	}
+	return pixels;
+}
+
+// Rows repeats rows, top to bottom, until they fill a block.
+std::vector<uint32_t> Rows(const std::vector<uint32_t> &rows) {
+	std::vector<uint32_t> pixels;
+	while (pixels.size() < 16) {
+		pixels.insert(pixels.end(), rows.begin(), rows.end());
+	}
+	return pixels;
+}
+
+void CheckBlocks() {
+	// BC1 with red and blue endpoints: the indices pick red, blue and the two colors between.
+	std::vector<char> bc1 = { (char)0x00, (char)0xf8, (char)0x1f, 0x00, (char)0xe4, (char)0xe4, (char)0xe4,
+		(char)0xe4 };
+	std::vector<uint8_t> rgba(64);
+	CHECK(DecodeTexture(TextureFormat::DXT1, bc1.data(), bc1.size(), 4, 4, rgba.data(), 16, nullptr,
+		TextureIsa::Scalar));
+	CHECK(Pixel(rgba, 0) == 0xff0000ff);
+	CHECK(Pixel(rgba, 1) == 0x0000ffff);
+	CHECK(Pixel(rgba, 2) == 0xaa0055ff);
+	CHECK(Pixel(rgba, 3) == 0x5500aaff);
+
+	// BC1 whose first endpoint is not the greater has transparent black at index 3.
+	std::vector<char> bc1Alpha = { 0x1f, 0x00, 0x00, (char)0xf8, (char)0xff, (char)0xff, (char)0xff,
+		(char)0xff };
+	CHECK(DecodeTexture(TextureFormat::DXT1, bc1Alpha.data(), bc1Alpha.size(), 4, 4, rgba.data(), 16, nullptr,
+		TextureIsa::Scalar));
+	CHECK(Pixel(rgba, 15) == 0);
+
+	// An ETC1 block in individual mode with table 0 and every index 0: each subblock is its
+	// base color plus 2.
+	std::vector<char> etc = { (char)0x8f, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+	CHECK(DecodeTexture(TextureFormat::ETC_RGB4, etc.data(), etc.size(), 4, 4, rgba.data(), 16, nullptr,
+		TextureIsa::Scalar));
+	CHECK(Pixel(rgba, 0) == 0x8a0202ff);
+	CHECK(Pixel(rgba, 3) == 0xff0202ff);
+
+	// DXT5 with red and blue endpoints, and alpha index i % 8 for pixel i between 255 and 0:
+	// eight alphas, six of them interpolated.
+	CHECK(DecodeBlock(TextureFormat::DXT5, { 0xff, 0x00, 0x88, 0xc6, 0xfa, 0x88, 0xc6, 0xfa, 0x00, 0xf8, 0x1f, 0x00,
+		0xe4, 0xe4, 0xe4, 0xe4 }) == Rows({
+			0xff0000ff, 0x0000ff00, 0xaa0055da, 0x5500aab6,
+			0xff000091, 0x0000ff6d, 0xaa005548, 0x5500aa24 }));
+	// DXT5 whose first alpha is not the greater, 40 and 200 with alpha index 3i % 8: four
+	// interpolated alphas, then 0 and 255.
+	CHECK(DecodeBlock(TextureFormat::DXT5, { 0x28, 0xc8, 0x98, 0xc3, 0xab, 0x98, 0xc3, 0xab, 0xe0, 0x07, 0xff, 0xff,
+		0xe4, 0xe4, 0xe4, 0xe4 }) == Rows({
+			0x00ff0028, 0xffffff68, 0x55ff5500, 0xaaffaac8,
+			0x00ff0088, 0xffffffff, 0x55ff5548, 0xaaffaaa8 }));
+
+	// The ETC2 blocks below index every pixel of column x with x, so that each row shows the
+	// whole palette.
+	// T mode, red overflowing: (221, 170, 85), then (34, 238, 204) plus 64, itself and minus 64.
+	CHECK(DecodeBlock(TextureFormat::ETC2_RGB, { 0xf9, 0xa5, 0x2e, 0xcf, 0xff, 0x00, 0xf0, 0xf0 }) == Rows({
+		0xddaa55ff, 0x62ffffff, 0x22eeccff, 0x00ae8cff }));
+	// H mode, green overflowing: (85, 170, 102) and (204, 119, 34) each plus and minus 23.
+	CHECK(DecodeBlock(TextureFormat::ETC2_RGB, { 0x2d, 0x07, 0x63, 0x96, 0xff, 0x00, 0xf0, 0xf0 }) == Rows({
+		0x6cc17dff, 0x3e934fff, 0xe38e39ff, 0xb5600bff }));
+	// H mode whose first color, (221, 170, 102), is not the lesser, which moves the distance to 32.
+	CHECK(DecodeBlock(TextureFormat::ETC2_RGB, { 0x6d, 0x07, 0x63, 0x96, 0xff, 0x00, 0xf0, 0xf0 }) == Rows({
+		0xfdca86ff, 0xbd8a46ff, 0xec9742ff, 0xac5702ff }));
+	// Planar mode, blue overflowing: O (130, 129, 65), H (251, 0, 130) and V (0, 255, 255),
+	// with blue clamped in the bottom right corner.
+	std::vector<uint8_t> planar = { 0x41, 0x00, 0x14, 0x7e, 0x01, 0x00, 0x1f, 0xff };
+	CHECK(DecodeBlock(TextureFormat::ETC2_RGB, planar) == std::vector<uint32_t>({
+		0x828141ff, 0xa06151ff, 0xbf4162ff, 0xdd2072ff,
+		0x62a171ff, 0x808081ff, 0x9e6091ff, 0xbc40a1ff,
+		0x41c0a0ff, 0x5fa0b0ff, 0x7e80c1ff, 0x9c5fd1ff,
+		0x21e0d0ff, 0x3fbfe0ff, 0x5d9ff0ff, 0x7b7fffff }));
+
+	// Punch-through alpha: without the opaque bit, a differential block drops the
+	// modifier for indices 0 and 1 and makes index 2 transparent black...
+	CHECK(DecodeBlock(TextureFormat::ETC2_RGBA1, { 0x80, 0x40, 0x20, 0x48, 0xff, 0x00, 0xf0, 0xf0 }) == Rows({
+		0x844221ff, 0xa15f3eff, 0x00000000, 0x672504ff }));
+	// ...with it, the same block decodes as in ETC2_RGB...
+	CHECK(DecodeBlock(TextureFormat::ETC2_RGBA1, { 0x80, 0x40, 0x20, 0x4a, 0xff, 0x00, 0xf0, 0xf0 }) == Rows({
+		0x8d4b2aff, 0xa15f3eff, 0x7b3918ff, 0x672504ff }));
+	// ...and a T mode block without it loses only index 2.
+	CHECK(DecodeBlock(TextureFormat::ETC2_RGBA1, { 0xf9, 0xa5, 0x2e, 0xcd, 0xff, 0x00, 0xf0, 0xf0 }) == Rows({
+		0xddaa55ff, 0x62ffffff, 0x00000000, 0x00ae8cff }));
+
+	// EAC alpha ahead of ETC2 color.  Base 128, multiplier 2 and table 13, with alpha index
+	// i % 8 for pixel i, over an individual block whose subblocks are (138, 70, 36) and
+	// (70, 36, 19).
+	CHECK(DecodeBlock(TextureFormat::ETC2_RGBA8, { 0x80, 0x2d, 0x10, 0x43, 0x4d, 0x59, 0x67, 0xdf, 0x84, 0x42,
+		0x21, 0x00, 0x00, 0x00, 0x00, 0x00 }) == Rows({
+			0x8a46247e, 0x8a46247c, 0x4624137a, 0x4624136c,
+			0x8a462480, 0x8a462482, 0x46241384, 0x46241392 }));
+	// Base 250, multiplier 15 and table 0, with alpha index 3i % 8, over the planar block:
+	// every positive modifier clamps to 255.
+	std::vector<uint8_t> eac = { 0xfa, 0xf0, 0x10, 0x47, 0xdf, 0xcb, 0x23, 0x4d };
+	eac.insert(eac.end(), planar.begin(), planar.end());
+	CHECK(DecodeBlock(TextureFormat::ETC2_RGBA8, eac) == std::vector<uint32_t>({
+		0x828141cd, 0xa0615119, 0xbf4162ff, 0xdd2072a0,
+		0x62a171ff, 0x808081ff, 0x9e609173, 0xbc40a1ff,
+		0x41c0a0cd, 0x5fa0b019, 0x7e80c1ff, 0x9c5fd1a0,
+		0x21e0d0ff, 0x3fbfe0ff, 0x5d9ff073, 0x7b7fffff }));
+
+	CHECK(!DecodeTexture(TextureFormat::DXT1, bc1.data(), bc1.size() - 1, 4, 4, rgba.data(), 16));
+	CHECK(TextureIsaSupported(TextureIsa::Scalar));
+	CHECK(TextureIsaSupported(TextureIsa::Best));
+}
+
+};
+
+int main() {
+	ThreadPool pool(2);
+	CheckBlocks();
+	CheckConformance(pool);
+	return test::Result();
+}
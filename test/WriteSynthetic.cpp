@@ -0,0 +1,38 @@
+// unitypack-write-synthetic writes a synthetic SerializedFile, such as the reference file the
+// codegen test generates its structs from.
+//
+// Usage: unitypack-write-synthetic [-v version] [-n objects] [-b] [-s seed] out
+#include "Synthetic.h"
+#include <stdlib.h>
+
+using namespace unitypack;
+
+int main(int argc, char **argv) {
+	synthetic::Options options;
+	const char *outPath = nullptr;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-v") == 0 && i + 1 < argc) {
+			options.version = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			options.objects = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			options.seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+		} else if (strcmp(argv[i], "-b") == 0) {
+			options.bigEndian = true;
+		} else if (argv[i][0] != '-' && !outPath) {
+			outPath = argv[i];
+		} else {
+			outPath = nullptr;
+			break;
+		}
+	}
+	if (!outPath) {
+		fprintf(stderr, "usage: unitypack-write-synthetic [-v version] [-n objects] [-b] [-s seed] out\n");
+		return 2;
+	}
+	if (!synthetic::WriteFile(outPath, options)) {
+		fprintf(stderr, "unitypack-write-synthetic: cannot write %s\n", outPath);
+		return 1;
+	}
+	return 0;
+}